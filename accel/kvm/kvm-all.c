@@ -39,6 +39,7 @@
 #include "system/ram_addr.h"
 #include "qemu/event_notifier.h"
 #include "qemu/main-loop.h"
+#include "qemu/timer.h"
 #include "trace.h"
 #include "hw/irq.h"
 #include "qapi/visitor.h"
@@ -53,6 +54,7 @@
 
 #include "hw/boards.h"
 #include "system/stats.h"
+#include "block/thread-pool.h"
 
 /* This check must be after config-host.h is included */
 #ifdef CONFIG_EVENTFD
@@ -820,9 +822,13 @@ static bool kvm_slot_get_dirty_log(KVMState *s, KVMSlot *slot)
     return ret == 0;
 }
 
-/* Should be with all slots_lock held for the address spaces. */
+/*
+ * Should be with all slots_lock held for the address spaces.  @atomic must
+ * be set when other rings are being reaped concurrently.
+ */
 static void kvm_dirty_ring_mark_page(KVMState *s, uint32_t as_id,
-                                     uint32_t slot_id, uint64_t offset)
+                                     uint32_t slot_id, uint64_t offset,
+                                     bool atomic)
 {
     KVMMemoryListener *kml;
     KVMSlot *mem;
@@ -839,7 +845,11 @@ static void kvm_dirty_ring_mark_page(KVMState *s, uint32_t as_id,
         return;
     }
 
-    set_bit(offset, mem->dirty_bmap);
+    if (atomic) {
+        set_bit_atomic(offset, mem->dirty_bmap);
+    } else {
+        set_bit(offset, mem->dirty_bmap);
+    }
 }
 
 static bool dirty_gfn_is_dirtied(struct kvm_dirty_gfn *gfn)
@@ -876,7 +886,8 @@ static void dirty_gfn_set_collected(struct kvm_dirty_gfn *gfn)
  * Should be with all slots_lock held for the address spaces.  It returns the
  * dirty page we've collected on this dirty ring.
  */
-static uint32_t kvm_dirty_ring_reap_one(KVMState *s, CPUState *cpu)
+static uint32_t kvm_dirty_ring_reap_one(KVMState *s, CPUState *cpu,
+                                        bool atomic)
 {
     struct kvm_dirty_gfn *dirty_gfns = cpu->kvm_dirty_gfns, *cur;
     uint32_t ring_size = s->kvm_dirty_ring_size;
@@ -900,7 +911,7 @@ static uint32_t kvm_dirty_ring_reap_one(KVMState *s, CPUState *cpu)
             break;
         }
         kvm_dirty_ring_mark_page(s, cur->slot >> 16, cur->slot & 0xffff,
-                                 cur->offset);
+                                 cur->offset, atomic);
         dirty_gfn_set_collected(cur);
         trace_kvm_dirty_ring_page(cpu->cpu_index, fetch, cur->offset);
         fetch++;
@@ -912,22 +923,105 @@ static uint32_t kvm_dirty_ring_reap_one(KVMState *s, CPUState *cpu)
     return count;
 }
 
+/*
+ * With many vCPUs one thread cannot keep up with the rate at which the
+ * rings fill up, so they are harvested in parallel: each worker reaps an
+ * interleaved shard of the vCPUs, while the caller keeps holding the slots
+ * lock for the whole pass.
+ */
+#define KVM_DIRTY_RING_REAP_SHARD_MIN   32  /* vCPUs per worker */
+#define KVM_DIRTY_RING_REAP_WORKERS     8
+
+typedef struct KVMDirtyRingShard {
+    KVMState *s;
+    CPUState **cpus;
+    int ncpus;
+    int index;
+    int nshards;
+    uint64_t total;
+    uint32_t max;
+} KVMDirtyRingShard;
+
+static int kvm_dirty_ring_reap_shard(void *opaque)
+{
+    KVMDirtyRingShard *shard = opaque;
+    uint32_t count;
+    int i;
+
+    for (i = shard->index; i < shard->ncpus; i += shard->nshards) {
+        count = kvm_dirty_ring_reap_one(shard->s, shard->cpus[i],
+                                        shard->nshards > 1);
+        shard->total += count;
+        shard->max = MAX(shard->max, count);
+    }
+    return 0;
+}
+
+/* Must be with slots_lock held */
+static uint64_t kvm_dirty_ring_reap_all(KVMState *s, uint32_t *max)
+{
+    KVMDirtyRingShard shards[KVM_DIRTY_RING_REAP_WORKERS];
+    g_autofree CPUState **cpus = NULL;
+    uint64_t total = 0;
+    int ncpus = 0, nshards, i;
+    CPUState *cpu;
+
+    CPU_FOREACH(cpu) {
+        ncpus++;
+    }
+
+    cpus = g_new(CPUState *, ncpus);
+    i = 0;
+    CPU_FOREACH(cpu) {
+        cpus[i++] = cpu;
+    }
+
+    nshards = s->reaper.pool ? ncpus / KVM_DIRTY_RING_REAP_SHARD_MIN : 1;
+    nshards = MAX(MIN(nshards, KVM_DIRTY_RING_REAP_WORKERS), 1);
+
+    for (i = 0; i < nshards; i++) {
+        shards[i] = (KVMDirtyRingShard) {
+            .s = s,
+            .cpus = cpus,
+            .ncpus = ncpus,
+            .index = i,
+            .nshards = nshards,
+        };
+        if (i) {
+            thread_pool_submit(s->reaper.pool, kvm_dirty_ring_reap_shard,
+                               &shards[i], NULL);
+        }
+    }
+
+    kvm_dirty_ring_reap_shard(&shards[0]);
+    if (nshards > 1) {
+        thread_pool_wait(s->reaper.pool);
+    }
+
+    *max = 0;
+    for (i = 0; i < nshards; i++) {
+        total += shards[i].total;
+        *max = MAX(*max, shards[i].max);
+    }
+    return total;
+}
+
 /* Must be with slots_lock held */
 static uint64_t kvm_dirty_ring_reap_locked(KVMState *s, CPUState* cpu)
 {
     int ret;
     uint64_t total = 0;
+    uint32_t max;
     int64_t stamp;
 
     stamp = get_clock();
 
     if (cpu) {
-        total = kvm_dirty_ring_reap_one(s, cpu);
+        total = max = kvm_dirty_ring_reap_one(s, cpu, false);
     } else {
-        CPU_FOREACH(cpu) {
-            total += kvm_dirty_ring_reap_one(s, cpu);
-        }
+        total = kvm_dirty_ring_reap_all(s, &max);
     }
+    s->reaper.reap_max = MAX(s->reaper.reap_max, max);
 
     if (total) {
         ret = kvm_vm_ioctl(s, KVM_RESET_DIRTY_RINGS);
@@ -1622,10 +1716,35 @@ static void kvm_set_phys_mem(KVMMemoryListener *kml,
     } while (size);
 }
 
+/* Bounds of the reaper sleep time, in milliseconds */
+#define KVM_DIRTY_RING_REAPER_MIN_MS    10
+#define KVM_DIRTY_RING_REAPER_MAX_MS    1000
+
+/*
+ * Pick the next sleep time of the reaper from how full the fullest ring
+ * was and whether any vCPU had to exit because its ring filled up: reap
+ * more often under a heavy dirtying load, and back off when idle.
+ */
+static unsigned kvm_dirty_ring_reaper_interval(KVMState *s, unsigned ms)
+{
+    struct KVMDirtyRingReaper *r = &s->reaper;
+    uint32_t max = qatomic_xchg(&r->reap_max, 0);
+    uint32_t full = qatomic_xchg(&r->full_exits, 0);
+
+    if (full || max > s->kvm_dirty_ring_size / 2) {
+        ms /= 2;
+    } else if (max < s->kvm_dirty_ring_size / 8) {
+        ms *= 2;
+    }
+    return MIN(MAX(ms, KVM_DIRTY_RING_REAPER_MIN_MS),
+               KVM_DIRTY_RING_REAPER_MAX_MS);
+}
+
 static void *kvm_dirty_ring_reaper_thread(void *data)
 {
     KVMState *s = data;
     struct KVMDirtyRingReaper *r = &s->reaper;
+    unsigned ms = KVM_DIRTY_RING_REAPER_MAX_MS;
 
     rcu_register_thread();
 
@@ -1634,10 +1753,7 @@ static void *kvm_dirty_ring_reaper_thread(void *data)
     while (true) {
         r->reaper_state = KVM_DIRTY_RING_REAPER_WAIT;
         trace_kvm_dirty_ring_reaper("wait");
-        /*
-         * TODO: provide a smarter timeout rather than a constant?
-         */
-        sleep(1);
+        g_usleep(ms * 1000);
 
         /* keep sleeping so that dirtylimit not be interfered by reaper */
         if (dirtylimit_in_service()) {
@@ -1652,6 +1768,7 @@ static void *kvm_dirty_ring_reaper_thread(void *data)
         bql_unlock();
 
         r->reaper_iteration++;
+        ms = kvm_dirty_ring_reaper_interval(s, ms);
     }
 
     g_assert_not_reached();
@@ -1661,6 +1778,11 @@ static void kvm_dirty_ring_reaper_init(KVMState *s)
 {
     struct KVMDirtyRingReaper *r = &s->reaper;
 
+    if (current_machine->smp.max_cpus >= 2 * KVM_DIRTY_RING_REAP_SHARD_MIN) {
+        r->pool = thread_pool_new();
+        thread_pool_set_max_threads(r->pool, KVM_DIRTY_RING_REAP_WORKERS - 1);
+    }
+
     qemu_thread_create(&r->reaper_thr, "kvm-reaper",
                        kvm_dirty_ring_reaper_thread,
                        s, QEMU_THREAD_JOINABLE);
@@ -2497,6 +2619,7 @@ bool kvm_dirty_ring_enabled(void)
 static void query_stats_cb(StatsResultList **result, StatsTarget target,
                            strList *names, strList *targets, Error **errp);
 static void query_stats_schemas_cb(StatsSchemaList **result, Error **errp);
+static void kvm_coalesced_mmio_poll(void *opaque);
 
 uint32_t kvm_dirty_ring_size(void)
 {
@@ -2723,6 +2846,13 @@ static int kvm_init(AccelState *as, MachineState *ms)
     s->coalesced_mmio = kvm_check_extension(s, KVM_CAP_COALESCED_MMIO);
     s->coalesced_pio = s->coalesced_mmio &&
                        kvm_check_extension(s, KVM_CAP_COALESCED_PIO);
+    if (s->coalesced_mmio && s->coalesced_poll_us) {
+        s->coalesced_poll_timer = timer_new_us(QEMU_CLOCK_REALTIME,
+                                               kvm_coalesced_mmio_poll, s);
+        timer_mod(s->coalesced_poll_timer,
+                  qemu_clock_get_us(QEMU_CLOCK_REALTIME) +
+                  s->coalesced_poll_us);
+    }
 
     ret = kvm_setup_dirty_ring(s);
     if (ret < 0) {
@@ -2875,6 +3005,73 @@ static int kvm_handle_internal_error(CPUState *cpu, struct kvm_run *run)
     return -1;
 }
 
+/*
+ * The section that the previous coalesced entry was dispatched to.  Guests
+ * typically stream writes to a single doorbell or FIFO register, so runs of
+ * entries are translated once and then handed straight to the device.
+ */
+typedef struct KVMCoalescedTarget {
+    FlatView *fv;
+    MemoryRegion *mr;
+    hwaddr base;        /* address of the first byte of the run */
+    hwaddr xlat;        /* offset of @base within @mr */
+    hwaddr len;         /* bytes of the section that follow @base */
+} KVMCoalescedTarget;
+
+/* Must be called with the BQL held, inside an RCU critical section */
+static void kvm_coalesced_mmio_dispatch(KVMCoalescedTarget *t,
+                                        AddressSpace *as,
+                                        struct kvm_coalesced_mmio *ent)
+{
+    MemTxAttrs attrs = MEMTXATTRS_UNSPECIFIED;
+    FlatView *fv = address_space_to_flatview(as);
+    hwaddr addr = ent->phys_addr;
+    hwaddr offset;
+
+    /* A previous write may have changed the memory map */
+    if (t->fv != fv || addr < t->base || addr - t->base >= t->len ||
+        t->len - (addr - t->base) < ent->len) {
+        t->fv = fv;
+        t->base = addr;
+        t->len = (hwaddr)-1;
+        t->mr = flatview_translate(fv, addr, &t->xlat, &t->len, true, attrs);
+    }
+
+    offset = t->xlat + (addr - t->base);
+    if (t->len - (addr - t->base) >= ent->len && is_power_of_2(ent->len) &&
+        !memory_access_is_direct(t->mr, true, attrs) &&
+        memory_region_access_valid(t->mr, offset, ent->len, true, attrs)) {
+        memory_region_dispatch_write(t->mr, offset,
+                                     ldn_he_p(ent->data, ent->len),
+                                     size_memop(ent->len), attrs);
+    } else {
+        address_space_write(as, addr, attrs, ent->data, ent->len);
+    }
+}
+
+/* Must be called with the BQL held */
+static void kvm_coalesced_mmio_drain(KVMState *s)
+{
+    struct kvm_coalesced_mmio_ring *ring = s->coalesced_mmio_ring;
+    KVMCoalescedTarget mmio = { 0 }, pio = { 0 };
+
+    RCU_READ_LOCK_GUARD();
+
+    while (ring->first != ring->last) {
+        struct kvm_coalesced_mmio *ent;
+
+        ent = &ring->coalesced_mmio[ring->first];
+
+        if (ent->pio == 1) {
+            kvm_coalesced_mmio_dispatch(&pio, &address_space_io, ent);
+        } else {
+            kvm_coalesced_mmio_dispatch(&mmio, &address_space_memory, ent);
+        }
+        smp_wmb();
+        ring->first = (ring->first + 1) % KVM_COALESCED_MMIO_MAX;
+    }
+}
+
 void kvm_flush_coalesced_mmio_buffer(void)
 {
     KVMState *s = kvm_state;
@@ -2886,27 +3083,29 @@ void kvm_flush_coalesced_mmio_buffer(void)
     s->coalesced_flush_in_progress = true;
 
     if (s->coalesced_mmio_ring) {
-        struct kvm_coalesced_mmio_ring *ring = s->coalesced_mmio_ring;
-        while (ring->first != ring->last) {
-            struct kvm_coalesced_mmio *ent;
-
-            ent = &ring->coalesced_mmio[ring->first];
-
-            if (ent->pio == 1) {
-                address_space_write(&address_space_io, ent->phys_addr,
-                                    MEMTXATTRS_UNSPECIFIED, ent->data,
-                                    ent->len);
-            } else {
-                cpu_physical_memory_write(ent->phys_addr, ent->data, ent->len);
-            }
-            smp_wmb();
-            ring->first = (ring->first + 1) % KVM_COALESCED_MMIO_MAX;
-        }
+        kvm_coalesced_mmio_drain(s);
     }
 
     s->coalesced_flush_in_progress = false;
 }
 
+/*
+ * The ring is otherwise only drained when a region that asked for it is
+ * accessed, so writes to a region that the guest never reads back could
+ * sit in the ring forever.  Polling bounds their latency.
+ */
+static void kvm_coalesced_mmio_poll(void *opaque)
+{
+    KVMState *s = opaque;
+    struct kvm_coalesced_mmio_ring *ring = s->coalesced_mmio_ring;
+
+    if (ring && qatomic_read(&ring->first) != qatomic_read(&ring->last)) {
+        kvm_flush_coalesced_mmio_buffer();
+    }
+    timer_mod(s->coalesced_poll_timer,
+              qemu_clock_get_us(QEMU_CLOCK_REALTIME) + s->coalesced_poll_us);
+}
+
 static void do_kvm_cpu_synchronize_state(CPUState *cpu, run_on_cpu_data arg)
 {
     if (!cpu->vcpu_dirty && !kvm_state->guest_state_protected) {
@@ -3280,6 +3479,8 @@ int kvm_cpu_exec(CPUState *cpu)
              * still full.  Got kicked by KVM_RESET_DIRTY_RINGS.
              */
             trace_kvm_dirty_ring_full(cpu->cpu_index);
+            cpu->dirty_ring_full_exits++;
+            qatomic_inc(&kvm_state->reaper.full_exits);
             bql_lock();
             /*
              * We throttle vCPU by making it sleep once it exit from kernel
@@ -3951,6 +4152,35 @@ static void kvm_set_dirty_ring_size(Object *obj, Visitor *v,
     s->kvm_dirty_ring_size = value;
 }
 
+static void kvm_get_coalesced_poll(Object *obj, Visitor *v,
+                                   const char *name, void *opaque,
+                                   Error **errp)
+{
+    KVMState *s = KVM_STATE(obj);
+    uint32_t value = s->coalesced_poll_us;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void kvm_set_coalesced_poll(Object *obj, Visitor *v,
+                                   const char *name, void *opaque,
+                                   Error **errp)
+{
+    KVMState *s = KVM_STATE(obj);
+    uint32_t value;
+
+    if (s->fd != -1) {
+        error_setg(errp, "Cannot set properties after the accelerator has been initialized");
+        return;
+    }
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+
+    s->coalesced_poll_us = value;
+}
+
 static char *kvm_get_device(Object *obj,
                             Error **errp G_GNUC_UNUSED)
 {
@@ -4044,6 +4274,13 @@ static void kvm_accel_class_init(ObjectClass *oc, const void *data)
     object_class_property_set_description(oc, "dirty-ring-size",
         "Size of KVM dirty page ring buffer (default: 0, i.e. use bitmap)");
 
+    object_class_property_add(oc, "coalesced-mmio-poll", "uint32",
+        kvm_get_coalesced_poll, kvm_set_coalesced_poll,
+        NULL, NULL);
+    object_class_property_set_description(oc, "coalesced-mmio-poll",
+        "Interval in microseconds at which coalesced MMIO is flushed "
+        "(default: 0, only when a device needs it)");
+
     object_class_property_add_str(oc, "device", kvm_get_device, kvm_set_device);
     object_class_property_set_description(oc, "device",
         "Path to the device node to use (default: /dev/kvm)");
@@ -4077,6 +4314,9 @@ static void kvm_type_init(void)
 
 type_init(kvm_type_init);
 
+/* Counted by QEMU rather than by the kernel */
+#define KVM_STATS_DIRTY_RING_FULL "dirty_ring_full_exits"
+
 typedef struct StatsArgs {
     union StatsResultsType {
         StatsResultList **stats;
@@ -4343,6 +4583,17 @@ static void query_stats(StatsResultList **result, StatsTarget target,
         stats_list = add_kvmstat_entry(pdesc, stats, stats_list, errp);
     }
 
+    if (target == STATS_TARGET_VCPU && kvm_state->kvm_dirty_ring_size &&
+        apply_str_list_filter(KVM_STATS_DIRTY_RING_FULL, names)) {
+        Stats *stats = g_new0(Stats, 1);
+
+        stats->name = g_strdup(KVM_STATS_DIRTY_RING_FULL);
+        stats->value = g_new0(StatsValue, 1);
+        stats->value->u.scalar = cpu->dirty_ring_full_exits;
+        stats->value->type = QTYPE_QNUM;
+        QAPI_LIST_PREPEND(stats_list, stats);
+    }
+
     if (!stats_list) {
         return;
     }
@@ -4387,6 +4638,14 @@ static void query_stats_schema(StatsSchemaList **result, StatsTarget target,
         stats_list = add_kvmschema_entry(pdesc, stats_list, errp);
     }
 
+    if (target == STATS_TARGET_VCPU && kvm_state->kvm_dirty_ring_size) {
+        StatsSchemaValue *value = g_new0(StatsSchemaValue, 1);
+
+        value->name = g_strdup(KVM_STATS_DIRTY_RING_FULL);
+        value->type = STATS_TYPE_CUMULATIVE;
+        QAPI_LIST_PREPEND(stats_list, value);
+    }
+
     add_stats_schema(result, STATS_PROVIDER_KVM, target, stats_list);
 }
 
@@ -136,16 +136,25 @@ static void gen_udata_cb(struct qemu_plugin_regular_cb *cb)
 static TCGv_ptr gen_plugin_u64_ptr(qemu_plugin_u64 entry)
 {
     TCGv_ptr ptr = tcg_temp_ebb_new_ptr();
+    size_t offset = entry.score->offset + entry.offset;
+    size_t slab = offset >> QEMU_PLUGIN_SLAB_BITS;
 
-    GArray *arr = entry.score->data;
-    char *base_ptr = arr->data + entry.offset;
-    size_t entry_size = g_array_get_element_size(arr);
+    /*
+     * Scoreboard entries never move, so the address is a constant when
+     * running a single vcpu (see gen_cpu_index). Otherwise, look up the
+     * slab of the executing vcpu.
+     */
+    if (!tcg_cflags_has(current_cpu, CF_PARALLEL)) {
+        tcg_gen_movi_ptr(ptr, (intptr_t)qemu_plugin_slabs_ptr(
+                             current_cpu->neg.plugin_slabs, offset));
+        return ptr;
+    }
 
-    TCGv_i32 cpu_index = gen_cpu_index();
-    tcg_gen_muli_i32(cpu_index, cpu_index, entry_size);
-    tcg_gen_ext_i32_ptr(ptr, cpu_index);
-    tcg_temp_free_i32(cpu_index);
-    tcg_gen_addi_ptr(ptr, ptr, (intptr_t) base_ptr);
+    tcg_gen_ld_ptr(ptr, tcg_env,
+                   offsetof(CPUState, neg.plugin_slabs) - sizeof(CPUState));
+    tcg_gen_ld_ptr(ptr, ptr, offsetof(struct qemu_plugin_slabs, slab) +
+                             slab * sizeof(char *));
+    tcg_gen_addi_ptr(ptr, ptr, offset & (QEMU_PLUGIN_SLAB_SIZE - 1));
 
     return ptr;
 }
@@ -413,10 +422,13 @@ static void plugin_gen_inject(struct qemu_plugin_tb *plugin_tb)
 
 bool plugin_gen_tb_start(CPUState *cpu, const DisasContextBase *db)
 {
+    unsigned long *mask = cpu->plugin_state->event_mask;
     struct qemu_plugin_tb *ptb;
 
-    if (!test_bit(QEMU_PLUGIN_EV_VCPU_TB_TRANS,
-                  cpu->plugin_state->event_mask)) {
+    /* the core also instruments blocks for sampling and hotness tracking */
+    if (!test_bit(QEMU_PLUGIN_EV_VCPU_TB_TRANS, mask) &&
+        !test_bit(QEMU_PLUGIN_EV_VCPU_SAMPLE, mask) &&
+        !test_bit(QEMU_PLUGIN_EV_VCPU_TB_HOT, mask)) {
         return false;
     }
 
@@ -253,6 +253,40 @@ int page_get_flags(vaddr address)
     return p ? p->flags : 0;
 }
 
+/*
+ * Allow the target to decide if PAGE_TARGET_[12] may be reset.
+ * By default, they are not kept.
+ */
+#ifndef PAGE_TARGET_STICKY
+#define PAGE_TARGET_STICKY  0
+#endif
+#define PAGE_STICKY  (PAGE_ANON | PAGE_PASSTHROUGH | PAGE_TARGET_STICKY)
+
+bool page_set_flags_is_nop(vaddr start, vaddr last, int flags)
+{
+    PageFlagsNode *p;
+    int p_flags;
+
+    assert(flags & PAGE_VALID);
+    assert(!(flags & PAGE_RESET));
+    if (flags & PAGE_WRITE) {
+        flags |= PAGE_WRITE_ORG;
+    }
+
+    /*
+     * Lockless lookups have false negatives but no false positives,
+     * which only sends the caller down the locked path.
+     */
+    RCU_READ_LOCK_GUARD();
+    p = pageflags_find(start, last);
+    if (!p) {
+        return false;
+    }
+    p_flags = qatomic_read(&p->flags);
+    return p->itree.start <= start && last <= p->itree.last &&
+           p_flags == ((p_flags & PAGE_STICKY) | flags);
+}
+
 /* A subroutine of page_set_flags: insert a new node for [start,last]. */
 static void pageflags_create(vaddr start, vaddr last, int flags)
 {
@@ -351,15 +385,6 @@ static void pageflags_create_merge(vaddr start, vaddr last, int flags)
     }
 }
 
-/*
- * Allow the target to decide if PAGE_TARGET_[12] may be reset.
- * By default, they are not kept.
- */
-#ifndef PAGE_TARGET_STICKY
-#define PAGE_TARGET_STICKY  0
-#endif
-#define PAGE_STICKY  (PAGE_ANON | PAGE_PASSTHROUGH | PAGE_TARGET_STICKY)
-
 /* A subroutine of page_set_flags: add flags to [start,last]. */
 static bool pageflags_set_clear(vaddr start, vaddr last,
                                 int set_flags, int clear_flags)
@@ -400,7 +425,7 @@ static bool pageflags_set_clear(vaddr start, vaddr last,
      */
     if (start == p_start && last == p_last) {
         if (merge_flags) {
-            p->flags = merge_flags;
+            qatomic_set(&p->flags, merge_flags);
         } else {
             interval_tree_remove(&p->itree, &pageflags_root);
             g_free_rcu(p, rcu);
@@ -445,7 +470,7 @@ static bool pageflags_set_clear(vaddr start, vaddr last,
                 }
             } else {
                 if (merge_flags) {
-                    p->flags = merge_flags;
+                    qatomic_set(&p->flags, merge_flags);
                 } else {
                     interval_tree_remove(&p->itree, &pageflags_root);
                     g_free_rcu(p, rcu);
@@ -703,6 +728,21 @@ void tb_lock_page0(tb_page_addr_t address)
     }
 }
 
+/*
+ * A thread raced with another one which got to page_unprotect first,
+ * unprotected the page and did the TB invalidate for us.
+ */
+static bool page_unprotect_raced(CPUState *cpu, uintptr_t pc)
+{
+    if (pc && cpu->cc->tcg_ops->precise_smc) {
+        TranslationBlock *current_tb = tcg_tb_lookup(pc);
+        if (current_tb) {
+            return tb_cflags(current_tb) & CF_INVALID;
+        }
+    }
+    return false;
+}
+
 /*
  * Called from signal handler: invalidate the code and unprotect the
  * page. Return 0 if the fault was not handled, 1 if it was handled,
@@ -712,11 +752,30 @@ void tb_lock_page0(tb_page_addr_t address)
  */
 int page_unprotect(CPUState *cpu, tb_page_addr_t address, uintptr_t pc)
 {
+    int host_page_size = qemu_real_host_page_size();
     PageFlagsNode *p;
     bool current_tb_invalidated;
 
     assert((cpu == NULL) == (pc == 0));
 
+    /*
+     * Multi-threaded JITs often fault on the same code page from several
+     * threads at once.  When the target page covers the host page, the
+     * locked path below only sets PAGE_WRITE once the TBs are gone and the
+     * host page is writable again, so seeing it without the lock is enough
+     * for the threads that lost the race to retry their store.
+     */
+    if (host_page_size <= TARGET_PAGE_SIZE) {
+        WITH_RCU_READ_LOCK_GUARD() {
+            const int want = PAGE_WRITE | PAGE_WRITE_ORG;
+
+            p = pageflags_find(address, address);
+            if (p && (qatomic_read(&p->flags) & want) == want) {
+                return page_unprotect_raced(cpu, pc) ? 2 : 1;
+            }
+        }
+    }
+
     /*
      * Technically this isn't safe inside a signal handler.  However we
      * know this only ever happens in a synchronous SEGV handler, so in
@@ -734,19 +793,8 @@ int page_unprotect(CPUState *cpu, tb_page_addr_t address, uintptr_t pc)
 
     current_tb_invalidated = false;
     if (p->flags & PAGE_WRITE) {
-        /*
-         * If the page is actually marked WRITE then assume this is because
-         * this thread raced with another one which got here first and
-         * set the page to PAGE_WRITE and did the TB invalidate for us.
-         */
-        if (pc && cpu->cc->tcg_ops->precise_smc) {
-            TranslationBlock *current_tb = tcg_tb_lookup(pc);
-            if (current_tb) {
-                current_tb_invalidated = tb_cflags(current_tb) & CF_INVALID;
-            }
-        }
+        current_tb_invalidated = page_unprotect_raced(cpu, pc);
     } else {
-        int host_page_size = qemu_real_host_page_size();
         vaddr start, len, i;
         int prot;
 
@@ -754,9 +802,16 @@ int page_unprotect(CPUState *cpu, tb_page_addr_t address, uintptr_t pc)
             start = address & TARGET_PAGE_MASK;
             len = TARGET_PAGE_SIZE;
             prot = p->flags | PAGE_WRITE;
-            pageflags_set_clear(start, start + len - 1, PAGE_WRITE, 0);
             current_tb_invalidated =
                 tb_invalidate_phys_page_unwind(cpu, start, pc);
+            if (prot & PAGE_EXEC) {
+                prot = (prot & ~PAGE_EXEC) | PAGE_READ;
+            }
+            mprotect((void *)g2h_untagged(start), len, prot & PAGE_RWX);
+            /* Publish PAGE_WRITE last, see the lockless check above. */
+            pageflags_set_clear(start, start + len - 1, PAGE_WRITE, 0);
+            mmap_unlock();
+            return current_tb_invalidated ? 2 : 1;
         } else {
             start = address & -host_page_size;
             len = host_page_size;
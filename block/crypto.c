@@ -21,6 +21,8 @@
 #include "qemu/osdep.h"
 
 #include "block/block_int.h"
+#include "block/aio_task.h"
+#include "block/thread-pool.h"
 #include "block/qdict.h"
 #include "system/block-backend.h"
 #include "crypto/block.h"
@@ -466,9 +468,61 @@ static int block_crypto_reopen_prepare(BDRVReopenState *state,
  */
 #define BLOCK_CRYPTO_MAX_IO_SIZE (1024 * 1024)
 
+/*
+ * Requests of at least twice this size are split into up to
+ * BLOCK_CRYPTO_MAX_WORKERS slices that run in parallel. Each slice does
+ * its own I/O and has its cipher work done in the thread pool, so the
+ * encryption of one slice overlaps with the I/O of the others and large
+ * requests are not limited to the cipher throughput of a single core.
+ */
+#define BLOCK_CRYPTO_MIN_TASK_SIZE (64 * 1024)
+#define BLOCK_CRYPTO_MAX_WORKERS 8
+
+typedef int BlockCryptoEncDecFunc(QCryptoBlock *block, uint64_t offset,
+                                  uint8_t *buf, size_t len, Error **errp);
+
+typedef struct BlockCryptoEncDecData {
+    QCryptoBlock *block;
+    uint64_t offset;
+    uint8_t *buf;
+    size_t len;
+
+    BlockCryptoEncDecFunc *func;
+} BlockCryptoEncDecData;
+
+static int block_crypto_encdec_pool_func(void *opaque)
+{
+    BlockCryptoEncDecData *data = opaque;
+
+    return data->func(data->block, data->offset, data->buf, data->len, NULL);
+}
+
+/*
+ * Encrypt or decrypt @buf in place, in a worker thread if @offload is
+ * true, otherwise in the calling coroutine.
+ */
+static int coroutine_fn
+block_crypto_co_encdec(BlockCrypto *crypto, uint64_t offset, uint8_t *buf,
+                       size_t len, BlockCryptoEncDecFunc *func, bool offload)
+{
+    BlockCryptoEncDecData arg = {
+        .block = crypto->block,
+        .offset = offset,
+        .buf = buf,
+        .len = len,
+        .func = func,
+    };
+
+    if (offload) {
+        return thread_pool_submit_co(block_crypto_encdec_pool_func, &arg);
+    }
+    return block_crypto_encdec_pool_func(&arg);
+}
+
 static int coroutine_fn GRAPH_RDLOCK
-block_crypto_co_preadv(BlockDriverState *bs, int64_t offset, int64_t bytes,
-                       QEMUIOVector *qiov, BdrvRequestFlags flags)
+block_crypto_co_preadv_slice(BlockDriverState *bs, uint64_t offset,
+                             uint64_t bytes, QEMUIOVector *qiov,
+                             size_t qiov_offset, bool offload)
 {
     BlockCrypto *crypto = bs->opaque;
     uint64_t cur_bytes; /* number of bytes in current iteration */
@@ -476,21 +530,16 @@ block_crypto_co_preadv(BlockDriverState *bs, int64_t offset, int64_t bytes,
     uint8_t *cipher_data = NULL;
     QEMUIOVector hd_qiov;
     int ret = 0;
-    uint64_t sector_size = qcrypto_block_get_sector_size(crypto->block);
     uint64_t payload_offset = qcrypto_block_get_payload_offset(crypto->block);
 
-    assert(payload_offset < INT64_MAX);
-    assert(QEMU_IS_ALIGNED(offset, sector_size));
-    assert(QEMU_IS_ALIGNED(bytes, sector_size));
-
-    qemu_iovec_init(&hd_qiov, qiov->niov);
+    qemu_iovec_init(&hd_qiov, 1);
 
     /* Bounce buffer because we don't wish to expose cipher text
      * in qiov which points to guest memory.
      */
     cipher_data =
         qemu_try_blockalign(bs->file->bs, MIN(BLOCK_CRYPTO_MAX_IO_SIZE,
-                                              qiov->size));
+                                              bytes));
     if (cipher_data == NULL) {
         ret = -ENOMEM;
         goto cleanup;
@@ -508,13 +557,15 @@ block_crypto_co_preadv(BlockDriverState *bs, int64_t offset, int64_t bytes,
             goto cleanup;
         }
 
-        if (qcrypto_block_decrypt(crypto->block, offset + bytes_done,
-                                  cipher_data, cur_bytes, NULL) < 0) {
+        if (block_crypto_co_encdec(crypto, offset + bytes_done, cipher_data,
+                                   cur_bytes, qcrypto_block_decrypt,
+                                   offload) < 0) {
             ret = -EIO;
             goto cleanup;
         }
 
-        qemu_iovec_from_buf(qiov, bytes_done, cipher_data, cur_bytes);
+        qemu_iovec_from_buf(qiov, qiov_offset + bytes_done,
+                            cipher_data, cur_bytes);
 
         bytes -= cur_bytes;
         bytes_done += cur_bytes;
@@ -527,10 +578,11 @@ block_crypto_co_preadv(BlockDriverState *bs, int64_t offset, int64_t bytes,
     return ret;
 }
 
-
 static int coroutine_fn GRAPH_RDLOCK
-block_crypto_co_pwritev(BlockDriverState *bs, int64_t offset, int64_t bytes,
-                        QEMUIOVector *qiov, BdrvRequestFlags flags)
+block_crypto_co_pwritev_slice(BlockDriverState *bs, uint64_t offset,
+                              uint64_t bytes, QEMUIOVector *qiov,
+                              size_t qiov_offset, BdrvRequestFlags flags,
+                              bool offload)
 {
     BlockCrypto *crypto = bs->opaque;
     uint64_t cur_bytes; /* number of bytes in current iteration */
@@ -538,23 +590,16 @@ block_crypto_co_pwritev(BlockDriverState *bs, int64_t offset, int64_t bytes,
     uint8_t *cipher_data = NULL;
     QEMUIOVector hd_qiov;
     int ret = 0;
-    uint64_t sector_size = qcrypto_block_get_sector_size(crypto->block);
     uint64_t payload_offset = qcrypto_block_get_payload_offset(crypto->block);
 
-    flags &= ~BDRV_REQ_REGISTERED_BUF;
-
-    assert(payload_offset < INT64_MAX);
-    assert(QEMU_IS_ALIGNED(offset, sector_size));
-    assert(QEMU_IS_ALIGNED(bytes, sector_size));
-
-    qemu_iovec_init(&hd_qiov, qiov->niov);
+    qemu_iovec_init(&hd_qiov, 1);
 
     /* Bounce buffer because we're not permitted to touch
      * contents of qiov - it points to guest memory.
      */
     cipher_data =
         qemu_try_blockalign(bs->file->bs, MIN(BLOCK_CRYPTO_MAX_IO_SIZE,
-                                              qiov->size));
+                                              bytes));
     if (cipher_data == NULL) {
         ret = -ENOMEM;
         goto cleanup;
@@ -563,10 +608,12 @@ block_crypto_co_pwritev(BlockDriverState *bs, int64_t offset, int64_t bytes,
     while (bytes) {
         cur_bytes = MIN(bytes, BLOCK_CRYPTO_MAX_IO_SIZE);
 
-        qemu_iovec_to_buf(qiov, bytes_done, cipher_data, cur_bytes);
+        qemu_iovec_to_buf(qiov, qiov_offset + bytes_done,
+                          cipher_data, cur_bytes);
 
-        if (qcrypto_block_encrypt(crypto->block, offset + bytes_done,
-                                  cipher_data, cur_bytes, NULL) < 0) {
+        if (block_crypto_co_encdec(crypto, offset + bytes_done, cipher_data,
+                                   cur_bytes, qcrypto_block_encrypt,
+                                   offload) < 0) {
             ret = -EIO;
             goto cleanup;
         }
@@ -591,6 +638,131 @@ block_crypto_co_pwritev(BlockDriverState *bs, int64_t offset, int64_t bytes,
     return ret;
 }
 
+typedef struct BlockCryptoAioTask {
+    AioTask task;
+
+    BlockDriverState *bs;
+    uint64_t offset;
+    uint64_t bytes;
+    QEMUIOVector *qiov;
+    size_t qiov_offset;
+    BdrvRequestFlags flags;
+} BlockCryptoAioTask;
+
+/*
+ * The task entry points can count as GRAPH_RDLOCK because the request
+ * functions hold the graph lock until all of their tasks have terminated.
+ */
+static int coroutine_fn GRAPH_RDLOCK
+block_crypto_co_preadv_task_entry(AioTask *task)
+{
+    BlockCryptoAioTask *t = container_of(task, BlockCryptoAioTask, task);
+
+    return block_crypto_co_preadv_slice(t->bs, t->offset, t->bytes,
+                                        t->qiov, t->qiov_offset, true);
+}
+
+static int coroutine_fn GRAPH_RDLOCK
+block_crypto_co_pwritev_task_entry(AioTask *task)
+{
+    BlockCryptoAioTask *t = container_of(task, BlockCryptoAioTask, task);
+
+    return block_crypto_co_pwritev_slice(t->bs, t->offset, t->bytes,
+                                         t->qiov, t->qiov_offset, t->flags,
+                                         true);
+}
+
+/*
+ * Split the request into sector aligned slices, one per worker, and run
+ * them on an AioTaskPool. Returns 0 or the error of the first failed slice.
+ */
+static int coroutine_fn GRAPH_RDLOCK
+block_crypto_co_rw_parallel(BlockDriverState *bs, uint64_t offset,
+                            uint64_t bytes, QEMUIOVector *qiov,
+                            BdrvRequestFlags flags, AioTaskFunc func)
+{
+    BlockCrypto *crypto = bs->opaque;
+    uint64_t sector_size = qcrypto_block_get_sector_size(crypto->block);
+    uint64_t task_size;
+    size_t qiov_offset = 0;
+    AioTaskPool *aio;
+    int ret;
+
+    task_size = QEMU_ALIGN_UP(DIV_ROUND_UP(bytes, BLOCK_CRYPTO_MAX_WORKERS),
+                              sector_size);
+    task_size = MAX(task_size, BLOCK_CRYPTO_MIN_TASK_SIZE);
+    task_size = MIN(task_size, BLOCK_CRYPTO_MAX_IO_SIZE);
+
+    aio = aio_task_pool_new(BLOCK_CRYPTO_MAX_WORKERS);
+    while (bytes && aio_task_pool_status(aio) == 0) {
+        BlockCryptoAioTask *t = g_new(BlockCryptoAioTask, 1);
+        uint64_t cur_bytes = MIN(bytes, task_size);
+
+        *t = (BlockCryptoAioTask) {
+            .task.func = func,
+            .bs = bs,
+            .offset = offset,
+            .bytes = cur_bytes,
+            .qiov = qiov,
+            .qiov_offset = qiov_offset,
+            .flags = flags,
+        };
+        aio_task_pool_start_task(aio, &t->task);
+
+        bytes -= cur_bytes;
+        offset += cur_bytes;
+        qiov_offset += cur_bytes;
+    }
+
+    aio_task_pool_wait_all(aio);
+    ret = aio_task_pool_status(aio);
+    aio_task_pool_free(aio);
+
+    return ret;
+}
+
+static int coroutine_fn GRAPH_RDLOCK
+block_crypto_co_preadv(BlockDriverState *bs, int64_t offset, int64_t bytes,
+                       QEMUIOVector *qiov, BdrvRequestFlags flags)
+{
+    BlockCrypto *crypto = bs->opaque;
+    uint64_t sector_size = qcrypto_block_get_sector_size(crypto->block);
+    uint64_t payload_offset = qcrypto_block_get_payload_offset(crypto->block);
+
+    assert(payload_offset < INT64_MAX);
+    assert(QEMU_IS_ALIGNED(offset, sector_size));
+    assert(QEMU_IS_ALIGNED(bytes, sector_size));
+
+    if (bytes < 2 * BLOCK_CRYPTO_MIN_TASK_SIZE) {
+        return block_crypto_co_preadv_slice(bs, offset, bytes, qiov, 0, false);
+    }
+    return block_crypto_co_rw_parallel(bs, offset, bytes, qiov, 0,
+                                       block_crypto_co_preadv_task_entry);
+}
+
+
+static int coroutine_fn GRAPH_RDLOCK
+block_crypto_co_pwritev(BlockDriverState *bs, int64_t offset, int64_t bytes,
+                        QEMUIOVector *qiov, BdrvRequestFlags flags)
+{
+    BlockCrypto *crypto = bs->opaque;
+    uint64_t sector_size = qcrypto_block_get_sector_size(crypto->block);
+    uint64_t payload_offset = qcrypto_block_get_payload_offset(crypto->block);
+
+    flags &= ~BDRV_REQ_REGISTERED_BUF;
+
+    assert(payload_offset < INT64_MAX);
+    assert(QEMU_IS_ALIGNED(offset, sector_size));
+    assert(QEMU_IS_ALIGNED(bytes, sector_size));
+
+    if (bytes < 2 * BLOCK_CRYPTO_MIN_TASK_SIZE) {
+        return block_crypto_co_pwritev_slice(bs, offset, bytes, qiov, 0,
+                                             flags, false);
+    }
+    return block_crypto_co_rw_parallel(bs, offset, bytes, qiov, flags,
+                                       block_crypto_co_pwritev_task_entry);
+}
+
 static void block_crypto_refresh_limits(BlockDriverState *bs, Error **errp)
 {
     BlockCrypto *crypto = bs->opaque;
@@ -0,0 +1,116 @@
+/*
+ * Statistical profiler
+ *
+ * Asks the plugin core for a sample every N guest instructions and
+ * builds a flat profile of the sampled block addresses. Nothing is
+ * instrumented by the plugin itself so the overhead stays low enough
+ * to leave it running on long workloads.
+ *
+ * Copyright (C) 2025, The QEMU Project Developers
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+
+#include <qemu-plugin.h>
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_version = QEMU_PLUGIN_VERSION;
+
+/* Plugins need to take care of their own locking */
+static GMutex lock;
+static GHashTable *samples;
+static uint64_t period = 10000;
+static uint64_t limit = 20;
+static uint64_t total;
+
+typedef struct {
+    uint64_t pc;
+    uint64_t hits;
+} Sample;
+
+static gint cmp_hits(gconstpointer a, gconstpointer b)
+{
+    const Sample *sa = a;
+    const Sample *sb = b;
+    return sa->hits > sb->hits ? -1 : sa->hits < sb->hits;
+}
+
+static void plugin_exit(qemu_plugin_id_t id, void *p)
+{
+    g_autoptr(GString) report = g_string_new(NULL);
+    GList *values, *it;
+    uint64_t i;
+
+    g_mutex_lock(&lock);
+    g_string_append_printf(report,
+                           "%" PRIu64 " samples, period %" PRIu64 " insns\n",
+                           total, period);
+    values = g_list_sort(g_hash_table_get_values(samples), cmp_hits);
+    if (values) {
+        g_string_append(report, "pc, samples, percent\n");
+    }
+    for (i = 0, it = values; i < limit && it; i++, it = it->next) {
+        Sample *rec = it->data;
+        g_string_append_printf(report, "0x%016" PRIx64 ", %" PRIu64
+                               ", %.2f\n", rec->pc, rec->hits,
+                               rec->hits * 100.0 / total);
+    }
+    g_list_free(values);
+    g_hash_table_destroy(samples);
+    g_mutex_unlock(&lock);
+
+    qemu_plugin_outs(report->str);
+}
+
+static void vcpu_sample(unsigned int vcpu_index, uint64_t pc, void *udata)
+{
+    Sample *rec;
+
+    g_mutex_lock(&lock);
+    rec = g_hash_table_lookup(samples, &pc);
+    if (!rec) {
+        rec = g_new0(Sample, 1);
+        rec->pc = pc;
+        g_hash_table_insert(samples, &rec->pc, rec);
+    }
+    rec->hits++;
+    total++;
+    g_mutex_unlock(&lock);
+}
+
+QEMU_PLUGIN_EXPORT
+int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
+                        int argc, char **argv)
+{
+    for (int i = 0; i < argc; i++) {
+        char *opt = argv[i];
+        g_auto(GStrv) tokens = g_strsplit(opt, "=", 2);
+        if (g_strcmp0(tokens[0], "period") == 0) {
+            period = g_ascii_strtoull(tokens[1], NULL, 10);
+            if (period == 0) {
+                fprintf(stderr, "period must be non-zero: %s\n", opt);
+                return -1;
+            }
+        } else if (g_strcmp0(tokens[0], "limit") == 0) {
+            limit = g_ascii_strtoull(tokens[1], NULL, 10);
+        } else {
+            fprintf(stderr, "option parsing failed: %s\n", opt);
+            return -1;
+        }
+    }
+
+    samples = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+                                    NULL, g_free);
+
+    qemu_plugin_register_vcpu_sample_cb(id, vcpu_sample,
+                                        QEMU_PLUGIN_CB_NO_REGS,
+                                        period, NULL);
+    qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * Scoreboard benchmark
+ *
+ * Every executed block updates several per-vCPU counters with inline
+ * operations, which makes this plugin a stress test for scoreboard
+ * accesses from many vCPUs at once. At exit the counters are reduced
+ * over all vCPUs and the guest instruction throughput is reported.
+ *
+ * Copyright (C) 2025, The QEMU Project Developers
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <glib.h>
+
+#include <qemu-plugin.h>
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_version = QEMU_PLUGIN_VERSION;
+
+#define HIST_BUCKETS 8
+
+typedef struct {
+    uint64_t insns;
+    uint64_t blocks;
+    /* executed blocks by log2 of their instruction count */
+    uint64_t hist[HIST_BUCKETS];
+} VcpuCounters;
+
+static struct qemu_plugin_scoreboard *counters;
+static qemu_plugin_u64 insns;
+static qemu_plugin_u64 blocks;
+static gint64 start_time;
+
+static void plugin_exit(qemu_plugin_id_t id, void *p)
+{
+    g_autoptr(GString) report = g_string_new(NULL);
+    double secs = (g_get_monotonic_time() - start_time) / 1e6;
+    uint64_t hist[HIST_BUCKETS];
+    uint64_t total = qemu_plugin_u64_sum(insns);
+
+    qemu_plugin_u64_array_sum(
+        qemu_plugin_scoreboard_u64_in_struct(counters, VcpuCounters, hist),
+        hist, HIST_BUCKETS);
+
+    g_string_append_printf(report, "vcpus: %d\n", qemu_plugin_num_vcpus());
+    g_string_append_printf(report, "insns: %" PRIu64 " (min %" PRIu64
+                           ", max %" PRIu64 " per vcpu)\n", total,
+                           qemu_plugin_u64_min(insns),
+                           qemu_plugin_u64_max(insns));
+    g_string_append_printf(report, "blocks: %" PRIu64 "\n",
+                           qemu_plugin_u64_sum(blocks));
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        g_string_append_printf(report, "  %s%d insns: %" PRIu64 "\n",
+                               i == HIST_BUCKETS - 1 ? ">=" : "<",
+                               1 << (i == HIST_BUCKETS - 1 ? i : i + 1),
+                               hist[i]);
+    }
+    g_string_append_printf(report, "elapsed: %.3fs, %.2f MIPS\n",
+                           secs, secs > 0 ? total / secs / 1e6 : 0);
+    qemu_plugin_outs(report->str);
+
+    qemu_plugin_scoreboard_free(counters);
+}
+
+static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
+{
+    size_t n = qemu_plugin_tb_n_insns(tb);
+    int bucket = MIN(g_bit_storage(MAX(n, 1)) - 1, HIST_BUCKETS - 1);
+    qemu_plugin_u64 hist = qemu_plugin_scoreboard_u64_in_struct(
+        counters, VcpuCounters, hist);
+
+    hist.offset += bucket * sizeof(uint64_t);
+    qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+        tb, QEMU_PLUGIN_INLINE_ADD_U64, insns, n);
+    qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+        tb, QEMU_PLUGIN_INLINE_ADD_U64, blocks, 1);
+    qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+        tb, QEMU_PLUGIN_INLINE_ADD_U64, hist, 1);
+}
+
+QEMU_PLUGIN_EXPORT
+int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
+                        int argc, char **argv)
+{
+    if (argc) {
+        fprintf(stderr, "option parsing failed: %s\n", argv[0]);
+        return -1;
+    }
+
+    counters = qemu_plugin_scoreboard_new(sizeof(VcpuCounters));
+    insns = qemu_plugin_scoreboard_u64_in_struct(counters, VcpuCounters,
+                                                 insns);
+    blocks = qemu_plugin_scoreboard_u64_in_struct(counters, VcpuCounters,
+                                                  blocks);
+    start_time = g_get_monotonic_time();
+
+    qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
+    qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
+    return 0;
+}
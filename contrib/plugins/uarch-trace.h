@@ -0,0 +1,118 @@
+/*
+ * Binary execution trace format shared by the uarchtrace plugin and
+ * the uarch-sim offline simulator.
+ *
+ * Copyright (C) 2025, The QEMU Project Developers
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#ifndef UARCH_TRACE_H
+#define UARCH_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A trace starts with a UarchTraceHeader followed by chunks. Each chunk
+ * is a UarchTraceChunk followed by @len bytes of records produced by a
+ * single vCPU. Chunks of different vCPUs are interleaved in the order
+ * they were filled, records within a vCPU are in execution order.
+ * When @flags has UT_CHUNK_ZSTD the @len bytes are a zstd frame that
+ * decompresses to @raw_len bytes of records, otherwise @raw_len is
+ * equal to @len.
+ *
+ * Records start with a tag byte. Addresses are encoded as the zigzag
+ * LEB128 delta from the previous address of the same kind in the chunk,
+ * both deltas start from 0 at the beginning of every chunk so chunks
+ * can be decoded independently:
+ *
+ *   UT_BLOCK:           pc delta, size in bytes, offset of the last insn
+ *   UT_LOAD / UT_STORE: address delta, tag bits 2-4 hold log2 of the size
+ *
+ * Header fields are little endian.
+ */
+#define UT_MAGIC   0x43525455 /* "UTRC" */
+#define UT_VERSION 2
+
+enum {
+    UT_BLOCK,
+    UT_LOAD,
+    UT_STORE,
+};
+
+#define UT_KIND_MASK  3
+#define UT_SIZE_SHIFT 2
+
+/* UarchTraceChunk flags */
+#define UT_CHUNK_ZSTD 1
+
+/* upper bound of the encoded size of one record */
+#define UT_RECORD_MAX 32
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} UarchTraceHeader;
+
+typedef struct {
+    uint32_t vcpu;
+    uint32_t len;
+    uint32_t flags;
+    uint32_t raw_len;
+} UarchTraceChunk;
+
+static inline uint8_t *ut_put_uleb(uint8_t *p, uint64_t val)
+{
+    while (val >= 0x80) {
+        *p++ = val | 0x80;
+        val >>= 7;
+    }
+    *p++ = val;
+    return p;
+}
+
+static inline uint8_t *ut_put_delta(uint8_t *p, uint64_t val, uint64_t *prev)
+{
+    int64_t delta = val - *prev;
+
+    *prev = val;
+    return ut_put_uleb(p, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+}
+
+/* Returns false if the record is truncated */
+static inline bool ut_get_uleb(const uint8_t **p, const uint8_t *end,
+                               uint64_t *val)
+{
+    uint64_t res = 0;
+    int shift = 0;
+
+    while (*p < end && shift < 64) {
+        uint8_t byte = *(*p)++;
+
+        res |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *val = res;
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
+
+static inline bool ut_get_delta(const uint8_t **p, const uint8_t *end,
+                                uint64_t *prev)
+{
+    uint64_t zz;
+
+    if (!ut_get_uleb(p, end, &zz)) {
+        return false;
+    }
+    *prev += (zz >> 1) ^ -(zz & 1);
+    return true;
+}
+
+#endif /* UARCH_TRACE_H */
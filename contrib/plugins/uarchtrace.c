@@ -0,0 +1,365 @@
+/*
+ * Compact binary trace of executed blocks and memory accesses
+ *
+ * Every vCPU encodes its block and memory records into a private
+ * buffer. Full buffers are handed to a writer thread which appends them
+ * to the trace file, so vCPUs never contend on the output. When built
+ * with zstd the writer compresses every buffer before writing it. The file
+ * (which may be a named pipe) is meant to be replayed by the uarch-sim
+ * tool against cache and branch predictor models, see uarch-trace.h for
+ * the format.
+ *
+ * Copyright (C) 2025, The QEMU Project Developers
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <glib.h>
+#ifdef UARCH_TRACE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <qemu-plugin.h>
+
+#include "uarch-trace.h"
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_version = QEMU_PLUGIN_VERSION;
+
+typedef struct {
+    uint64_t vaddr;
+    uint32_t size;
+    uint32_t last_insn;
+} BlockInfo;
+
+typedef struct {
+    uint32_t vcpu;
+    uint32_t len;
+    uint8_t *data;
+} TraceBuf;
+
+typedef struct {
+    /* taken by the owning vCPU and by plugin_exit */
+    GMutex lock;
+    TraceBuf *buf;
+    uint64_t prev_pc;
+    uint64_t prev_addr;
+} VcpuTrace;
+
+static struct qemu_plugin_scoreboard *vcpus;
+static size_t chunk_size = 64 * 1024;
+static bool trace_mem = true;
+static gint closed;
+#ifdef UARCH_TRACE_ZSTD
+static bool compress = true;
+static ZSTD_CCtx *zctx;
+static void *zbuf;
+static size_t zbuf_size;
+#else
+static bool compress;
+#endif
+
+static FILE *out;
+static GThread *writer;
+/* buffers waiting to be written and buffers ready for reuse */
+static GAsyncQueue *full_bufs;
+static GAsyncQueue *free_bufs;
+static uint64_t bytes_written;
+
+/* Plugins need to take care of their own locking */
+static GMutex lock;
+static GPtrArray *blocks;
+
+static gpointer writer_thread(gpointer opaque)
+{
+    TraceBuf *buf;
+
+    while ((buf = g_async_queue_pop(full_bufs))->data) {
+        UarchTraceChunk hdr = {
+            .vcpu = GUINT32_TO_LE(buf->vcpu),
+            .raw_len = GUINT32_TO_LE(buf->len),
+        };
+        const void *data = buf->data;
+        uint32_t len = buf->len;
+
+#ifdef UARCH_TRACE_ZSTD
+        if (zctx) {
+            size_t n = ZSTD_compressCCtx(zctx, zbuf, zbuf_size,
+                                         buf->data, buf->len, 1);
+
+            /* keep incompressible buffers as they are */
+            if (!ZSTD_isError(n) && n < buf->len) {
+                data = zbuf;
+                len = n;
+                hdr.flags = GUINT32_TO_LE(UT_CHUNK_ZSTD);
+            }
+        }
+#endif
+        hdr.len = GUINT32_TO_LE(len);
+        if (fwrite(&hdr, sizeof(hdr), 1, out) != 1 ||
+            fwrite(data, len, 1, out) != 1) {
+            fprintf(stderr, "uarchtrace: write failed\n");
+        }
+        bytes_written += sizeof(hdr) + len;
+        g_async_queue_push(free_bufs, buf);
+    }
+    g_free(buf);
+    return NULL;
+}
+
+static TraceBuf *get_buf(unsigned int vcpu_index)
+{
+    TraceBuf *buf = g_async_queue_try_pop(free_bufs);
+
+    if (!buf) {
+        buf = g_new(TraceBuf, 1);
+        buf->data = g_malloc(chunk_size + UT_RECORD_MAX);
+    }
+    buf->vcpu = vcpu_index;
+    buf->len = 0;
+    return buf;
+}
+
+/* Called with vt->lock held */
+static void flush_vcpu(VcpuTrace *vt)
+{
+    if (vt->buf && vt->buf->len) {
+        g_async_queue_push(full_bufs, vt->buf);
+        vt->buf = NULL;
+    }
+    vt->prev_pc = 0;
+    vt->prev_addr = 0;
+}
+
+/*
+ * Returns where the next record of @vcpu_index goes, flushing the
+ * current buffer first when it is full. Returns NULL once the trace is
+ * closed, otherwise the caller must drop vt->lock when done.
+ */
+static VcpuTrace *vcpu_trace(unsigned int vcpu_index)
+{
+    VcpuTrace *vt = qemu_plugin_scoreboard_find(vcpus, vcpu_index);
+
+    g_mutex_lock(&vt->lock);
+    if (g_atomic_int_get(&closed)) {
+        g_mutex_unlock(&vt->lock);
+        return NULL;
+    }
+    if (vt->buf && vt->buf->len >= chunk_size) {
+        flush_vcpu(vt);
+    }
+    if (!vt->buf) {
+        vt->buf = get_buf(vcpu_index);
+    }
+    return vt;
+}
+
+static void vcpu_tb_exec(unsigned int vcpu_index, void *udata)
+{
+    BlockInfo *bi = udata;
+    VcpuTrace *vt;
+    uint8_t *start, *p;
+
+    vt = vcpu_trace(vcpu_index);
+    if (!vt) {
+        return;
+    }
+    start = p = vt->buf->data + vt->buf->len;
+    *p++ = UT_BLOCK;
+    p = ut_put_delta(p, bi->vaddr, &vt->prev_pc);
+    p = ut_put_uleb(p, bi->size);
+    p = ut_put_uleb(p, bi->last_insn);
+    vt->buf->len += p - start;
+    g_mutex_unlock(&vt->lock);
+}
+
+static void vcpu_mem(unsigned int vcpu_index, qemu_plugin_meminfo_t info,
+                     uint64_t vaddr, void *udata)
+{
+    struct qemu_plugin_hwaddr *hwaddr = qemu_plugin_get_hwaddr(info, vaddr);
+    bool store = qemu_plugin_mem_is_store(info);
+    VcpuTrace *vt;
+    uint8_t *start, *p;
+
+    if (hwaddr && qemu_plugin_hwaddr_is_io(hwaddr)) {
+        return;
+    }
+    vt = vcpu_trace(vcpu_index);
+    if (!vt) {
+        return;
+    }
+    start = p = vt->buf->data + vt->buf->len;
+    *p++ = (store ? UT_STORE : UT_LOAD) |
+           (qemu_plugin_mem_size_shift(info) << UT_SIZE_SHIFT);
+    p = ut_put_delta(p, hwaddr ? qemu_plugin_hwaddr_phys_addr(hwaddr) : vaddr,
+                     &vt->prev_addr);
+    vt->buf->len += p - start;
+    g_mutex_unlock(&vt->lock);
+}
+
+static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
+{
+    size_t n_insns = qemu_plugin_tb_n_insns(tb);
+    struct qemu_plugin_insn *last = qemu_plugin_tb_get_insn(tb, n_insns - 1);
+    uint64_t vaddr = qemu_plugin_tb_vaddr(tb);
+    uint64_t last_vaddr = qemu_plugin_insn_vaddr(last);
+    uint32_t size = last_vaddr - vaddr + qemu_plugin_insn_size(last);
+    BlockInfo *bi = g_new(BlockInfo, 1);
+
+    bi->vaddr = vaddr;
+    bi->size = size;
+    bi->last_insn = last_vaddr - vaddr;
+    g_mutex_lock(&lock);
+    g_ptr_array_add(blocks, bi);
+    g_mutex_unlock(&lock);
+
+    qemu_plugin_register_vcpu_tb_exec_cb(tb, vcpu_tb_exec,
+                                         QEMU_PLUGIN_CB_NO_REGS, bi);
+    if (trace_mem) {
+        for (size_t i = 0; i < n_insns; i++) {
+            qemu_plugin_register_vcpu_mem_cb(qemu_plugin_tb_get_insn(tb, i),
+                                             vcpu_mem, QEMU_PLUGIN_CB_NO_REGS,
+                                             QEMU_PLUGIN_MEM_RW, NULL);
+        }
+    }
+}
+
+static void vcpu_init(qemu_plugin_id_t id, unsigned int vcpu_index)
+{
+    VcpuTrace *vt = qemu_plugin_scoreboard_find(vcpus, vcpu_index);
+
+    g_mutex_init(&vt->lock);
+}
+
+static void vcpu_exit(qemu_plugin_id_t id, unsigned int vcpu_index)
+{
+    VcpuTrace *vt = qemu_plugin_scoreboard_find(vcpus, vcpu_index);
+
+    g_mutex_lock(&vt->lock);
+    flush_vcpu(vt);
+    g_mutex_unlock(&vt->lock);
+}
+
+static void plugin_exit(qemu_plugin_id_t id, void *p)
+{
+    g_autoptr(GString) report = g_string_new(NULL);
+    TraceBuf *buf;
+
+    /*
+     * vCPUs may still be running, the lock orders their last record
+     * before the flush and they see @closed afterwards.
+     */
+    g_atomic_int_set(&closed, true);
+    for (int i = 0; i < qemu_plugin_num_vcpus(); i++) {
+        VcpuTrace *vt = qemu_plugin_scoreboard_find(vcpus, i);
+
+        g_mutex_lock(&vt->lock);
+        flush_vcpu(vt);
+        g_mutex_unlock(&vt->lock);
+    }
+    /* a buffer without data stops the writer */
+    g_async_queue_push(full_bufs, g_new0(TraceBuf, 1));
+    g_thread_join(writer);
+    fclose(out);
+#ifdef UARCH_TRACE_ZSTD
+    ZSTD_freeCCtx(zctx);
+    g_free(zbuf);
+#endif
+
+    g_string_printf(report, "uarchtrace: %" PRIu64 " bytes written\n",
+                    bytes_written);
+    qemu_plugin_outs(report->str);
+
+    while ((buf = g_async_queue_try_pop(free_bufs))) {
+        g_free(buf->data);
+        g_free(buf);
+    }
+    g_async_queue_unref(full_bufs);
+    g_async_queue_unref(free_bufs);
+    g_ptr_array_free(blocks, true);
+    qemu_plugin_scoreboard_free(vcpus);
+}
+
+QEMU_PLUGIN_EXPORT
+int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
+                        int argc, char **argv)
+{
+    UarchTraceHeader hdr = {
+        .magic = GUINT32_TO_LE(UT_MAGIC),
+        .version = GUINT32_TO_LE(UT_VERSION),
+    };
+    g_autofree char *path = NULL;
+
+    for (int i = 0; i < argc; i++) {
+        char *opt = argv[i];
+        g_auto(GStrv) tokens = g_strsplit(opt, "=", 2);
+        if (g_strcmp0(tokens[0], "file") == 0) {
+            g_free(path);
+            path = g_strdup(tokens[1]);
+        } else if (g_strcmp0(tokens[0], "mem") == 0) {
+            if (!qemu_plugin_bool_parse(tokens[0], tokens[1], &trace_mem)) {
+                fprintf(stderr, "boolean argument parsing failed: %s\n", opt);
+                return -1;
+            }
+        } else if (g_strcmp0(tokens[0], "compress") == 0) {
+            if (!qemu_plugin_bool_parse(tokens[0], tokens[1], &compress)) {
+                fprintf(stderr, "boolean argument parsing failed: %s\n", opt);
+                return -1;
+            }
+        } else if (g_strcmp0(tokens[0], "chunk") == 0) {
+            chunk_size = g_ascii_strtoull(tokens[1], NULL, 10);
+            if (chunk_size < 1024 || chunk_size > G_MAXINT32) {
+                fprintf(stderr, "invalid chunk size: %s\n", opt);
+                return -1;
+            }
+        } else {
+            fprintf(stderr, "option parsing failed: %s\n", opt);
+            return -1;
+        }
+    }
+
+    if (!path) {
+        fprintf(stderr, "uarchtrace: file=PATH is required\n");
+        return -1;
+    }
+#ifdef UARCH_TRACE_ZSTD
+    if (compress) {
+        zctx = ZSTD_createCCtx();
+        zbuf_size = ZSTD_compressBound(chunk_size + UT_RECORD_MAX);
+        zbuf = g_malloc(zbuf_size);
+    }
+#else
+    if (compress) {
+        fprintf(stderr, "uarchtrace: built without zstd, "
+                "compress=on is not supported\n");
+        return -1;
+    }
+#endif
+    out = fopen(path, "wb");
+    if (!out) {
+        fprintf(stderr, "uarchtrace: cannot open %s: %s\n", path,
+                g_strerror(errno));
+        return -1;
+    }
+    if (fwrite(&hdr, sizeof(hdr), 1, out) != 1) {
+        fprintf(stderr, "uarchtrace: cannot write %s\n", path);
+        fclose(out);
+        return -1;
+    }
+
+    vcpus = qemu_plugin_scoreboard_new(sizeof(VcpuTrace));
+    blocks = g_ptr_array_new_with_free_func(g_free);
+    full_bufs = g_async_queue_new();
+    free_bufs = g_async_queue_new();
+    writer = g_thread_new("uarchtrace", writer_thread, NULL);
+
+    qemu_plugin_register_vcpu_init_cb(id, vcpu_init);
+    qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
+    qemu_plugin_register_vcpu_exit_cb(id, vcpu_exit);
+    qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
+    return 0;
+}
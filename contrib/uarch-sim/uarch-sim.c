@@ -0,0 +1,532 @@
+/*
+ * Offline cache and branch predictor simulator
+ *
+ * Replays a trace written by the uarchtrace plugin against a per-vCPU
+ * hierarchy of L1 instruction, L1 data and unified L2 caches and a
+ * conditional branch predictor. Branches are inferred from the block
+ * stream: the last instruction of a block is treated as taken when the
+ * next block does not start right after it.
+ *
+ * vCPUs are independent so they are spread over worker threads, the
+ * main thread only reads the trace and hands chunks out.
+ *
+ * Copyright (C) 2025, The QEMU Project Developers
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#ifdef UARCH_TRACE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "uarch-trace.h"
+
+/* chunks read ahead of the workers */
+#define MAX_IN_FLIGHT 256
+
+typedef struct {
+    uint64_t tag;
+    uint64_t lru;
+    bool valid;
+} CacheBlock;
+
+typedef struct {
+    CacheBlock *blocks;
+    uint64_t clock;
+} CacheSet;
+
+typedef struct {
+    CacheSet *sets;
+    int assoc;
+    int blksize_shift;
+    uint64_t set_mask;
+    uint64_t accesses;
+    uint64_t misses;
+} Cache;
+
+typedef struct {
+    int size;
+    int assoc;
+    int blksize;
+} CacheConfig;
+
+typedef enum {
+    BP_BIMODAL,
+    BP_GSHARE,
+} PredictorKind;
+
+typedef struct {
+    PredictorKind kind;
+    uint8_t *counters;
+    uint64_t mask;
+    uint64_t history;
+    uint64_t branches;
+    uint64_t mispredicts;
+} Predictor;
+
+typedef struct {
+    unsigned int index;
+    Cache *l1i, *l1d, *l2;
+    Predictor bp;
+    /* last block, its final instruction is the pending branch */
+    bool have_block;
+    uint64_t block_end;
+    uint64_t branch_pc;
+    uint64_t blocks;
+    uint64_t loads;
+    uint64_t stores;
+    uint64_t bad_records;
+} VcpuSim;
+
+typedef struct {
+    VcpuSim *sim;
+    uint32_t len;
+    uint32_t flags;
+    uint32_t raw_len;
+    uint8_t data[];
+} Chunk;
+
+static CacheConfig l1i_cfg = { 32768, 8, 64 };
+static CacheConfig l1d_cfg = { 32768, 8, 64 };
+static CacheConfig l2_cfg = { 2097152, 16, 64 };
+static PredictorKind bp_kind = BP_GSHARE;
+static int bp_bits = 14;
+
+static GMutex flight_lock;
+static GCond flight_cond;
+static int in_flight;
+
+static Cache *cache_new(const CacheConfig *cfg)
+{
+    Cache *cache = g_new0(Cache, 1);
+    int nsets = cfg->size / (cfg->blksize * cfg->assoc);
+
+    cache->sets = g_new(CacheSet, nsets);
+    for (int i = 0; i < nsets; i++) {
+        cache->sets[i].blocks = g_new0(CacheBlock, cfg->assoc);
+        cache->sets[i].clock = 0;
+    }
+    cache->assoc = cfg->assoc;
+    cache->blksize_shift = g_bit_nth_lsf(cfg->blksize, -1);
+    cache->set_mask = nsets - 1;
+    return cache;
+}
+
+/* Returns true on a hit, on a miss the least recently used block goes */
+static bool cache_access(Cache *cache, uint64_t addr)
+{
+    uint64_t blk = addr >> cache->blksize_shift;
+    CacheSet *set = &cache->sets[blk & cache->set_mask];
+    int victim = 0;
+
+    cache->accesses++;
+    set->clock++;
+    for (int i = 0; i < cache->assoc; i++) {
+        CacheBlock *b = &set->blocks[i];
+
+        if (b->valid && b->tag == blk) {
+            b->lru = set->clock;
+            return true;
+        }
+        if (!b->valid ||
+            (set->blocks[victim].valid && b->lru < set->blocks[victim].lru)) {
+            victim = i;
+        }
+    }
+    cache->misses++;
+    set->blocks[victim].tag = blk;
+    set->blocks[victim].valid = true;
+    set->blocks[victim].lru = set->clock;
+    return false;
+}
+
+static void cache_free(Cache *cache)
+{
+    for (uint64_t i = 0; i <= cache->set_mask; i++) {
+        g_free(cache->sets[i].blocks);
+    }
+    g_free(cache->sets);
+    g_free(cache);
+}
+
+static void predictor_init(Predictor *bp, PredictorKind kind, int bits)
+{
+    bp->kind = kind;
+    bp->mask = (1ull << bits) - 1;
+    bp->counters = g_malloc(1ull << bits);
+    /* weakly taken */
+    memset(bp->counters, 2, 1ull << bits);
+}
+
+static void predictor_update(Predictor *bp, uint64_t pc, bool taken)
+{
+    uint64_t idx = pc >> 1;
+    uint8_t *ctr;
+
+    if (bp->kind == BP_GSHARE) {
+        idx ^= bp->history;
+        bp->history = (bp->history << 1) | taken;
+    }
+    ctr = &bp->counters[idx & bp->mask];
+
+    bp->branches++;
+    if ((*ctr >= 2) != taken) {
+        bp->mispredicts++;
+    }
+    if (taken && *ctr < 3) {
+        (*ctr)++;
+    } else if (!taken && *ctr > 0) {
+        (*ctr)--;
+    }
+}
+
+static VcpuSim *vcpu_sim_new(unsigned int index)
+{
+    VcpuSim *sim = g_new0(VcpuSim, 1);
+
+    sim->index = index;
+    sim->l1i = cache_new(&l1i_cfg);
+    sim->l1d = cache_new(&l1d_cfg);
+    sim->l2 = cache_new(&l2_cfg);
+    predictor_init(&sim->bp, bp_kind, bp_bits);
+    return sim;
+}
+
+static void vcpu_sim_free(VcpuSim *sim)
+{
+    cache_free(sim->l1i);
+    cache_free(sim->l1d);
+    cache_free(sim->l2);
+    g_free(sim->bp.counters);
+    g_free(sim);
+}
+
+static void sim_fetch(VcpuSim *sim, uint64_t pc, uint64_t size,
+                      uint64_t last_insn)
+{
+    uint64_t blksize = 1ull << sim->l1i->blksize_shift;
+    uint64_t addr = pc & ~(blksize - 1);
+
+    if (sim->have_block) {
+        predictor_update(&sim->bp, sim->branch_pc, pc != sim->block_end);
+    }
+    sim->have_block = true;
+    sim->block_end = pc + size;
+    sim->branch_pc = pc + last_insn;
+    sim->blocks++;
+
+    for (; addr < pc + size; addr += blksize) {
+        if (!cache_access(sim->l1i, addr)) {
+            cache_access(sim->l2, addr);
+        }
+    }
+}
+
+static void sim_chunk(VcpuSim *sim, const uint8_t *p, size_t len)
+{
+    const uint8_t *end = p + len;
+    uint64_t pc = 0, addr = 0, size, last_insn;
+
+    while (p < end) {
+        uint8_t tag = *p++;
+
+        switch (tag & UT_KIND_MASK) {
+        case UT_BLOCK:
+            if (!ut_get_delta(&p, end, &pc) ||
+                !ut_get_uleb(&p, end, &size) ||
+                !ut_get_uleb(&p, end, &last_insn)) {
+                goto bad;
+            }
+            sim_fetch(sim, pc, size, last_insn);
+            break;
+        case UT_LOAD:
+        case UT_STORE:
+            if (!ut_get_delta(&p, end, &addr)) {
+                goto bad;
+            }
+            if ((tag & UT_KIND_MASK) == UT_STORE) {
+                sim->stores++;
+            } else {
+                sim->loads++;
+            }
+            if (!cache_access(sim->l1d, addr)) {
+                cache_access(sim->l2, addr);
+            }
+            break;
+        default:
+            goto bad;
+        }
+    }
+    return;
+
+bad:
+    /* the rest of the chunk cannot be decoded */
+    sim->bad_records++;
+}
+
+static gpointer worker_thread(gpointer opaque)
+{
+    GAsyncQueue *queue = opaque;
+    Chunk *chunk;
+#ifdef UARCH_TRACE_ZSTD
+    ZSTD_DCtx *zctx = ZSTD_createDCtx();
+    g_autofree uint8_t *raw = NULL;
+    size_t raw_size = 0;
+#endif
+
+    while ((chunk = g_async_queue_pop(queue))->sim) {
+#ifdef UARCH_TRACE_ZSTD
+        if (chunk->flags & UT_CHUNK_ZSTD) {
+            size_t n;
+
+            if (raw_size < chunk->raw_len) {
+                raw_size = chunk->raw_len;
+                raw = g_realloc(raw, raw_size);
+            }
+            n = ZSTD_decompressDCtx(zctx, raw, raw_size,
+                                    chunk->data, chunk->len);
+            if (ZSTD_isError(n) || n != chunk->raw_len) {
+                chunk->sim->bad_records++;
+            } else {
+                sim_chunk(chunk->sim, raw, n);
+            }
+        } else
+#endif
+        {
+            sim_chunk(chunk->sim, chunk->data, chunk->len);
+        }
+        g_free(chunk);
+
+        g_mutex_lock(&flight_lock);
+        in_flight--;
+        g_cond_signal(&flight_cond);
+        g_mutex_unlock(&flight_lock);
+    }
+    g_free(chunk);
+#ifdef UARCH_TRACE_ZSTD
+    ZSTD_freeDCtx(zctx);
+#endif
+    return NULL;
+}
+
+static void report_cache(const char *name, Cache *cache)
+{
+    printf("  %-4s %12" PRIu64 " accesses %12" PRIu64 " misses %6.2f%%\n",
+           name, cache->accesses, cache->misses,
+           cache->accesses ? cache->misses * 100.0 / cache->accesses : 0);
+}
+
+static void report(VcpuSim *sim)
+{
+    printf("vcpu %u: %" PRIu64 " blocks, %" PRIu64 " loads, %" PRIu64
+           " stores\n", sim->index, sim->blocks, sim->loads, sim->stores);
+    report_cache("l1i", sim->l1i);
+    report_cache("l1d", sim->l1d);
+    report_cache("l2", sim->l2);
+    printf("  bp   %12" PRIu64 " branches %12" PRIu64 " mispred %5.2f%%\n",
+           sim->bp.branches, sim->bp.mispredicts,
+           sim->bp.branches ?
+           sim->bp.mispredicts * 100.0 / sim->bp.branches : 0);
+    if (sim->bad_records) {
+        printf("  %" PRIu64 " truncated chunks\n", sim->bad_records);
+    }
+}
+
+static bool parse_cache(const char *opt, const char *arg, CacheConfig *cfg)
+{
+    CacheConfig c;
+
+    if (sscanf(arg, "%d,%d,%d", &c.size, &c.assoc, &c.blksize) != 3 ||
+        c.size <= 0 || c.assoc <= 0 || c.blksize <= 0 ||
+        (c.blksize & (c.blksize - 1)) ||
+        c.size % (c.blksize * c.assoc) ||
+        ((c.size / (c.blksize * c.assoc)) &
+         (c.size / (c.blksize * c.assoc) - 1))) {
+        fprintf(stderr, "%s: expected SIZE,ASSOC,BLKSIZE with a power of two "
+                "number of sets and block size: %s\n", opt, arg);
+        return false;
+    }
+    *cfg = c;
+    return true;
+}
+
+static gboolean parse_cache_opt(const gchar *opt, const gchar *arg,
+                                gpointer data, GError **errp)
+{
+    CacheConfig *cfg = g_str_equal(opt, "--l1i") ? &l1i_cfg :
+                       g_str_equal(opt, "--l1d") ? &l1d_cfg : &l2_cfg;
+
+    if (!parse_cache(opt, arg, cfg)) {
+        g_set_error(errp, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                    "invalid cache geometry");
+        return false;
+    }
+    return true;
+}
+
+static gboolean parse_bp_opt(const gchar *opt, const gchar *arg,
+                             gpointer data, GError **errp)
+{
+    g_auto(GStrv) tokens = g_strsplit(arg, ":", 2);
+
+    if (g_str_equal(tokens[0], "bimodal")) {
+        bp_kind = BP_BIMODAL;
+    } else if (g_str_equal(tokens[0], "gshare")) {
+        bp_kind = BP_GSHARE;
+    } else {
+        g_set_error(errp, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                    "unknown predictor %s", tokens[0]);
+        return false;
+    }
+    if (tokens[1]) {
+        bp_bits = atoi(tokens[1]);
+        if (bp_bits < 1 || bp_bits > 30) {
+            g_set_error(errp, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                        "predictor table bits out of range: %s", tokens[1]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int threads = g_get_num_processors();
+    g_autoptr(GError) err = NULL;
+    g_autoptr(GOptionContext) context = NULL;
+    GOptionEntry entries[] = {
+        { "threads", 'j', 0, G_OPTION_ARG_INT, &threads,
+          "number of worker threads", "N" },
+        { "l1i", 0, 0, G_OPTION_ARG_CALLBACK, parse_cache_opt,
+          "L1 instruction cache geometry (32768,8,64)", "SIZE,ASSOC,BLK" },
+        { "l1d", 0, 0, G_OPTION_ARG_CALLBACK, parse_cache_opt,
+          "L1 data cache geometry (32768,8,64)", "SIZE,ASSOC,BLK" },
+        { "l2", 0, 0, G_OPTION_ARG_CALLBACK, parse_cache_opt,
+          "unified L2 cache geometry (2097152,16,64)", "SIZE,ASSOC,BLK" },
+        { "predictor", 'b', 0, G_OPTION_ARG_CALLBACK, parse_bp_opt,
+          "branch predictor (gshare:14)", "bimodal|gshare[:BITS]" },
+        { NULL }
+    };
+    UarchTraceHeader hdr;
+    UarchTraceChunk ch;
+    GAsyncQueue **queues;
+    GThread **workers;
+    GPtrArray *sims;
+    FILE *in;
+    int ret = EXIT_SUCCESS;
+
+    context = g_option_context_new("TRACE - replay a uarchtrace trace");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &err)) {
+        fprintf(stderr, "%s\n", err->message);
+        return EXIT_FAILURE;
+    }
+    if (argc != 2) {
+        fprintf(stderr, "expected a single trace file (or - for stdin)\n");
+        return EXIT_FAILURE;
+    }
+    threads = MAX(threads, 1);
+
+    in = g_str_equal(argv[1], "-") ? stdin : fopen(argv[1], "rb");
+    if (!in) {
+        fprintf(stderr, "cannot open %s: %s\n", argv[1], g_strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (fread(&hdr, sizeof(hdr), 1, in) != 1 ||
+        GUINT32_FROM_LE(hdr.magic) != UT_MAGIC ||
+        GUINT32_FROM_LE(hdr.version) != UT_VERSION) {
+        fprintf(stderr, "%s: not a version %d uarchtrace file\n",
+                argv[1], UT_VERSION);
+        return EXIT_FAILURE;
+    }
+
+    sims = g_ptr_array_new();
+    queues = g_new(GAsyncQueue *, threads);
+    workers = g_new(GThread *, threads);
+    for (int i = 0; i < threads; i++) {
+        queues[i] = g_async_queue_new();
+        workers[i] = g_thread_new("uarch-sim", worker_thread, queues[i]);
+    }
+
+    while (fread(&ch, sizeof(ch), 1, in) == 1) {
+        unsigned int vcpu = GUINT32_FROM_LE(ch.vcpu);
+        uint32_t len = GUINT32_FROM_LE(ch.len);
+        uint32_t flags = GUINT32_FROM_LE(ch.flags);
+        Chunk *chunk;
+
+        if (flags & ~UT_CHUNK_ZSTD) {
+            fprintf(stderr, "%s: unknown chunk flags 0x%" PRIx32 "\n",
+                    argv[1], flags);
+            ret = EXIT_FAILURE;
+            break;
+        }
+#ifndef UARCH_TRACE_ZSTD
+        if (flags & UT_CHUNK_ZSTD) {
+            fprintf(stderr, "%s: compressed trace, uarch-sim was built "
+                    "without zstd\n", argv[1]);
+            ret = EXIT_FAILURE;
+            break;
+        }
+#endif
+        chunk = g_malloc(sizeof(Chunk) + len);
+        if (fread(chunk->data, len, 1, in) != 1) {
+            fprintf(stderr, "%s: truncated chunk\n", argv[1]);
+            g_free(chunk);
+            ret = EXIT_FAILURE;
+            break;
+        }
+        if (vcpu >= sims->len) {
+            g_ptr_array_set_size(sims, vcpu + 1);
+        }
+        if (!g_ptr_array_index(sims, vcpu)) {
+            g_ptr_array_index(sims, vcpu) = vcpu_sim_new(vcpu);
+        }
+        chunk->sim = g_ptr_array_index(sims, vcpu);
+        chunk->len = len;
+        chunk->flags = flags;
+        chunk->raw_len = GUINT32_FROM_LE(ch.raw_len);
+
+        g_mutex_lock(&flight_lock);
+        while (in_flight >= MAX_IN_FLIGHT) {
+            g_cond_wait(&flight_cond, &flight_lock);
+        }
+        in_flight++;
+        g_mutex_unlock(&flight_lock);
+
+        /* a vCPU always goes to the same worker to keep its order */
+        g_async_queue_push(queues[vcpu % threads], chunk);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        g_async_queue_push(queues[i], g_new0(Chunk, 1));
+    }
+    for (int i = 0; i < threads; i++) {
+        g_thread_join(workers[i]);
+        g_async_queue_unref(queues[i]);
+    }
+
+    for (guint i = 0; i < sims->len; i++) {
+        VcpuSim *sim = g_ptr_array_index(sims, i);
+
+        if (sim) {
+            report(sim);
+            vcpu_sim_free(sim);
+        }
+    }
+
+    g_ptr_array_free(sims, true);
+    g_free(queues);
+    g_free(workers);
+    if (in != stdin) {
+        fclose(in);
+    }
+    return ret;
+}
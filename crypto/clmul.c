@@ -109,3 +109,46 @@ Int128 clmul_64_gen(uint64_t n, uint64_t m)
     }
     return int128_make128(rl, rh);
 }
+
+void clmul_64_vec(uint64_t *lo, uint64_t *hi, const uint64_t *a,
+                  const uint64_t *b, size_t b_stride, size_t n)
+{
+    size_t i = 0;
+
+    if (HAVE_CLMUL_X4_ACCEL) {
+        for (; i + 4 <= n; i += 4) {
+            clmul_64x4_accel(lo ? lo + i : NULL, hi ? hi + i : NULL,
+                             a + i, b + i * b_stride, b_stride);
+        }
+    }
+    for (; i < n; i++) {
+        Int128 r = clmul_64(a[i], b[i * b_stride]);
+
+        if (lo) {
+            lo[i] = int128_getlo(r);
+        }
+        if (hi) {
+            hi[i] = int128_gethi(r);
+        }
+    }
+}
+
+void clmul_gf128_mul(uint64_t *z, const uint64_t *x, const uint64_t *y)
+{
+    Int128 lo = clmul_64(x[0], y[0]);
+    Int128 hi = clmul_64(x[1], y[1]);
+    Int128 mid = int128_xor(clmul_64(x[0], y[1]), clmul_64(x[1], y[0]));
+    uint64_t r0 = int128_getlo(lo);
+    uint64_t r1 = int128_gethi(lo) ^ int128_getlo(mid);
+    uint64_t r2 = int128_getlo(hi) ^ int128_gethi(mid);
+    uint64_t r3 = int128_gethi(hi);
+    Int128 t;
+
+    /* fold the upper half back, using x^128 = x^7 + x^2 + x + 1 */
+    t = clmul_64(r3, 0x87);
+    r1 ^= int128_getlo(t);
+    r2 ^= int128_gethi(t);
+    t = clmul_64(r2, 0x87);
+    z[0] = r0 ^ int128_getlo(t);
+    z[1] = r1 ^ int128_gethi(t);
+}
@@ -0,0 +1,76 @@
+/*
+ * SHA-256 round fragments, generic version
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/bitops.h"
+#include "crypto/sha2-round.h"
+
+static inline uint32_t sum0(uint32_t x)
+{
+    return ror32(x, 2) ^ ror32(x, 13) ^ ror32(x, 22);
+}
+
+static inline uint32_t sum1(uint32_t x)
+{
+    return ror32(x, 6) ^ ror32(x, 11) ^ ror32(x, 25);
+}
+
+static inline uint32_t sig0(uint32_t x)
+{
+    return ror32(x, 7) ^ ror32(x, 18) ^ (x >> 3);
+}
+
+static inline uint32_t sig1(uint32_t x)
+{
+    return ror32(x, 17) ^ ror32(x, 19) ^ (x >> 10);
+}
+
+void sha256_rnds2_gen(uint32_t *ret, const uint32_t *cdgh,
+                      const uint32_t *abef, const uint32_t *wk)
+{
+    uint32_t a = abef[3], b = abef[2], e = abef[1], f = abef[0];
+    uint32_t c = cdgh[3], d = cdgh[2], g = cdgh[1], h = cdgh[0];
+
+    for (int i = 0; i < 2; i++) {
+        uint32_t t1 = h + sum1(e) + ((e & f) ^ (~e & g)) + wk[i];
+        uint32_t t2 = sum0(a) + ((a & b) ^ (a & c) ^ (b & c));
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    ret[0] = f;
+    ret[1] = e;
+    ret[2] = b;
+    ret[3] = a;
+}
+
+void sha256_msg1_gen(uint32_t *ret, const uint32_t *w0, const uint32_t *w4)
+{
+    uint32_t w4_0 = w4[0];
+
+    ret[0] = w0[0] + sig0(w0[1]);
+    ret[1] = w0[1] + sig0(w0[2]);
+    ret[2] = w0[2] + sig0(w0[3]);
+    ret[3] = w0[3] + sig0(w4_0);
+}
+
+void sha256_msg2_gen(uint32_t *ret, const uint32_t *x, const uint32_t *w12)
+{
+    uint32_t w14 = w12[2], w15 = w12[3];
+    uint32_t w16 = x[0] + sig1(w14);
+    uint32_t w17 = x[1] + sig1(w15);
+
+    ret[2] = x[2] + sig1(w16);
+    ret[3] = x[3] + sig1(w17);
+    ret[0] = w16;
+    ret[1] = w17;
+}
@@ -10,6 +10,7 @@
  */
 
 #include "qemu/osdep.h"
+#include "qemu/bitops.h"
 #include "crypto/sm4.h"
 
 uint8_t const sm4_sbox[] = {
@@ -57,3 +58,28 @@ uint32_t const sm4_ck[] = {
     0xa0a7aeb5, 0xbcc3cad1, 0xd8dfe6ed, 0xf4fb0209,
     0x10171e25, 0x2c333a41, 0x484f565d, 0x646b7279
 };
+
+void sm4_rnds4_gen(uint32_t *ret, const uint32_t *x, const uint32_t *rk)
+{
+    uint32_t t[8] = { x[0], x[1], x[2], x[3] };
+
+    for (int i = 0; i < 4; i++) {
+        uint32_t s = sm4_subword(t[i + 1] ^ t[i + 2] ^ t[i + 3] ^ rk[i]);
+
+        t[i + 4] = t[i] ^ s ^ rol32(s, 2) ^ rol32(s, 10) ^ rol32(s, 18) ^
+                   rol32(s, 24);
+    }
+    memcpy(ret, t + 4, sizeof(uint32_t) * 4);
+}
+
+void sm4_ekey4_gen(uint32_t *ret, const uint32_t *k, const uint32_t *ck)
+{
+    uint32_t t[8] = { k[0], k[1], k[2], k[3] };
+
+    for (int i = 0; i < 4; i++) {
+        uint32_t s = sm4_subword(t[i + 1] ^ t[i + 2] ^ t[i + 3] ^ ck[i]);
+
+        t[i + 4] = t[i] ^ s ^ rol32(s, 13) ^ rol32(s, 23);
+    }
+    memcpy(ret, t + 4, sizeof(uint32_t) * 4);
+}
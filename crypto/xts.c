@@ -99,6 +99,50 @@ static inline void xts_tweak_encdec(const void *ctx,
 }
 
 
+/* Number of blocks handed to the cipher function in a single call */
+#define XTS_BATCH_BLOCKS 8
+
+/**
+ * xts_tweak_encdec_batch:
+ * @param ctxt: the cipher context
+ * @param func: the cipher function
+ * @src: buffer providing @n blocks of input text
+ * @dst: buffer to output @n blocks of output text
+ * @n: number of blocks, at most XTS_BATCH_BLOCKS
+ * @iv: the initialization vector tweak of XTS_BLOCK_SIZE bytes
+ *
+ * Encrypt/decrypt consecutive blocks with a tweak. The tweaks are
+ * computed up front so that the cipher runs once over the whole batch,
+ * which lets implementations that interleave several blocks (such as
+ * AES-NI) keep their pipeline full. @src and @dst may alias and need
+ * not be aligned.
+ */
+static void xts_tweak_encdec_batch(const void *ctx,
+                                   xts_cipher_func *func,
+                                   const uint8_t *src,
+                                   uint8_t *dst,
+                                   unsigned long n,
+                                   xts_uint128 *iv)
+{
+    xts_uint128 T[XTS_BATCH_BLOCKS], B[XTS_BATCH_BLOCKS];
+    unsigned long i;
+
+    memcpy(B, src, n * XTS_BLOCK_SIZE);
+    for (i = 0; i < n; i++) {
+        T[i] = *iv;
+        xts_uint128_xor(&B[i], &B[i], &T[i]);
+        xts_mult_x(iv);
+    }
+
+    func(ctx, n * XTS_BLOCK_SIZE, B[0].b, B[0].b);
+
+    for (i = 0; i < n; i++) {
+        xts_uint128_xor(&B[i], &B[i], &T[i]);
+    }
+    memcpy(dst, B, n * XTS_BLOCK_SIZE);
+}
+
+
 void xts_decrypt(const void *datactx,
                  const void *tweakctx,
                  xts_cipher_func *encfunc,
@@ -109,7 +153,7 @@ void xts_decrypt(const void *datactx,
                  const uint8_t *src)
 {
     xts_uint128 PP, CC, T;
-    unsigned long i, m, mo, lim;
+    unsigned long i, n, m, mo, lim;
 
     /* get number of blocks */
     m = length >> 4;
@@ -127,23 +171,11 @@ void xts_decrypt(const void *datactx,
     /* encrypt the iv */
     encfunc(tweakctx, XTS_BLOCK_SIZE, T.b, iv);
 
-    if (QEMU_PTR_IS_ALIGNED(src, sizeof(uint64_t)) &&
-        QEMU_PTR_IS_ALIGNED(dst, sizeof(uint64_t))) {
-        xts_uint128 *S = (xts_uint128 *)src;
-        xts_uint128 *D = (xts_uint128 *)dst;
-        for (i = 0; i < lim; i++, S++, D++) {
-            xts_tweak_encdec(datactx, decfunc, S, D, &T);
-        }
-    } else {
-        xts_uint128 D;
-
-        for (i = 0; i < lim; i++) {
-            memcpy(&D, src, XTS_BLOCK_SIZE);
-            xts_tweak_encdec(datactx, decfunc, &D, &D, &T);
-            memcpy(dst, &D, XTS_BLOCK_SIZE);
-            src += XTS_BLOCK_SIZE;
-            dst += XTS_BLOCK_SIZE;
-        }
+    for (i = 0; i < lim; i += n) {
+        n = MIN(lim - i, XTS_BATCH_BLOCKS);
+        xts_tweak_encdec_batch(datactx, decfunc, src, dst, n, &T);
+        src += n * XTS_BLOCK_SIZE;
+        dst += n * XTS_BLOCK_SIZE;
     }
 
     /* if length is not a multiple of XTS_BLOCK_SIZE then */
@@ -185,7 +217,7 @@ void xts_encrypt(const void *datactx,
                  const uint8_t *src)
 {
     xts_uint128 PP, CC, T;
-    unsigned long i, m, mo, lim;
+    unsigned long i, n, m, mo, lim;
 
     /* get number of blocks */
     m = length >> 4;
@@ -203,24 +235,11 @@ void xts_encrypt(const void *datactx,
     /* encrypt the iv */
     encfunc(tweakctx, XTS_BLOCK_SIZE, T.b, iv);
 
-    if (QEMU_PTR_IS_ALIGNED(src, sizeof(uint64_t)) &&
-        QEMU_PTR_IS_ALIGNED(dst, sizeof(uint64_t))) {
-        xts_uint128 *S = (xts_uint128 *)src;
-        xts_uint128 *D = (xts_uint128 *)dst;
-        for (i = 0; i < lim; i++, S++, D++) {
-            xts_tweak_encdec(datactx, encfunc, S, D, &T);
-        }
-    } else {
-        xts_uint128 D;
-
-        for (i = 0; i < lim; i++) {
-            memcpy(&D, src, XTS_BLOCK_SIZE);
-            xts_tweak_encdec(datactx, encfunc, &D, &D, &T);
-            memcpy(dst, &D, XTS_BLOCK_SIZE);
-
-            dst += XTS_BLOCK_SIZE;
-            src += XTS_BLOCK_SIZE;
-        }
+    for (i = 0; i < lim; i += n) {
+        n = MIN(lim - i, XTS_BATCH_BLOCKS);
+        xts_tweak_encdec_batch(datactx, encfunc, src, dst, n, &T);
+        src += n * XTS_BLOCK_SIZE;
+        dst += n * XTS_BLOCK_SIZE;
     }
 
     /* if length is not a multiple of XTS_BLOCK_SIZE then */
@@ -31,6 +31,7 @@
 #include "hw/core/cpu.h"
 #include "win_dump.h"
 #include "qemu/range.h"
+#include "block/thread-pool.h"
 
 #include <zlib.h>
 #ifdef CONFIG_LZO
@@ -39,6 +40,9 @@
 #ifdef CONFIG_SNAPPY
 #include <snappy-c.h>
 #endif
+#ifdef CONFIG_ZSTD
+#include <zstd.h>
+#endif
 #ifndef ELF_MACHINE_UNAME
 #define ELF_MACHINE_UNAME "Unknown"
 #endif
@@ -1003,6 +1007,11 @@ static void create_header32(DumpState *s, Error **errp)
     if (s->flag_compress & DUMP_DH_COMPRESSED_SNAPPY) {
         status |= DUMP_DH_COMPRESSED_SNAPPY;
     }
+#endif
+#ifdef CONFIG_ZSTD
+    if (s->flag_compress & DUMP_DH_COMPRESSED_ZSTD) {
+        status |= DUMP_DH_COMPRESSED_ZSTD;
+    }
 #endif
     dh->status = cpu_to_dump32(s, status);
 
@@ -1114,6 +1123,11 @@ static void create_header64(DumpState *s, Error **errp)
     if (s->flag_compress & DUMP_DH_COMPRESSED_SNAPPY) {
         status |= DUMP_DH_COMPRESSED_SNAPPY;
     }
+#endif
+#ifdef CONFIG_ZSTD
+    if (s->flag_compress & DUMP_DH_COMPRESSED_ZSTD) {
+        status |= DUMP_DH_COMPRESSED_ZSTD;
+    }
 #endif
     dh->status = cpu_to_dump32(s, status);
 
@@ -1466,6 +1480,157 @@ static size_t get_len_buf_out(size_t page_size, uint32_t flag_compress)
     case DUMP_DH_COMPRESSED_SNAPPY:
         return snappy_max_compressed_length(page_size);
 #endif
+
+#ifdef CONFIG_ZSTD
+    case DUMP_DH_COMPRESSED_ZSTD:
+        return ZSTD_compressBound(page_size);
+#endif
+    }
+    return 0;
+}
+
+/*
+ * Pages are compressed by a pool of worker threads, one batch of pages per
+ * task.  While a round of batches is being compressed, the dump thread
+ * writes out the previous round in guest page order.
+ */
+#define DUMP_COMPRESS_BATCH     64
+#define DUMP_COMPRESS_WORKERS   8
+
+/* flags of a zero page, all of them share the first page of page_data */
+#define DUMP_PAGE_ZERO          UINT32_MAX
+
+typedef struct DumpCompressBatch {
+    DumpState *s;
+    size_t len_buf_out;
+    unsigned npages;
+    uint8_t *page[DUMP_COMPRESS_BATCH];
+    uint32_t flags[DUMP_COMPRESS_BATCH];
+    size_t size[DUMP_COMPRESS_BATCH];
+    uint8_t *copy;      /* room for the pages that straddle guest blocks */
+    uint8_t *out;       /* len_buf_out bytes for each page */
+#ifdef CONFIG_LZO
+    lzo_bytep wrkmem;
+#endif
+#ifdef CONFIG_ZSTD
+    ZSTD_CCtx *zstd;
+#endif
+} DumpCompressBatch;
+
+/*
+ * Compress a page into @out.  Only one compression format is used, as set
+ * in s->flag_compress.  Returns the DUMP_DH_COMPRESSED_* flag of the page,
+ * or 0 if it did not compress and has to be saved in plaintext.
+ */
+static uint32_t dump_compress_page(DumpCompressBatch *b, const uint8_t *buf,
+                                   uint8_t *out, size_t *size_out)
+{
+    DumpState *s = b->s;
+    size_t page_size = s->dump_info.page_size;
+
+    if (s->flag_compress & DUMP_DH_COMPRESSED_ZLIB) {
+        uLongf len = b->len_buf_out;
+
+        if (compress2(out, &len, buf, page_size, Z_BEST_SPEED) == Z_OK &&
+            len < page_size) {
+            *size_out = len;
+            return DUMP_DH_COMPRESSED_ZLIB;
+        }
+    }
+#ifdef CONFIG_LZO
+    if (s->flag_compress & DUMP_DH_COMPRESSED_LZO) {
+        lzo_uint len = b->len_buf_out;
+
+        if (lzo1x_1_compress(buf, page_size, out, &len,
+                             b->wrkmem) == LZO_E_OK &&
+            len < page_size) {
+            *size_out = len;
+            return DUMP_DH_COMPRESSED_LZO;
+        }
+    }
+#endif
+#ifdef CONFIG_SNAPPY
+    if (s->flag_compress & DUMP_DH_COMPRESSED_SNAPPY) {
+        size_t len = b->len_buf_out;
+
+        if (snappy_compress((const char *)buf, page_size, (char *)out,
+                            &len) == SNAPPY_OK &&
+            len < page_size) {
+            *size_out = len;
+            return DUMP_DH_COMPRESSED_SNAPPY;
+        }
+    }
+#endif
+#ifdef CONFIG_ZSTD
+    if (s->flag_compress & DUMP_DH_COMPRESSED_ZSTD) {
+        size_t len = ZSTD_compressCCtx(b->zstd, out, b->len_buf_out,
+                                       buf, page_size, 1);
+
+        if (!ZSTD_isError(len) && len < page_size) {
+            *size_out = len;
+            return DUMP_DH_COMPRESSED_ZSTD;
+        }
+    }
+#endif
+
+    *size_out = page_size;
+    return 0;
+}
+
+static int dump_compress_batch(void *opaque)
+{
+    DumpCompressBatch *b = opaque;
+    size_t page_size = b->s->dump_info.page_size;
+    unsigned i;
+
+    for (i = 0; i < b->npages; i++) {
+        if (buffer_is_zero(b->page[i], page_size)) {
+            b->flags[i] = DUMP_PAGE_ZERO;
+        } else {
+            b->flags[i] = dump_compress_page(b, b->page[i],
+                                             b->out + i * b->len_buf_out,
+                                             &b->size[i]);
+        }
+    }
+    return 0;
+}
+
+static int dump_write_batch(DumpCompressBatch *b, DataCache *page_desc,
+                            DataCache *page_data, PageDescriptor *pd_zero,
+                            off_t *offset_data, Error **errp)
+{
+    DumpState *s = b->s;
+    PageDescriptor pd;
+    uint8_t *data;
+    unsigned i;
+
+    for (i = 0; i < b->npages; i++) {
+        if (b->flags[i] == DUMP_PAGE_ZERO) {
+            if (write_cache(page_desc, pd_zero, sizeof(PageDescriptor),
+                            false) < 0) {
+                error_setg(errp, "dump: failed to write page desc");
+                return -1;
+            }
+        } else {
+            data = b->flags[i] ? b->out + i * b->len_buf_out : b->page[i];
+            if (write_cache(page_data, data, b->size[i], false) < 0) {
+                error_setg(errp, "dump: failed to write page data");
+                return -1;
+            }
+
+            pd.flags = cpu_to_dump32(s, b->flags[i]);
+            pd.size = cpu_to_dump32(s, b->size[i]);
+            pd.page_flags = cpu_to_dump64(s, 0);
+            pd.offset = cpu_to_dump64(s, *offset_data);
+            *offset_data += b->size[i];
+
+            if (write_cache(page_desc, &pd, sizeof(PageDescriptor),
+                            false) < 0) {
+                error_setg(errp, "dump: failed to write page desc");
+                return -1;
+            }
+        }
+        s->written_size += s->dump_info.page_size;
     }
     return 0;
 }
@@ -1474,17 +1639,16 @@ static void write_dump_pages(DumpState *s, Error **errp)
 {
     int ret = 0;
     DataCache page_desc, page_data;
-    size_t len_buf_out, size_out;
-#ifdef CONFIG_LZO
-    lzo_bytep wrkmem = NULL;
-#endif
-    uint8_t *buf_out = NULL;
+    size_t len_buf_out;
     off_t offset_desc, offset_data;
-    PageDescriptor pd, pd_zero;
+    PageDescriptor pd_zero;
     uint8_t *buf;
     GuestPhysBlock *block_iter = NULL;
     uint64_t pfn_iter;
-    g_autofree uint8_t *page = NULL;
+    ThreadPool *pool;
+    DumpCompressBatch *batches, *cur, *b;
+    int nworkers, ncur, nprev = 0, round = 0, i;
+    bool more = true;
 
     /* get offset of page_desc and page_data in dump file */
     offset_desc = s->offset_page;
@@ -1497,11 +1661,26 @@ static void write_dump_pages(DumpState *s, Error **errp)
     len_buf_out = get_len_buf_out(s->dump_info.page_size, s->flag_compress);
     assert(len_buf_out != 0);
 
+    /* two rounds of batches, one being compressed and one being written */
+    nworkers = MIN(g_get_num_processors(), DUMP_COMPRESS_WORKERS);
+    batches = g_new0(DumpCompressBatch, 2 * nworkers);
+    for (i = 0; i < 2 * nworkers; i++) {
+        b = &batches[i];
+        b->s = s;
+        b->len_buf_out = len_buf_out;
+        b->copy = g_malloc(s->dump_info.page_size * DUMP_COMPRESS_BATCH);
+        b->out = g_malloc(len_buf_out * DUMP_COMPRESS_BATCH);
 #ifdef CONFIG_LZO
-    wrkmem = g_malloc(LZO1X_1_MEM_COMPRESS);
+        b->wrkmem = g_malloc(LZO1X_1_MEM_COMPRESS);
 #endif
-
-    buf_out = g_malloc(len_buf_out);
+#ifdef CONFIG_ZSTD
+        if (s->flag_compress & DUMP_DH_COMPRESSED_ZSTD) {
+            b->zstd = ZSTD_createCCtx();
+        }
+#endif
+    }
+    pool = thread_pool_new();
+    thread_pool_set_max_threads(pool, nworkers);
 
     /*
      * init zero page's page_desc and page_data, because every zero page
@@ -1520,103 +1699,42 @@ static void write_dump_pages(DumpState *s, Error **errp)
     }
 
     offset_data += s->dump_info.page_size;
-    page = g_malloc(s->dump_info.page_size);
 
     /*
      * dump memory to vmcore page by page. zero page will all be resided in the
      * first page of page section
      */
-    for (buf = page; get_next_page(&block_iter, &pfn_iter, &buf, s); buf = page) {
-        /* check zero page */
-        if (buffer_is_zero(buf, s->dump_info.page_size)) {
-            ret = write_cache(&page_desc, &pd_zero, sizeof(PageDescriptor),
-                              false);
-            if (ret < 0) {
-                error_setg(errp, "dump: failed to write page desc");
-                goto out;
-            }
-        } else {
-            /*
-             * not zero page, then:
-             * 1. compress the page
-             * 2. write the compressed page into the cache of page_data
-             * 3. get page desc of the compressed page and write it into the
-             *    cache of page_desc
-             *
-             * only one compression format will be used here, for
-             * s->flag_compress is set. But when compression fails to work,
-             * we fall back to save in plaintext.
-             */
-             size_out = len_buf_out;
-             if ((s->flag_compress & DUMP_DH_COMPRESSED_ZLIB) &&
-                    (compress2(buf_out, (uLongf *)&size_out, buf,
-                               s->dump_info.page_size, Z_BEST_SPEED) == Z_OK) &&
-                    (size_out < s->dump_info.page_size)) {
-                pd.flags = cpu_to_dump32(s, DUMP_DH_COMPRESSED_ZLIB);
-                pd.size  = cpu_to_dump32(s, size_out);
-
-                ret = write_cache(&page_data, buf_out, size_out, false);
-                if (ret < 0) {
-                    error_setg(errp, "dump: failed to write page data");
-                    goto out;
-                }
-#ifdef CONFIG_LZO
-            } else if ((s->flag_compress & DUMP_DH_COMPRESSED_LZO) &&
-                    (lzo1x_1_compress(buf, s->dump_info.page_size, buf_out,
-                    (lzo_uint *)&size_out, wrkmem) == LZO_E_OK) &&
-                    (size_out < s->dump_info.page_size)) {
-                pd.flags = cpu_to_dump32(s, DUMP_DH_COMPRESSED_LZO);
-                pd.size  = cpu_to_dump32(s, size_out);
-
-                ret = write_cache(&page_data, buf_out, size_out, false);
-                if (ret < 0) {
-                    error_setg(errp, "dump: failed to write page data");
-                    goto out;
-                }
-#endif
-#ifdef CONFIG_SNAPPY
-            } else if ((s->flag_compress & DUMP_DH_COMPRESSED_SNAPPY) &&
-                    (snappy_compress((char *)buf, s->dump_info.page_size,
-                    (char *)buf_out, &size_out) == SNAPPY_OK) &&
-                    (size_out < s->dump_info.page_size)) {
-                pd.flags = cpu_to_dump32(s, DUMP_DH_COMPRESSED_SNAPPY);
-                pd.size  = cpu_to_dump32(s, size_out);
-
-                ret = write_cache(&page_data, buf_out, size_out, false);
-                if (ret < 0) {
-                    error_setg(errp, "dump: failed to write page data");
-                    goto out;
-                }
-#endif
-            } else {
-                /*
-                 * fall back to save in plaintext, size_out should be
-                 * assigned the target's page size
-                 */
-                pd.flags = cpu_to_dump32(s, 0);
-                size_out = s->dump_info.page_size;
-                pd.size = cpu_to_dump32(s, size_out);
-
-                ret = write_cache(&page_data, buf,
-                                  s->dump_info.page_size, false);
-                if (ret < 0) {
-                    error_setg(errp, "dump: failed to write page data");
-                    goto out;
+    while (more || nprev) {
+        cur = &batches[(round++ & 1) * nworkers];
+
+        for (ncur = 0; more && ncur < nworkers; ncur++) {
+            b = &cur[ncur];
+            for (b->npages = 0; b->npages < DUMP_COMPRESS_BATCH;
+                 b->npages++) {
+                buf = b->copy + b->npages * s->dump_info.page_size;
+                if (!get_next_page(&block_iter, &pfn_iter, &buf, s)) {
+                    more = false;
+                    break;
                 }
+                b->page[b->npages] = buf;
             }
-
-            /* get and write page desc here */
-            pd.page_flags = cpu_to_dump64(s, 0);
-            pd.offset = cpu_to_dump64(s, offset_data);
-            offset_data += size_out;
-
-            ret = write_cache(&page_desc, &pd, sizeof(PageDescriptor), false);
-            if (ret < 0) {
-                error_setg(errp, "dump: failed to write page desc");
-                goto out;
+            if (!b->npages) {
+                break;
             }
+            thread_pool_submit(pool, dump_compress_batch, b, NULL);
         }
-        s->written_size += s->dump_info.page_size;
+
+        /* the previous round is written while this one is compressed */
+        b = &batches[(round & 1) * nworkers];
+        for (i = 0; i < nprev && ret == 0; i++) {
+            ret = dump_write_batch(&b[i], &page_desc, &page_data, &pd_zero,
+                                   &offset_data, errp);
+        }
+        thread_pool_wait(pool);
+        if (ret < 0) {
+            goto out;
+        }
+        nprev = ncur;
     }
 
     ret = write_cache(&page_desc, NULL, 0, true);
@@ -1631,14 +1749,22 @@ static void write_dump_pages(DumpState *s, Error **errp)
     }
 
 out:
+    thread_pool_free(pool);
     free_data_cache(&page_desc);
     free_data_cache(&page_data);
 
+    for (i = 0; i < 2 * nworkers; i++) {
+        b = &batches[i];
+        g_free(b->copy);
+        g_free(b->out);
 #ifdef CONFIG_LZO
-    g_free(wrkmem);
+        g_free(b->wrkmem);
 #endif
-
-    g_free(buf_out);
+#ifdef CONFIG_ZSTD
+        ZSTD_freeCCtx(b->zstd);
+#endif
+    }
+    g_free(batches);
 }
 
 static void create_kdump_vmcore(DumpState *s, Error **errp)
@@ -1946,6 +2072,10 @@ static void dump_init(DumpState *s, int fd, bool has_format,
             s->flag_compress = DUMP_DH_COMPRESSED_SNAPPY;
             break;
 
+        case DUMP_GUEST_MEMORY_FORMAT_KDUMP_ZSTD:
+            s->flag_compress = DUMP_DH_COMPRESSED_ZSTD;
+            break;
+
         default:
             s->flag_compress = 0;
         }
@@ -2105,6 +2235,10 @@ void qmp_dump_guest_memory(bool paging, const char *protocol,
             format = DUMP_GUEST_MEMORY_FORMAT_KDUMP_SNAPPY;
             kdump_raw = true;
             break;
+        case DUMP_GUEST_MEMORY_FORMAT_KDUMP_RAW_ZSTD:
+            format = DUMP_GUEST_MEMORY_FORMAT_KDUMP_ZSTD;
+            kdump_raw = true;
+            break;
         default:
             break;
         }
@@ -2132,7 +2266,7 @@ void qmp_dump_guest_memory(bool paging, const char *protocol,
         detach_p = detach;
     }
 
-    /* check whether lzo/snappy is supported */
+    /* check whether lzo/snappy/zstd is supported */
 #ifndef CONFIG_LZO
     if (has_format && format == DUMP_GUEST_MEMORY_FORMAT_KDUMP_LZO) {
         error_setg(errp, "kdump-lzo is not available now");
@@ -2147,6 +2281,13 @@ void qmp_dump_guest_memory(bool paging, const char *protocol,
     }
 #endif
 
+#ifndef CONFIG_ZSTD
+    if (has_format && format == DUMP_GUEST_MEMORY_FORMAT_KDUMP_ZSTD) {
+        error_setg(errp, "kdump-zstd is not available now");
+        return;
+    }
+#endif
+
     if (has_format && format == DUMP_GUEST_MEMORY_FORMAT_WIN_DMP
         && !win_dump_available(errp)) {
         return;
@@ -2234,6 +2375,12 @@ DumpGuestMemoryCapability *qmp_query_dump_guest_memory_capability(Error **errp)
     QAPI_LIST_APPEND(tail, DUMP_GUEST_MEMORY_FORMAT_KDUMP_RAW_SNAPPY);
 #endif
 
+    /* add new item if kdump-zstd is available */
+#ifdef CONFIG_ZSTD
+    QAPI_LIST_APPEND(tail, DUMP_GUEST_MEMORY_FORMAT_KDUMP_ZSTD);
+    QAPI_LIST_APPEND(tail, DUMP_GUEST_MEMORY_FORMAT_KDUMP_RAW_ZSTD);
+#endif
+
     if (win_dump_available(NULL)) {
         QAPI_LIST_APPEND(tail, DUMP_GUEST_MEMORY_FORMAT_WIN_DMP);
     }
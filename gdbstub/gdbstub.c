@@ -56,6 +56,22 @@ typedef struct GDBRegisterState {
     const GDBFeature *feature;
 } GDBRegisterState;
 
+/* Cached register values of one CPU, see gdb_read_register_cached() */
+typedef struct GDBRegCache {
+    /* cpu->gdb_state_gen when the values were read */
+    uint32_t state_gen;
+    /* GByteArray of each register read so far, by register number */
+    GPtrArray *regs;
+} GDBRegCache;
+
+static void gdb_reg_cache_free(gpointer data)
+{
+    GDBRegCache *cache = data;
+
+    g_ptr_array_unref(cache->regs);
+    g_free(cache);
+}
+
 GDBState gdbserver_state;
 
 void gdb_init_gdbserver_state(void)
@@ -66,6 +82,8 @@ void gdb_init_gdbserver_state(void)
     gdbserver_state.str_buf = g_string_new(NULL);
     gdbserver_state.mem_buf = g_byte_array_sized_new(MAX_PACKET_LENGTH);
     gdbserver_state.last_packet = g_byte_array_sized_new(MAX_PACKET_LENGTH + 4);
+    gdbserver_state.reg_cache =
+        g_hash_table_new_full(NULL, NULL, NULL, gdb_reg_cache_free);
 
     /*
      * What single-step modes are supported is accelerator dependent.
@@ -535,10 +553,67 @@ int gdb_read_register(CPUState *cpu, GByteArray *buf, int reg)
     return 0;
 }
 
+void gdb_reg_cache_invalidate(void)
+{
+    if (gdbserver_state.reg_cache) {
+        g_hash_table_remove_all(gdbserver_state.reg_cache);
+    }
+}
+
+/*
+ * Front-ends re-read the same registers many times while the target is
+ * stopped, e.g. once per frame when unwinding. Serve those reads from
+ * a cache that lives until the target resumes or a register is written.
+ * A system_reset or loadvm while stopped does not resume the target,
+ * so the values are also dropped when cpu->gdb_state_gen moves on.
+ */
+static int gdb_read_register_cached(CPUState *cpu, GByteArray *buf, int reg)
+{
+    GDBRegCache *cache = g_hash_table_lookup(gdbserver_state.reg_cache, cpu);
+    GPtrArray *regs;
+    GByteArray *val;
+    int len;
+
+    if (cache && cache->state_gen != cpu->gdb_state_gen) {
+        g_hash_table_remove(gdbserver_state.reg_cache, cpu);
+        cache = NULL;
+    }
+    regs = cache ? cache->regs : NULL;
+
+    if (regs && reg < regs->len) {
+        val = g_ptr_array_index(regs, reg);
+        if (val) {
+            g_byte_array_append(buf, val->data, val->len);
+            return val->len;
+        }
+    }
+
+    len = gdb_read_register(cpu, buf, reg);
+    if (len && reg >= 0) {
+        if (!regs) {
+            cache = g_new(GDBRegCache, 1);
+            cache->state_gen = cpu->gdb_state_gen;
+            cache->regs = regs = g_ptr_array_new_with_free_func(
+                (GDestroyNotify)g_byte_array_unref);
+            g_hash_table_insert(gdbserver_state.reg_cache, cpu, cache);
+        }
+        if (regs->len <= reg) {
+            g_ptr_array_set_size(regs, reg + 1);
+        }
+        val = g_byte_array_sized_new(len);
+        g_byte_array_append(val, buf->data + buf->len - len, len);
+        regs->pdata[reg] = val;
+    }
+    return len;
+}
+
 int gdb_write_register(CPUState *cpu, uint8_t *mem_buf, int reg)
 {
     GDBRegisterState *r;
 
+    /* writing one register may change the value of others */
+    gdb_reg_cache_invalidate();
+
     if (reg < cpu->cc->gdb_num_core_regs) {
         return cpu->cc->gdb_write_register(cpu, mem_buf, reg);
     }
@@ -1236,9 +1311,9 @@ static void handle_get_reg(GArray *params, void *user_ctx)
         return;
     }
 
-    reg_size = gdb_read_register(gdbserver_state.g_cpu,
-                                 gdbserver_state.mem_buf,
-                                 gdb_get_cmd_param(params, 0)->val_ull);
+    reg_size = gdb_read_register_cached(gdbserver_state.g_cpu,
+                                        gdbserver_state.mem_buf,
+                                        gdb_get_cmd_param(params, 0)->val_ull);
     if (!reg_size) {
         gdb_put_packet("E14");
         return;
@@ -1307,6 +1382,92 @@ static void handle_read_mem(GArray *params, void *user_ctx)
     gdb_put_strbuf();
 }
 
+/*
+ * handle_write/read_mem_binary
+ *
+ * The 'X' and 'x' packets carry memory contents as escaped binary data
+ * rather than hex, which halves the size of large transfers.
+ */
+
+static void handle_write_mem_binary(GArray *params, void *user_ctx)
+{
+    const char *data, *end;
+    uint64_t len;
+
+    if (params->len < 2) {
+        gdb_put_packet("E22");
+        return;
+    }
+
+    /* gdb probes for 'X' support with an empty write */
+    len = gdb_get_cmd_param(params, 1)->val_ull;
+    if (!len) {
+        gdb_put_packet("OK");
+        return;
+    }
+
+    /*
+     * The data may start with or contain NUL bytes, so locate it in the
+     * received packet rather than relying on the parsed parameter.
+     */
+    end = gdbserver_state.line_buf + gdbserver_state.line_buf_index;
+    data = memchr(gdbserver_state.line_buf, ':',
+                  gdbserver_state.line_buf_index);
+    if (!data || len > end - (data + 1)) {
+        gdb_put_packet("E22");
+        return;
+    }
+    data++;
+
+    if (gdb_target_memory_rw_debug(gdbserver_state.g_cpu,
+                                   gdb_get_cmd_param(params, 0)->val_ull,
+                                   (uint8_t *)data, len, true)) {
+        gdb_put_packet("E14");
+        return;
+    }
+
+    gdb_put_packet("OK");
+}
+
+static void handle_read_mem_binary(GArray *params, void *user_ctx)
+{
+    uint64_t len;
+    const char *mem;
+
+    if (params->len != 2) {
+        gdb_put_packet("E22");
+        return;
+    }
+
+    /*
+     * Escaping may double the size of any byte, the reply is trimmed
+     * below to what fits in a packet. gdb handles short reads.
+     */
+    len = MIN(gdb_get_cmd_param(params, 1)->val_ull, MAX_PACKET_LENGTH - 5);
+    g_byte_array_set_size(gdbserver_state.mem_buf, len);
+
+    if (gdb_target_memory_rw_debug(gdbserver_state.g_cpu,
+                                   gdb_get_cmd_param(params, 0)->val_ull,
+                                   gdbserver_state.mem_buf->data,
+                                   gdbserver_state.mem_buf->len, false)) {
+        gdb_put_packet("E14");
+        return;
+    }
+
+    g_string_assign(gdbserver_state.str_buf, "b");
+    mem = (const char *)gdbserver_state.mem_buf->data;
+    for (uint64_t i = 0; i < len; i++) {
+        /* leave room for an escaped byte and the packet framing */
+        if (gdbserver_state.str_buf->len + 2 > MAX_PACKET_LENGTH - 4) {
+            break;
+        }
+        gdb_memtox(gdbserver_state.str_buf, mem + i, 1);
+    }
+
+    gdb_put_packet_binary(gdbserver_state.str_buf->str,
+                          gdbserver_state.str_buf->len, true);
+}
+
 static void handle_write_all_regs(GArray *params, void *user_ctx)
 {
     int reg_id;
@@ -1341,9 +1502,9 @@ static void handle_read_all_regs(GArray *params, void *user_ctx)
     g_byte_array_set_size(gdbserver_state.mem_buf, 0);
     len = 0;
     for (reg_id = 0; reg_id < gdbserver_state.g_cpu->gdb_num_g_regs; reg_id++) {
-        len += gdb_read_register(gdbserver_state.g_cpu,
-                                 gdbserver_state.mem_buf,
-                                 reg_id);
+        len += gdb_read_register_cached(gdbserver_state.g_cpu,
+                                        gdbserver_state.mem_buf,
+                                        reg_id);
         g_assert(len == gdbserver_state.mem_buf->len);
     }
 
@@ -1672,6 +1833,7 @@ void gdb_extend_qsupported_features(char *qflags)
 static void handle_query_supported(GArray *params, void *user_ctx)
 {
     g_string_printf(gdbserver_state.str_buf, "PacketSize=%x", MAX_PACKET_LENGTH);
+    g_string_append(gdbserver_state.str_buf, ";binary-upload+");
     if (gdb_get_core_xml_file(first_cpu)) {
         g_string_append(gdbserver_state.str_buf, ";qXfer:features:read+");
     }
@@ -2195,6 +2357,28 @@ static int gdb_handle_packet(const char *line_buf)
             cmd_parser = &read_mem_cmd_desc;
         }
         break;
+    case 'x':
+        {
+            static const GdbCmdParseEntry read_mem_binary_cmd_desc = {
+                .handler = handle_read_mem_binary,
+                .cmd = "x",
+                .cmd_startswith = true,
+                .schema = "L,L0"
+            };
+            cmd_parser = &read_mem_binary_cmd_desc;
+        }
+        break;
+    case 'X':
+        {
+            static const GdbCmdParseEntry write_mem_binary_cmd_desc = {
+                .handler = handle_write_mem_binary,
+                .cmd = "X",
+                .cmd_startswith = true,
+                .schema = "L,L:s0"
+            };
+            cmd_parser = &write_mem_binary_cmd_desc;
+        }
+        break;
     case 'M':
         {
             static const GdbCmdParseEntry write_mem_cmd_desc = {
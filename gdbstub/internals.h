@@ -11,7 +11,7 @@
 
 #include "exec/cpu-common.h"
 
-#define MAX_PACKET_LENGTH 4096
+#define MAX_PACKET_LENGTH 16384
 
 /*
  * Shared structures and definitions
@@ -63,6 +63,11 @@ typedef struct GDBState {
     int process_num;
     GString *str_buf;
     GByteArray *mem_buf;
+    /*
+     * Register values read since the target stopped, a GDBRegCache for
+     * each CPUState.
+     */
+    GHashTable *reg_cache;
     int sstep_flags;
     int supported_sstep_flags;
     /*
@@ -144,6 +149,12 @@ int gdb_target_signal_to_gdb(int sig);
 
 int gdb_get_char(void); /* user only */
 
+/**
+ * gdb_reg_cache_invalidate() - drop the register values cached since
+ * the last stop. Must be called whenever the CPU state may change.
+ */
+void gdb_reg_cache_invalidate(void);
+
 /**
  * gdb_continue() - handle continue in mode specific way.
  */
@@ -129,6 +129,8 @@ static void gdb_vm_state_change(void *opaque, bool running, RunState state)
     const char *type;
     int ret;
 
+    gdb_reg_cache_invalidate();
+
     if (running || gdbserver_state.state == RS_INACTIVE) {
         return;
     }
@@ -537,6 +539,8 @@ void gdb_handle_query_rcmd(GArray *params, void *ctx)
     qemu_chr_be_write(gdbserver_system_state.mon_chr,
                       gdbserver_state.mem_buf->data,
                       gdbserver_state.mem_buf->len);
+    /* monitor commands such as system_reset change the CPU state */
+    gdb_reg_cache_invalidate();
     gdb_put_packet("OK");
 }
 
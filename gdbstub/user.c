@@ -711,6 +711,7 @@ void gdb_handle_query_attached(GArray *params, void *user_ctx)
 
 void gdb_continue(void)
 {
+    gdb_reg_cache_invalidate();
     gdbserver_user_state.running_state = 1;
     trace_gdbstub_op_continue();
 }
@@ -723,6 +724,8 @@ int gdb_continue_partial(char *newstates)
 {
     CPUState *cpu;
     int res = 0;
+
+    gdb_reg_cache_invalidate();
     /*
      * This is not exactly accurate, but it's an improvement compared to the
      * previous situation, where only one CPU would be single-stepped.
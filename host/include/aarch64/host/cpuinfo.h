@@ -12,6 +12,7 @@
 #define CPUINFO_AES             (1u << 3)
 #define CPUINFO_PMULL           (1u << 4)
 #define CPUINFO_BTI             (1u << 5)
+#define CPUINFO_SM4             (1u << 6)
 
 /* Initialized with a constructor. */
 extern unsigned cpuinfo;
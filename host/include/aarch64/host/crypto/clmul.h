@@ -38,4 +38,12 @@ clmul_64_accel(uint64_t n, uint64_t m)
     return u.s;
 }
 
+/* PMULL has no wider form than the 64x64->128 multiply above. */
+#define HAVE_CLMUL_X4_ACCEL  false
+#define ATTR_CLMUL_X4_ACCEL
+
+void clmul_64x4_accel(uint64_t *, uint64_t *, const uint64_t *,
+                      const uint64_t *, size_t)
+    QEMU_ERROR("unsupported accel");
+
 #endif /* AARCH64_HOST_CRYPTO_CLMUL_H */
@@ -0,0 +1,46 @@
+/*
+ * AArch64 specific sm4 acceleration.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef AARCH64_HOST_CRYPTO_SM4_ROUND_H
+#define AARCH64_HOST_CRYPTO_SM4_ROUND_H
+
+#include "host/cpuinfo.h"
+#include <arm_neon.h>
+
+#ifdef __ARM_FEATURE_SM4
+# define HAVE_SM4_ACCEL  true
+#else
+# define HAVE_SM4_ACCEL  likely(cpuinfo & CPUINFO_SM4)
+#endif
+#define ATTR_SM4_ACCEL
+
+/*
+ * SM4E and SM4EKEY perform four rounds on the four words of the vector,
+ * element 0 being the oldest, exactly as the generic interface.
+ */
+
+static inline void ATTR_SM4_ACCEL
+sm4_rnds4_accel(uint32_t *ret, const uint32_t *x, const uint32_t *rk)
+{
+    uint32x4_t d = vld1q_u32(x);
+    uint32x4_t k = vld1q_u32(rk);
+
+    asm(".arch_extension sm4\n\t"
+        "sm4e %0.4s, %1.4s" : "+w"(d) : "w"(k));
+    vst1q_u32(ret, d);
+}
+
+static inline void ATTR_SM4_ACCEL
+sm4_ekey4_accel(uint32_t *ret, const uint32_t *k, const uint32_t *ck)
+{
+    uint32x4_t d = vld1q_u32(k);
+    uint32x4_t c = vld1q_u32(ck);
+
+    asm(".arch_extension sm4\n\t"
+        "sm4ekey %0.4s, %1.4s, %2.4s" : "=w"(d) : "w"(d), "w"(c));
+    vst1q_u32(ret, d);
+}
+
+#endif /* AARCH64_HOST_CRYPTO_SM4_ROUND_H */
@@ -12,4 +12,11 @@
 Int128 clmul_64_accel(uint64_t, uint64_t)
     QEMU_ERROR("unsupported accel");
 
+#define HAVE_CLMUL_X4_ACCEL  false
+#define ATTR_CLMUL_X4_ACCEL
+
+void clmul_64x4_accel(uint64_t *, uint64_t *, const uint64_t *,
+                      const uint64_t *, size_t)
+    QEMU_ERROR("unsupported accel");
+
 #endif /* GENERIC_HOST_CRYPTO_CLMUL_H */
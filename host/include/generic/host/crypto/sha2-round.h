@@ -0,0 +1,20 @@
+/*
+ * No host specific sha2 acceleration.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef GENERIC_HOST_CRYPTO_SHA2_ROUND_H
+#define GENERIC_HOST_CRYPTO_SHA2_ROUND_H
+
+#define HAVE_SHA256_ACCEL  false
+#define ATTR_SHA256_ACCEL
+
+void sha256_rnds2_accel(uint32_t *, const uint32_t *, const uint32_t *,
+                        const uint32_t *)
+    QEMU_ERROR("unsupported accel");
+void sha256_msg1_accel(uint32_t *, const uint32_t *, const uint32_t *)
+    QEMU_ERROR("unsupported accel");
+void sha256_msg2_accel(uint32_t *, const uint32_t *, const uint32_t *)
+    QEMU_ERROR("unsupported accel");
+
+#endif /* GENERIC_HOST_CRYPTO_SHA2_ROUND_H */
@@ -0,0 +1,17 @@
+/*
+ * No host specific sm4 acceleration.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef GENERIC_HOST_CRYPTO_SM4_ROUND_H
+#define GENERIC_HOST_CRYPTO_SM4_ROUND_H
+
+#define HAVE_SM4_ACCEL  false
+#define ATTR_SM4_ACCEL
+
+void sm4_rnds4_accel(uint32_t *, const uint32_t *, const uint32_t *)
+    QEMU_ERROR("unsupported accel");
+void sm4_ekey4_accel(uint32_t *, const uint32_t *, const uint32_t *)
+    QEMU_ERROR("unsupported accel");
+
+#endif /* GENERIC_HOST_CRYPTO_SM4_ROUND_H */
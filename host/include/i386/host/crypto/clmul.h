@@ -26,4 +26,36 @@ clmul_64_accel(uint64_t n, uint64_t m)
     return u.s;
 }
 
+#if defined(__VPCLMULQDQ__) && defined(__AVX2__)
+# define HAVE_CLMUL_X4_ACCEL  true
+# define ATTR_CLMUL_X4_ACCEL
+#else
+# define HAVE_CLMUL_X4_ACCEL  likely(cpuinfo & CPUINFO_VPCLMUL)
+# define ATTR_CLMUL_X4_ACCEL  __attribute__((target("vpclmulqdq,avx2")))
+#endif
+
+/*
+ * Four 64x64->128 multiplies of @a[i] by @b[i], or by @b[0] if
+ * @b_stride is 0. VPCLMULQDQ multiplies one qword of each 128-bit
+ * lane, so the even and odd elements are done separately and the
+ * halves of the products interleaved back afterwards.
+ */
+static inline void ATTR_CLMUL_X4_ACCEL
+clmul_64x4_accel(uint64_t *lo, uint64_t *hi, const uint64_t *a,
+                 const uint64_t *b, size_t b_stride)
+{
+    __m256i va = _mm256_loadu_si256((const __m256i *)a);
+    __m256i vb = b_stride ? _mm256_loadu_si256((const __m256i *)b)
+                          : _mm256_set1_epi64x(b[0]);
+    __m256i even = _mm256_clmulepi64_epi128(va, vb, 0x00);
+    __m256i odd = _mm256_clmulepi64_epi128(va, vb, 0x11);
+
+    if (lo) {
+        _mm256_storeu_si256((__m256i *)lo, _mm256_unpacklo_epi64(even, odd));
+    }
+    if (hi) {
+        _mm256_storeu_si256((__m256i *)hi, _mm256_unpackhi_epi64(even, odd));
+    }
+}
+
 #endif /* X86_HOST_CRYPTO_CLMUL_H */
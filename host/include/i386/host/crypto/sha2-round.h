@@ -0,0 +1,60 @@
+/*
+ * x86 specific sha2 acceleration.
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef X86_HOST_CRYPTO_SHA2_ROUND_H
+#define X86_HOST_CRYPTO_SHA2_ROUND_H
+
+#include "host/cpuinfo.h"
+#include <immintrin.h>
+
+#if defined(__SHA__) && defined(__SSSE3__)
+# define HAVE_SHA256_ACCEL  true
+# define ATTR_SHA256_ACCEL
+#else
+# define HAVE_SHA256_ACCEL  likely(cpuinfo & CPUINFO_SHA)
+# define ATTR_SHA256_ACCEL  __attribute__((target("sha,ssse3")))
+#endif
+
+/*
+ * The generic interface uses the same word order as the SHA extensions,
+ * so each operation is a single instruction.
+ */
+
+static inline __m128i sha256_accel_load(const uint32_t *p)
+{
+    return _mm_loadu_si128((const __m128i *)p);
+}
+
+static inline void sha256_accel_store(uint32_t *p, __m128i v)
+{
+    _mm_storeu_si128((__m128i *)p, v);
+}
+
+static inline void ATTR_SHA256_ACCEL
+sha256_rnds2_accel(uint32_t *ret, const uint32_t *cdgh,
+                   const uint32_t *abef, const uint32_t *wk)
+{
+    __m128i k = _mm_loadl_epi64((const __m128i *)wk);
+
+    sha256_accel_store(ret, _mm_sha256rnds2_epu32(sha256_accel_load(cdgh),
+                                                  sha256_accel_load(abef),
+                                                  k));
+}
+
+static inline void ATTR_SHA256_ACCEL
+sha256_msg1_accel(uint32_t *ret, const uint32_t *w0, const uint32_t *w4)
+{
+    sha256_accel_store(ret, _mm_sha256msg1_epu32(sha256_accel_load(w0),
+                                                 sha256_accel_load(w4)));
+}
+
+static inline void ATTR_SHA256_ACCEL
+sha256_msg2_accel(uint32_t *ret, const uint32_t *x, const uint32_t *w12)
+{
+    sha256_accel_store(ret, _mm_sha256msg2_epu32(sha256_accel_load(x),
+                                                 sha256_accel_load(w12)));
+}
+
+#endif /* X86_HOST_CRYPTO_SHA2_ROUND_H */
@@ -197,9 +197,11 @@ void cpu_exec_initfn(CPUState *cpu)
 
 static int cpu_common_post_load(void *opaque, int version_id)
 {
-    if (tcg_enabled()) {
-        CPUState *cpu = opaque;
+    CPUState *cpu = opaque;
 
+    cpu->gdb_state_gen++;
+
+    if (tcg_enabled()) {
         /*
          * 0x01 was CPU_INTERRUPT_EXIT. This line can be removed when the
          * version_id is increased.
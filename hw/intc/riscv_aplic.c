@@ -22,6 +22,7 @@
 #include "qemu/module.h"
 #include "qemu/error-report.h"
 #include "qemu/bswap.h"
+#include "qemu/bitmap.h"
 #include "system/address-spaces.h"
 #include "hw/sysbus.h"
 #include "hw/pci/msi.h"
@@ -247,6 +248,15 @@ static uint32_t riscv_aplic_read_pending_word(RISCVAPLICState *aplic,
     return ret;
 }
 
+static void riscv_aplic_update_enpend(RISCVAPLICState *aplic, uint32_t irq)
+{
+    if ((aplic->state[irq] & APLIC_ISTATE_ENPEND) == APLIC_ISTATE_ENPEND) {
+        set_bit(irq, aplic->enpend);
+    } else {
+        clear_bit(irq, aplic->enpend);
+    }
+}
+
 static void riscv_aplic_set_pending_raw(RISCVAPLICState *aplic,
                                         uint32_t irq, bool pending)
 {
@@ -255,6 +265,7 @@ static void riscv_aplic_set_pending_raw(RISCVAPLICState *aplic,
     } else {
         aplic->state[irq] &= ~APLIC_ISTATE_PENDING;
     }
+    riscv_aplic_update_enpend(aplic, irq);
 }
 
 static void riscv_aplic_set_pending(RISCVAPLICState *aplic,
@@ -341,6 +352,7 @@ static void riscv_aplic_set_enabled_raw(RISCVAPLICState *aplic,
     } else {
         aplic->state[irq] &= ~APLIC_ISTATE_ENABLED;
     }
+    riscv_aplic_update_enpend(aplic, irq);
 }
 
 static void riscv_aplic_set_enabled(RISCVAPLICState *aplic,
@@ -486,12 +498,10 @@ static uint32_t riscv_aplic_idc_topi(RISCVAPLICState *aplic, uint32_t idc)
 
     ithres = aplic->ithreshold[idc];
     best_irq = best_iprio = UINT32_MAX;
-    for (irq = 1; irq < aplic->num_irqs; irq++) {
-        if ((aplic->state[irq] & APLIC_ISTATE_ENPEND) !=
-            APLIC_ISTATE_ENPEND) {
-            continue;
-        }
-
+    /* Only visit sources that are both pending and enabled */
+    for (irq = find_next_bit(aplic->enpend, aplic->num_irqs, 1);
+         irq < aplic->num_irqs;
+         irq = find_next_bit(aplic->enpend, aplic->num_irqs, irq + 1)) {
         ihartidx = aplic->target[irq] >> APLIC_TARGET_HART_IDX_SHIFT;
         ihartidx &= APLIC_TARGET_HART_IDX_MASK;
         if (ihartidx != idc) {
@@ -922,6 +932,7 @@ static void riscv_aplic_realize(DeviceState *dev, Error **errp)
         aplic->bitfield_words = (aplic->num_irqs + 31) >> 5;
         aplic->sourcecfg = g_new0(uint32_t, aplic->num_irqs);
         aplic->state = g_new0(uint32_t, aplic->num_irqs);
+        aplic->enpend = bitmap_new(aplic->num_irqs);
         aplic->target = g_new0(uint32_t, aplic->num_irqs);
         if (!aplic->msimode) {
             for (i = 0; i < aplic->num_irqs; i++) {
@@ -973,11 +984,23 @@ static bool riscv_aplic_state_needed(void *opaque)
     return riscv_use_emulated_aplic(aplic->msimode);
 }
 
+static int riscv_aplic_post_load(void *opaque, int version_id)
+{
+    RISCVAPLICState *aplic = opaque;
+    uint32_t irq;
+
+    for (irq = 0; irq < aplic->num_irqs; irq++) {
+        riscv_aplic_update_enpend(aplic, irq);
+    }
+    return 0;
+}
+
 static const VMStateDescription vmstate_riscv_aplic = {
     .name = "riscv_aplic",
     .version_id = 3,
     .minimum_version_id = 3,
     .needed = riscv_aplic_state_needed,
+    .post_load = riscv_aplic_post_load,
     .fields = (const VMStateField[]) {
             VMSTATE_UINT32(domaincfg, RISCVAPLICState),
             VMSTATE_UINT32(mmsicfgaddr, RISCVAPLICState),
@@ -22,6 +22,7 @@
 #include "qemu/module.h"
 #include "qemu/error-report.h"
 #include "qemu/bswap.h"
+#include "qemu/bitmap.h"
 #include "system/address-spaces.h"
 #include "hw/sysbus.h"
 #include "hw/pci/msi.h"
@@ -46,19 +47,46 @@
 #define IMSIC_EISTATE_ENPEND           (IMSIC_EISTATE_ENABLED | \
                                         IMSIC_EISTATE_PENDING)
 
+static bool riscv_imsic_enpend(RISCVIMSICState *imsic, uint32_t idx)
+{
+    return (qatomic_read(&imsic->eistate[idx]) & IMSIC_EISTATE_ENPEND) ==
+           IMSIC_EISTATE_ENPEND;
+}
+
+/* Must follow every eistate update that may make @idx pending and enabled */
+static void riscv_imsic_hint(RISCVIMSICState *imsic, uint32_t idx)
+{
+    if (riscv_imsic_enpend(imsic, idx)) {
+        set_bit_atomic(idx, imsic->eienpend);
+    }
+}
+
 static uint32_t riscv_imsic_topei(RISCVIMSICState *imsic, uint32_t page)
 {
     uint32_t i, max_irq, base;
+    unsigned long idx, end;
 
     base = page * imsic->num_irqs;
     max_irq = (imsic->eithreshold[page] &&
                (imsic->eithreshold[page] <= imsic->num_irqs)) ?
                imsic->eithreshold[page] : imsic->num_irqs;
-    for (i = 1; i < max_irq; i++) {
-        if ((qatomic_read(&imsic->eistate[base + i]) & IMSIC_EISTATE_ENPEND) ==
-                IMSIC_EISTATE_ENPEND) {
-            return (i << IMSIC_TOPEI_IID_SHIFT) | i;
+    end = base + max_irq;
+    for (idx = find_next_bit(imsic->eienpend, end, base + 1); idx < end;
+         idx = find_next_bit(imsic->eienpend, end, idx + 1)) {
+        if (!riscv_imsic_enpend(imsic, idx)) {
+            /*
+             * Stale hint.  Clear it, then look again in case a concurrent
+             * update set the bit just before we cleared it.
+             */
+            clear_bit_atomic(idx, imsic->eienpend);
+            smp_mb__after_rmw();
+            if (!riscv_imsic_enpend(imsic, idx)) {
+                continue;
+            }
+            set_bit_atomic(idx, imsic->eienpend);
         }
+        i = idx - base;
+        return (i << IMSIC_TOPEI_IID_SHIFT) | i;
     }
 
     return 0;
@@ -182,6 +210,7 @@ static int riscv_imsic_eix_rmw(RISCVIMSICState *imsic,
         if (wr_mask & mask) {
             if (new_val & mask) {
                 prev = qatomic_fetch_or(&imsic->eistate[base + i], state);
+                riscv_imsic_hint(imsic, base + i);
             } else {
                 prev = qatomic_fetch_and(&imsic->eistate[base + i], ~state);
             }
@@ -316,8 +345,10 @@ static void riscv_imsic_write(void *opaque, hwaddr addr, uint64_t value,
     page = addr >> IMSIC_MMIO_PAGE_SHIFT;
     if ((addr & (IMSIC_MMIO_PAGE_SZ - 1)) == IMSIC_MMIO_PAGE_LE) {
         if (value && (value < imsic->num_irqs)) {
-            qatomic_or(&imsic->eistate[(page * imsic->num_irqs) + value],
-                       IMSIC_EISTATE_PENDING);
+            uint32_t idx = (page * imsic->num_irqs) + value;
+
+            qatomic_or(&imsic->eistate[idx], IMSIC_EISTATE_PENDING);
+            riscv_imsic_hint(imsic, idx);
 
             /* Update CPU external interrupt status */
             riscv_imsic_update(imsic, page);
@@ -366,6 +397,7 @@ static void riscv_imsic_realize(DeviceState *dev, Error **errp)
         imsic->eidelivery = g_new0(uint32_t, imsic->num_pages);
         imsic->eithreshold = g_new0(uint32_t, imsic->num_pages);
         imsic->eistate = g_new0(uint32_t, imsic->num_eistate);
+        imsic->eienpend = bitmap_new(imsic->num_eistate);
     }
 
     memory_region_init_io(&imsic->mmio, OBJECT(dev), &riscv_imsic_ops,
@@ -403,11 +435,25 @@ static bool riscv_imsic_state_needed(void *opaque)
     return !kvm_irqchip_in_kernel();
 }
 
+static int riscv_imsic_post_load(void *opaque, int version_id)
+{
+    RISCVIMSICState *imsic = opaque;
+    uint32_t idx;
+
+    for (idx = 0; idx < imsic->num_eistate; idx++) {
+        if (idx % imsic->num_irqs) {
+            riscv_imsic_hint(imsic, idx);
+        }
+    }
+    return 0;
+}
+
 static const VMStateDescription vmstate_riscv_imsic = {
     .name = "riscv_imsic",
     .version_id = 2,
     .minimum_version_id = 2,
     .needed = riscv_imsic_state_needed,
+    .post_load = riscv_imsic_post_load,
     .fields = (const VMStateField[]) {
             VMSTATE_VARRAY_UINT32(eidelivery, RISCVIMSICState,
                                   num_pages, 0,
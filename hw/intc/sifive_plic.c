@@ -62,14 +62,69 @@ static uint32_t atomic_set_masked(uint32_t *a, uint32_t mask, uint32_t value)
     return old;
 }
 
+#define PLIC_BEST_STALE UINT32_MAX
+
+static void sifive_plic_invalidate(SiFivePLICState *plic, uint32_t addrid)
+{
+    plic->best_irq[addrid] = PLIC_BEST_STALE;
+}
+
+static void sifive_plic_invalidate_all(SiFivePLICState *plic)
+{
+    uint32_t addrid;
+
+    for (addrid = 0; addrid < plic->num_addrs; addrid++) {
+        sifive_plic_invalidate(plic, addrid);
+    }
+}
+
+/*
+ * Source @irq became claimable or stopped being claimable: fix up the
+ * cached best source of every context that has it enabled, without
+ * rescanning the other sources.
+ */
+static void sifive_plic_irq_changed(SiFivePLICState *plic, uint32_t irq)
+{
+    uint32_t word = irq >> 5, bit = 1U << (irq & 31);
+    bool ready = (plic->pending[word] & ~plic->claimed[word]) & bit;
+    uint32_t prio = plic->source_priority[irq];
+    uint32_t addrid;
+
+    for (addrid = 0; addrid < plic->num_addrs; addrid++) {
+        uint32_t best = plic->best_irq[addrid];
+        uint32_t best_prio;
+
+        if (best == PLIC_BEST_STALE ||
+            !(plic->enable[addrid * plic->bitfield_words + word] & bit)) {
+            continue;
+        }
+
+        if (!ready) {
+            if (best == irq) {
+                sifive_plic_invalidate(plic, addrid);
+            }
+            continue;
+        }
+
+        /* Ties go to the lowest source number, as in the full scan */
+        best_prio = best ? plic->source_priority[best]
+                         : plic->target_priority[addrid];
+        if (prio > best_prio || (best && prio == best_prio && irq < best)) {
+            plic->best_irq[addrid] = irq;
+        }
+    }
+}
+
 static void sifive_plic_set_pending(SiFivePLICState *plic, int irq, bool level)
 {
     atomic_set_masked(&plic->pending[irq >> 5], 1 << (irq & 31), -!!level);
+    sifive_plic_irq_changed(plic, irq);
 }
 
 static void sifive_plic_set_claimed(SiFivePLICState *plic, int irq, bool level)
 {
     atomic_set_masked(&plic->claimed[irq >> 5], 1 << (irq & 31), -!!level);
+    sifive_plic_irq_changed(plic, irq);
 }
 
 static uint32_t sifive_plic_claimed(SiFivePLICState *plic, uint32_t addrid)
@@ -79,6 +134,10 @@ static uint32_t sifive_plic_claimed(SiFivePLICState *plic, uint32_t addrid)
     int i, j;
     int num_irq_in_word = 32;
 
+    if (plic->best_irq[addrid] != PLIC_BEST_STALE) {
+        return plic->best_irq[addrid];
+    }
+
     for (i = 0; i < plic->bitfield_words; i++) {
         uint32_t pending_enabled_not_claimed =
                         (plic->pending[i] & ~plic->claimed[i]) &
@@ -109,6 +168,7 @@ static uint32_t sifive_plic_claimed(SiFivePLICState *plic, uint32_t addrid)
         }
     }
 
+    plic->best_irq[addrid] = max_irq;
     return max_irq;
 }
 
@@ -202,9 +262,11 @@ static void sifive_plic_write(void *opaque, hwaddr addr, uint64_t value,
              * out the access to unsupported priority bits.
              */
             plic->source_priority[irq] = value % (plic->num_priorities + 1);
+            sifive_plic_invalidate_all(plic);
             sifive_plic_update(plic);
         } else if (value <= plic->num_priorities) {
             plic->source_priority[irq] = value;
+            sifive_plic_invalidate_all(plic);
             sifive_plic_update(plic);
         }
     } else if (addr_between(addr, plic->pending_base,
@@ -219,6 +281,7 @@ static void sifive_plic_write(void *opaque, hwaddr addr, uint64_t value,
 
         if (wordid < plic->bitfield_words) {
             plic->enable[addrid * plic->bitfield_words + wordid] = value;
+            sifive_plic_invalidate(plic, addrid);
         } else {
             qemu_log_mask(LOG_GUEST_ERROR,
                           "%s: Invalid enable write 0x%" HWADDR_PRIx "\n",
@@ -238,9 +301,11 @@ static void sifive_plic_write(void *opaque, hwaddr addr, uint64_t value,
                  */
                 plic->target_priority[addrid] = value %
                                                 (plic->num_priorities + 1);
+                sifive_plic_invalidate(plic, addrid);
                 sifive_plic_update(plic);
             } else if (value <= plic->num_priorities) {
                 plic->target_priority[addrid] = value;
+                sifive_plic_invalidate(plic, addrid);
                 sifive_plic_update(plic);
             }
         } else if (contextid == 4) {
@@ -280,6 +345,7 @@ static void sifive_plic_reset(DeviceState *dev)
     memset(s->pending, 0, sizeof(uint32_t) * s->bitfield_words);
     memset(s->claimed, 0, sizeof(uint32_t) * s->bitfield_words);
     memset(s->enable, 0, sizeof(uint32_t) * s->num_enables);
+    sifive_plic_invalidate_all(s);
 
     for (i = 0; i < s->num_harts; i++) {
         qemu_set_irq(s->m_external_irqs[i], 0);
@@ -383,6 +449,8 @@ static void sifive_plic_realize(DeviceState *dev, Error **errp)
     s->pending = g_new0(uint32_t, s->bitfield_words);
     s->claimed = g_new0(uint32_t, s->bitfield_words);
     s->enable = g_new0(uint32_t, s->num_enables);
+    s->best_irq = g_new(uint32_t, s->num_addrs);
+    sifive_plic_invalidate_all(s);
 
     qdev_init_gpio_in(dev, sifive_plic_irq_request, s->num_sources);
 
@@ -409,10 +477,17 @@ static void sifive_plic_realize(DeviceState *dev, Error **errp)
     msi_nonbroken = true;
 }
 
+static int sifive_plic_post_load(void *opaque, int version_id)
+{
+    sifive_plic_invalidate_all(opaque);
+    return 0;
+}
+
 static const VMStateDescription vmstate_sifive_plic = {
     .name = "riscv_sifive_plic",
     .version_id = 1,
     .minimum_version_id = 1,
+    .post_load = sifive_plic_post_load,
     .fields = (const VMStateField[]) {
             VMSTATE_VARRAY_UINT32(source_priority, SiFivePLICState,
                                   num_sources, 0,
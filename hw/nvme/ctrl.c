@@ -257,6 +257,7 @@ static const uint32_t nvme_feature_cap[NVME_FID_MAX] = {
     [NVME_ERROR_RECOVERY]           = NVME_FEAT_CAP_CHANGE | NVME_FEAT_CAP_NS,
     [NVME_VOLATILE_WRITE_CACHE]     = NVME_FEAT_CAP_CHANGE,
     [NVME_NUMBER_OF_QUEUES]         = NVME_FEAT_CAP_CHANGE,
+    [NVME_INTERRUPT_COALESCING]     = NVME_FEAT_CAP_CHANGE,
     [NVME_WRITE_ATOMICITY]          = NVME_FEAT_CAP_CHANGE,
     [NVME_ASYNCHRONOUS_EVENT_CONF]  = NVME_FEAT_CAP_CHANGE,
     [NVME_TIMESTAMP]                = NVME_FEAT_CAP_CHANGE,
@@ -790,6 +791,67 @@ static void nvme_sg_split(NvmeSg *sg, NvmeNamespace *ns, NvmeSg *data,
     }
 }
 
+/*
+ * PRP entries and SGL descriptors usually describe physically contiguous
+ * memory one page at a time. Extend the last mapping instead of adding a new
+ * one in that case, so that a large transfer ends up as a few large
+ * segments rather than one per page.
+ */
+static bool nvme_sglist_extend(QEMUSGList *qsg, hwaddr addr, size_t len)
+{
+    ScatterGatherEntry *last;
+
+    if (!qsg->nsg) {
+        return false;
+    }
+
+    last = &qsg->sg[qsg->nsg - 1];
+    if (last->base + last->len != addr) {
+        return false;
+    }
+
+    last->len += len;
+    qsg->size += len;
+
+    return true;
+}
+
+static bool nvme_iovec_extend(QEMUIOVector *iov, void *base, size_t len)
+{
+    struct iovec *last;
+
+    if (!iov->niov) {
+        return false;
+    }
+
+    last = &iov->iov[iov->niov - 1];
+    if (last->iov_base + last->iov_len != base) {
+        return false;
+    }
+
+    last->iov_len += len;
+    iov->size += len;
+
+    return true;
+}
+
+static uint16_t nvme_iovec_add(QEMUIOVector *iov, void *base, size_t len)
+{
+    if (nvme_iovec_extend(iov, base, len)) {
+        return NVME_SUCCESS;
+    }
+
+    if (iov->niov + 1 > IOV_MAX) {
+        NVME_GUEST_ERR(pci_nvme_ub_too_many_mappings,
+                       "number of mappings exceed 1024");
+        return NVME_INTERNAL_DEV_ERROR | NVME_DNR;
+    }
+
+    qemu_iovec_add(iov, base, len);
+
+    return NVME_SUCCESS;
+}
+
 static uint16_t nvme_map_addr_cmb(NvmeCtrl *n, QEMUIOVector *iov, hwaddr addr,
                                   size_t len)
 {
@@ -803,9 +865,7 @@ static uint16_t nvme_map_addr_cmb(NvmeCtrl *n, QEMUIOVector *iov, hwaddr addr,
         return NVME_DATA_TRAS_ERROR;
     }
 
-    qemu_iovec_add(iov, nvme_addr_to_cmb(n, addr), len);
-
-    return NVME_SUCCESS;
+    return nvme_iovec_add(iov, nvme_addr_to_cmb(n, addr), len);
 }
 
 static uint16_t nvme_map_addr_pmr(NvmeCtrl *n, QEMUIOVector *iov, hwaddr addr,
@@ -819,9 +879,7 @@ static uint16_t nvme_map_addr_pmr(NvmeCtrl *n, QEMUIOVector *iov, hwaddr addr,
         return NVME_DATA_TRAS_ERROR;
     }
 
-    qemu_iovec_add(iov, nvme_addr_to_pmr(n, addr), len);
-
-    return NVME_SUCCESS;
+    return nvme_iovec_add(iov, nvme_addr_to_pmr(n, addr), len);
 }
 
 static uint16_t nvme_map_addr(NvmeCtrl *n, NvmeSg *sg, hwaddr addr, size_t len)
@@ -849,10 +907,6 @@ static uint16_t nvme_map_addr(NvmeCtrl *n, NvmeSg *sg, hwaddr addr, size_t len)
             return NVME_INVALID_USE_OF_CMB | NVME_DNR;
         }
 
-        if (sg->iov.niov + 1 > IOV_MAX) {
-            goto max_mappings_exceeded;
-        }
-
         if (cmb) {
             return nvme_map_addr_cmb(n, &sg->iov, addr, len);
         } else {
@@ -864,6 +918,10 @@ static uint16_t nvme_map_addr(NvmeCtrl *n, NvmeSg *sg, hwaddr addr, size_t len)
         return NVME_INVALID_USE_OF_CMB | NVME_DNR;
     }
 
+    if (nvme_sglist_extend(&sg->qsg, addr, len)) {
+        return NVME_SUCCESS;
+    }
+
     if (sg->qsg.nsg + 1 > IOV_MAX) {
         goto max_mappings_exceeded;
     }
@@ -904,7 +962,7 @@ static uint16_t nvme_map_prp(NvmeCtrl *n, NvmeSg *sg, uint64_t prp1,
     len -= trans_len;
     if (len) {
         if (len > n->page_size) {
-            g_autofree uint64_t *prp_list = g_new(uint64_t, n->max_prp_ents);
+            uint64_t *prp_list = n->prp_list;
             uint32_t nents, prp_trans;
             int i = 0;
 
@@ -1493,58 +1551,129 @@ static void nvme_update_cq_head(NvmeCQueue *cq)
     trace_pci_nvme_update_cq_head(cq->cqid, cq->head);
 }
 
+/*
+ * Interrupt Coalescing: the interrupt of an I/O completion queue is held
+ * back until more than THR entries were posted or TIME (in 100
+ * microsecond units) has elapsed. The admin queue is never coalesced.
+ *
+ * Returns true if the interrupt was deferred.
+ */
+static bool nvme_coalesce_irq(NvmeCtrl *n, NvmeCQueue *cq, uint32_t posted)
+{
+    uint32_t intc = n->features.int_coalescing;
+
+    if (!cq->cqid || cq->vector == n->admin_cq.vector ||
+        !NVME_INTC_TIME(intc)) {
+        return false;
+    }
+
+    cq->coalesced += posted;
+    if (cq->coalesced > NVME_INTC_THR(intc)) {
+        cq->coalesced = 0;
+        timer_del(cq->coalesce_timer);
+        return false;
+    }
+
+    if (!timer_pending(cq->coalesce_timer)) {
+        timer_mod(cq->coalesce_timer,
+                  qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) +
+                  NVME_INTC_TIME(intc) * 100 * SCALE_US);
+    }
+
+    return true;
+}
+
+static void nvme_coalesce_timer_cb(void *opaque)
+{
+    NvmeCQueue *cq = opaque;
+
+    cq->coalesced = 0;
+    if (cq->tail != cq->head) {
+        nvme_irq_assert(cq->ctrl, cq);
+    }
+}
+
+/* number of completion queue entries posted with a single DMA write */
+#define NVME_CQE_BATCH 32
+
 static void nvme_post_cqes(void *opaque)
 {
     NvmeCQueue *cq = opaque;
     NvmeCtrl *n = cq->ctrl;
-    NvmeRequest *req, *next;
+    NvmeRequest *req, *batch[NVME_CQE_BATCH];
+    NvmeCqe cqes[NVME_CQE_BATCH];
     bool pending = cq->head != cq->tail;
-    int ret;
+    uint32_t posted = 0;
+    int i, nr;
 
-    QTAILQ_FOREACH_SAFE(req, &cq->req_list, entry, next) {
-        NvmeSQueue *sq;
-        hwaddr addr;
+    while (!QTAILQ_EMPTY(&cq->req_list)) {
+        hwaddr addr = cq->dma_addr + (cq->tail << NVME_CQES);
+        uint32_t tail = cq->tail;
 
         if (n->dbbuf_enabled) {
             nvme_update_cq_eventidx(cq);
             nvme_update_cq_head(cq);
         }
 
-        if (nvme_cq_full(cq)) {
+        /*
+         * Gather the entries that fit in contiguous free slots, stopping at
+         * the end of the queue where the phase tag flips.
+         */
+        nr = 0;
+        QTAILQ_FOREACH(req, &cq->req_list, entry) {
+            NvmeSQueue *sq = req->sq;
+
+            if (nr == NVME_CQE_BATCH || (tail + 1) % cq->size == cq->head) {
+                break;
+            }
+
+            req->cqe.status = cpu_to_le16((req->status << 1) | cq->phase);
+            req->cqe.sq_id = cpu_to_le16(sq->sqid);
+            req->cqe.sq_head = cpu_to_le16(sq->head);
+            cqes[nr] = req->cqe;
+            batch[nr++] = req;
+
+            if (++tail == cq->size) {
+                break;
+            }
+        }
+
+        if (!nr) {
             break;
         }
 
-        sq = req->sq;
-        req->cqe.status = cpu_to_le16((req->status << 1) | cq->phase);
-        req->cqe.sq_id = cpu_to_le16(sq->sqid);
-        req->cqe.sq_head = cpu_to_le16(sq->head);
-        addr = cq->dma_addr + (cq->tail << NVME_CQES);
-        ret = pci_dma_write(PCI_DEVICE(n), addr, (void *)&req->cqe,
-                            sizeof(req->cqe));
-        if (ret) {
+        if (pci_dma_write(PCI_DEVICE(n), addr, cqes, nr * sizeof(NvmeCqe))) {
             trace_pci_nvme_err_addr_write(addr);
             trace_pci_nvme_err_cfs();
             stl_le_p(&n->bar.csts, NVME_CSTS_FAILED);
             break;
         }
 
-        QTAILQ_REMOVE(&cq->req_list, req, entry);
+        for (i = 0; i < nr; i++) {
+            NvmeSQueue *sq = batch[i]->sq;
 
-        nvme_inc_cq_tail(cq);
-        nvme_sg_unmap(&req->sg);
+            req = batch[i];
+            QTAILQ_REMOVE(&cq->req_list, req, entry);
 
-        if (QTAILQ_EMPTY(&sq->req_list) && !nvme_sq_empty(sq)) {
-            qemu_bh_schedule(sq->bh);
-        }
+            nvme_inc_cq_tail(cq);
+            nvme_sg_unmap(&req->sg);
 
-        QTAILQ_INSERT_TAIL(&sq->req_list, req, entry);
+            if (QTAILQ_EMPTY(&sq->req_list) && !nvme_sq_empty(sq)) {
+                qemu_bh_schedule(sq->bh);
+            }
+
+            QTAILQ_INSERT_TAIL(&sq->req_list, req, entry);
+        }
+        posted += nr;
     }
     if (cq->tail != cq->head) {
         if (cq->irq_enabled && !pending) {
             n->cq_pending++;
         }
 
-        nvme_irq_assert(n, cq);
+        if (!nvme_coalesce_irq(n, cq, posted)) {
+            nvme_irq_assert(n, cq);
+        }
     }
 }
 
@@ -5509,6 +5638,7 @@ static void nvme_free_cq(NvmeCQueue *cq, NvmeCtrl *n)
 
     n->cq[cq->cqid] = NULL;
     qemu_bh_delete(cq->bh);
+    timer_free(cq->coalesce_timer);
     if (cq->ioeventfd_enabled) {
         memory_region_del_eventfd(&n->iomem,
                                   0x1000 + offset, 4, false, 0, &cq->notifier);
@@ -5568,6 +5698,7 @@ static void nvme_init_cq(NvmeCQueue *cq, NvmeCtrl *n, uint64_t dma_addr,
     cq->irq_enabled = irq_enabled;
     cq->vector = vector;
     cq->head = cq->tail = 0;
+    cq->coalesced = 0;
     QTAILQ_INIT(&cq->req_list);
     QTAILQ_INIT(&cq->sq_list);
     if (n->dbbuf_enabled) {
@@ -5583,6 +5714,8 @@ static void nvme_init_cq(NvmeCQueue *cq, NvmeCtrl *n, uint64_t dma_addr,
     n->cq[cqid] = cq;
     cq->bh = qemu_bh_new_guarded(nvme_post_cqes, cq,
                                  &DEVICE(cq->ctrl)->mem_reentrancy_guard);
+    cq->coalesce_timer = timer_new_ns(QEMU_CLOCK_VIRTUAL,
+                                      nvme_coalesce_timer_cb, cq);
 }
 
 static uint16_t nvme_create_cq(NvmeCtrl *n, NvmeRequest *req)
@@ -6371,6 +6504,9 @@ static uint16_t nvme_get_feature(NvmeCtrl *n, NvmeRequest *req)
     case NVME_ASYNCHRONOUS_EVENT_CONF:
         result = n->features.async_config;
         goto out;
+    case NVME_INTERRUPT_COALESCING:
+        result = n->features.int_coalescing;
+        goto out;
     case NVME_TIMESTAMP:
         return nvme_get_feature_timestamp(n, req);
     case NVME_HOST_BEHAVIOR_SUPPORT:
@@ -6654,6 +6790,9 @@ static uint16_t nvme_set_feature(NvmeCtrl *n, NvmeRequest *req)
     case NVME_ASYNCHRONOUS_EVENT_CONF:
         n->features.async_config = dw11;
         break;
+    case NVME_INTERRUPT_COALESCING:
+        n->features.int_coalescing = dw11 & 0xffff;
+        break;
     case NVME_TIMESTAMP:
         return nvme_set_feature_timestamp(n, req);
     case NVME_HOST_BEHAVIOR_SUPPORT:
@@ -7668,6 +7807,7 @@ static void nvme_ctrl_reset(NvmeCtrl *n, NvmeResetType rst)
     n->dbbuf_dbs = 0;
     n->dbbuf_eis = 0;
     n->dbbuf_enabled = false;
+    n->features.int_coalescing = 0;
 }
 
 static void nvme_ctrl_shutdown(NvmeCtrl *n)
@@ -7750,6 +7890,7 @@ static int nvme_start_ctrl(NvmeCtrl *n)
     n->page_bits = page_bits;
     n->page_size = page_size;
     n->max_prp_ents = n->page_size / sizeof(uint64_t);
+    n->prp_list = g_renew(uint64_t, n->prp_list, n->max_prp_ents);
     nvme_init_cq(&n->admin_cq, n, acq, 0, 0, NVME_AQA_ACQS(aqa) + 1, 1);
     nvme_init_sq(&n->admin_sq, n, asq, 0, 0, NVME_AQA_ASQS(aqa) + 1);
 
@@ -9035,6 +9176,7 @@ static void nvme_exit(PCIDevice *pci_dev)
     g_free(n->cq);
     g_free(n->sq);
     g_free(n->aer_reqs);
+    g_free(n->prp_list);
 
     if (n->params.cmb_size_mb) {
         g_free(n->cmb.buf);
@@ -245,6 +245,11 @@ enum RISCV_IOMMU_HPMEVENT_id {
     RISCV_IOMMU_HPMEVENT_MAX        = 9
 };
 
+/* Implementation defined events, IDs from 16384 up are for custom use */
+#define RISCV_IOMMU_HPMEVENT_CUSTOM     16384
+#define RISCV_IOMMU_HPMEVENT_TLB_HIT    (RISCV_IOMMU_HPMEVENT_CUSTOM + 0)
+#define RISCV_IOMMU_HPMEVENT_CUSTOM_MAX (RISCV_IOMMU_HPMEVENT_CUSTOM + 1)
+
 /* 5.24 Translation request IOVA (64bits) */
 #define RISCV_IOMMU_REG_TR_REQ_IOVA     0x0258
 
@@ -343,6 +348,7 @@ struct riscv_iommu_command {
 #define RISCV_IOMMU_CMD_IOFENCE_OPCODE          2
 #define RISCV_IOMMU_CMD_IOFENCE_FUNC_C          0
 #define RISCV_IOMMU_CMD_IOFENCE_AV      BIT_ULL(10)
+#define RISCV_IOMMU_CMD_IOFENCE_WSI     BIT_ULL(11)
 #define RISCV_IOMMU_CMD_IOFENCE_DATA    GENMASK_ULL(63, 32)
 
 #define RISCV_IOMMU_CMD_IODIR_OPCODE            3
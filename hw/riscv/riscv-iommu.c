@@ -25,6 +25,7 @@
 #include "hw/riscv/riscv_hart.h"
 #include "migration/vmstate.h"
 #include "qapi/error.h"
+#include "qemu/main-loop.h"
 #include "qemu/timer.h"
 
 #include "cpu_bits.h"
@@ -67,8 +68,18 @@ struct RISCVIOMMUEntry {
     uint64_t phys:44;           /* Physical Page Number */
     uint64_t gscid:16;          /* Guest Soft-Context identifier */
     uint64_t perm:2;            /* IOMMU_RW flags */
+    uint64_t level:2;           /* Page size: 4KiB << (9 * level) */
 };
 
+/* Cached page sizes: 4KiB, 2MiB, 1GiB and 512GiB */
+#define RISCV_IOMMU_IOT_LEVELS 4
+
+/* Page number of the @level page containing page number @ppn */
+static inline uint64_t riscv_iommu_iot_ppn(uint64_t ppn, unsigned level)
+{
+    return ppn & ~((1ULL << (9 * level)) - 1);
+}
+
 /* IOMMU index for transactions without process_id specified. */
 #define RISCV_IOMMU_NOPROCID 0
 
@@ -1237,13 +1248,20 @@ static gboolean riscv_iommu_iot_equal(gconstpointer v1, gconstpointer v2)
     RISCVIOMMUEntry *t1 = (RISCVIOMMUEntry *) v1;
     RISCVIOMMUEntry *t2 = (RISCVIOMMUEntry *) v2;
     return t1->gscid == t2->gscid && t1->pscid == t2->pscid &&
-           t1->iova == t2->iova && t1->tag == t2->tag;
+           t1->iova == t2->iova && t1->tag == t2->tag &&
+           t1->level == t2->level;
 }
 
 static guint riscv_iommu_iot_hash(gconstpointer v)
 {
     RISCVIOMMUEntry *t = (RISCVIOMMUEntry *) v;
-    return (guint)t->iova;
+    return (guint)(t->iova >> (9 * t->level));
+}
+
+/* Does the cache entry @iot translate the page number in @arg? */
+static bool riscv_iommu_iot_covers(RISCVIOMMUEntry *iot, RISCVIOMMUEntry *arg)
+{
+    return iot->iova == riscv_iommu_iot_ppn(arg->iova, iot->level);
 }
 
 /* GV: 0 AV: 0 PSCV: 0 GVMA: 0 */
@@ -1277,7 +1295,7 @@ void riscv_iommu_iot_inval_iova(gpointer key, gpointer value, gpointer data)
     RISCVIOMMUEntry *iot = (RISCVIOMMUEntry *) value;
     RISCVIOMMUEntry *arg = (RISCVIOMMUEntry *) data;
     if (iot->tag == arg->tag &&
-        iot->iova == arg->iova) {
+        riscv_iommu_iot_covers(iot, arg)) {
         iot->perm = IOMMU_NONE;
     }
 }
@@ -1290,7 +1308,7 @@ static void riscv_iommu_iot_inval_pscid_iova(gpointer key, gpointer value,
     RISCVIOMMUEntry *arg = (RISCVIOMMUEntry *) data;
     if (iot->tag == arg->tag &&
         iot->pscid == arg->pscid &&
-        iot->iova == arg->iova) {
+        riscv_iommu_iot_covers(iot, arg)) {
         iot->perm = IOMMU_NONE;
     }
 }
@@ -1330,7 +1348,7 @@ static void riscv_iommu_iot_inval_gscid_iova(gpointer key, gpointer value,
     RISCVIOMMUEntry *arg = (RISCVIOMMUEntry *) data;
     if (iot->tag == arg->tag &&
         iot->gscid == arg->gscid &&
-        iot->iova == arg->iova) {
+        riscv_iommu_iot_covers(iot, arg)) {
         iot->perm = IOMMU_NONE;
     }
 }
@@ -1344,22 +1362,50 @@ static void riscv_iommu_iot_inval_gscid_pscid_iova(gpointer key, gpointer value,
     if (iot->tag == arg->tag &&
         iot->gscid == arg->gscid &&
         iot->pscid == arg->pscid &&
-        iot->iova == arg->iova) {
+        riscv_iommu_iot_covers(iot, arg)) {
         iot->perm = IOMMU_NONE;
     }
 }
 
+/*
+ * Single stage translations do not depend on the GSCID. It is left out of
+ * their cache key, so that they can be looked up directly on invalidation.
+ */
+static uint32_t riscv_iommu_iot_gscid(RISCVIOMMUContext *ctx,
+    RISCVIOMMUTransTag transtag)
+{
+    if (transtag == RISCV_IOMMU_TRANS_TAG_SS) {
+        return 0;
+    }
+    return get_field(ctx->gatp, RISCV_IOMMU_DC_IOHGATP_GSCID);
+}
+
 /* caller should keep ref-count for iot_cache object */
-static RISCVIOMMUEntry *riscv_iommu_iot_lookup(RISCVIOMMUContext *ctx,
-    GHashTable *iot_cache, hwaddr iova, RISCVIOMMUTransTag transtag)
+static RISCVIOMMUEntry *riscv_iommu_iot_lookup(RISCVIOMMUState *s,
+    RISCVIOMMUContext *ctx, GHashTable *iot_cache, hwaddr iova,
+    RISCVIOMMUTransTag transtag)
 {
     RISCVIOMMUEntry key = {
         .tag   = transtag,
-        .gscid = get_field(ctx->gatp, RISCV_IOMMU_DC_IOHGATP_GSCID),
+        .gscid = riscv_iommu_iot_gscid(ctx, transtag),
         .pscid = get_field(ctx->ta, RISCV_IOMMU_DC_TA_PSCID),
-        .iova  = PPN_DOWN(iova),
     };
-    return g_hash_table_lookup(iot_cache, &key);
+    RISCVIOMMUEntry *iot;
+    unsigned level;
+
+    /* Only probe the page sizes present in the cache */
+    for (level = 0; level < RISCV_IOMMU_IOT_LEVELS; level++) {
+        if (!(s->iot_levels & BIT(level))) {
+            continue;
+        }
+        key.level = level;
+        key.iova = riscv_iommu_iot_ppn(PPN_DOWN(iova), level);
+        iot = g_hash_table_lookup(iot_cache, &key);
+        if (iot && iot->perm != IOMMU_NONE) {
+            return iot;
+        }
+    }
+    return NULL;
 }
 
 /* caller should keep ref-count for iot_cache object */
@@ -1375,14 +1421,61 @@ static void riscv_iommu_iot_update(RISCVIOMMUState *s,
                                           riscv_iommu_iot_equal,
                                           g_free, NULL);
         g_hash_table_unref(qatomic_xchg(&s->iot_cache, iot_cache));
+        s->iot_levels = 0;
     }
+    s->iot_levels |= BIT(iot->level);
     g_hash_table_add(iot_cache, iot);
 }
 
-static void riscv_iommu_iot_inval(RISCVIOMMUState *s, GHFunc func,
-    uint32_t gscid, uint32_t pscid, hwaddr iova, RISCVIOMMUTransTag transtag)
+/*
+ * Invalidations that have to visit every cache entry are queued while the
+ * command queue is processed, and applied in a single pass over the cache.
+ */
+#define RISCV_IOMMU_INVAL_BATCH 32
+
+typedef struct RISCVIOMMUInvalBatch {
+    unsigned count;
+    struct {
+        GHFunc func;
+        RISCVIOMMUEntry key;
+    } inval[RISCV_IOMMU_INVAL_BATCH];
+} RISCVIOMMUInvalBatch;
+
+static void riscv_iommu_iot_inval_batch(gpointer key, gpointer value,
+                                        gpointer data)
+{
+    RISCVIOMMUInvalBatch *batch = data;
+    unsigned i;
+
+    for (i = 0; i < batch->count; i++) {
+        batch->inval[i].func(key, value, &batch->inval[i].key);
+    }
+}
+
+static void riscv_iommu_iot_inval_flush(RISCVIOMMUState *s,
+    RISCVIOMMUInvalBatch *batch)
 {
     GHashTable *iot_cache;
+
+    if (!batch->count) {
+        return;
+    }
+
+    iot_cache = g_hash_table_ref(s->iot_cache);
+    if (batch->count == 1) {
+        g_hash_table_foreach(iot_cache, batch->inval[0].func,
+                             &batch->inval[0].key);
+    } else {
+        g_hash_table_foreach(iot_cache, riscv_iommu_iot_inval_batch, batch);
+    }
+    g_hash_table_unref(iot_cache);
+    batch->count = 0;
+}
+
+static void riscv_iommu_iot_inval(RISCVIOMMUState *s,
+    RISCVIOMMUInvalBatch *batch, GHFunc func, uint32_t gscid, uint32_t pscid,
+    hwaddr iova, RISCVIOMMUTransTag transtag)
+{
     RISCVIOMMUEntry key = {
         .tag = transtag,
         .gscid = gscid,
@@ -1390,11 +1483,71 @@ static void riscv_iommu_iot_inval(RISCVIOMMUState *s, GHFunc func,
         .iova  = PPN_DOWN(iova),
     };
 
+    if (batch->count == RISCV_IOMMU_INVAL_BATCH) {
+        riscv_iommu_iot_inval_flush(s, batch);
+    }
+    batch->inval[batch->count].func = func;
+    batch->inval[batch->count].key = key;
+    batch->count++;
+}
+
+/*
+ * Invalidate the translations of a single address when all of the cache key
+ * is known: look up the entries of each cached page size that may cover it
+ * rather than walking the whole cache.
+ */
+static void riscv_iommu_iot_inval_page(RISCVIOMMUState *s, uint32_t gscid,
+    uint32_t pscid, hwaddr iova, RISCVIOMMUTransTag transtag)
+{
+    GHashTable *iot_cache;
+    RISCVIOMMUEntry *iot;
+    RISCVIOMMUEntry key = {
+        .tag = transtag,
+        .gscid = gscid,
+        .pscid = pscid,
+    };
+    unsigned level;
+
     iot_cache = g_hash_table_ref(s->iot_cache);
-    g_hash_table_foreach(iot_cache, func, &key);
+    for (level = 0; level < RISCV_IOMMU_IOT_LEVELS; level++) {
+        if (!(s->iot_levels & BIT(level))) {
+            continue;
+        }
+        key.level = level;
+        key.iova = riscv_iommu_iot_ppn(PPN_DOWN(iova), level);
+        iot = g_hash_table_lookup(iot_cache, &key);
+        if (iot) {
+            iot->perm = IOMMU_NONE;
+        }
+    }
     g_hash_table_unref(iot_cache);
 }
 
+/*
+ * Largest cached page size fitting the translation. MSI pages must keep
+ * trapping, so they may not be covered by a larger cached page.
+ */
+static unsigned riscv_iommu_iot_level(RISCVIOMMUState *s,
+    RISCVIOMMUContext *ctx, IOMMUTLBEntry *iotlb)
+{
+    unsigned level;
+
+    if (s->enable_msi &&
+        get_field(ctx->msiptp, RISCV_IOMMU_DC_MSIPTP_MODE) ==
+        RISCV_IOMMU_DC_MSIPTP_MODE_FLAT) {
+        return 0;
+    }
+
+    for (level = RISCV_IOMMU_IOT_LEVELS - 1; level > 0; level--) {
+        hwaddr mask = (TARGET_PAGE_SIZE << (9 * level)) - 1;
+
+        if ((iotlb->addr_mask & mask) == mask) {
+            break;
+        }
+    }
+    return level;
+}
+
 static RISCVIOMMUTransTag riscv_iommu_get_transtag(RISCVIOMMUContext *ctx)
 {
     uint64_t satp = get_field(ctx->satp, RISCV_IOMMU_ATP_MODE_FIELD);
@@ -1441,11 +1594,14 @@ static int riscv_iommu_translate(RISCVIOMMUState *s, RISCVIOMMUContext *ctx,
         }
     }
 
-    iot = riscv_iommu_iot_lookup(ctx, iot_cache, iotlb->iova, transtag);
+    iot = riscv_iommu_iot_lookup(s, ctx, iot_cache, iotlb->iova, transtag);
     perm = iot ? iot->perm : IOMMU_NONE;
     if (perm != IOMMU_NONE) {
-        iotlb->translated_addr = PPN_PHYS(iot->phys);
-        iotlb->addr_mask = ~TARGET_PAGE_MASK;
+        hwaddr mask = (TARGET_PAGE_SIZE << (9 * iot->level)) - 1;
+
+        riscv_iommu_hpm_incr_ctr(s, ctx, RISCV_IOMMU_HPMEVENT_TLB_HIT);
+        iotlb->translated_addr = PPN_PHYS(iot->phys) | (iotlb->iova & mask);
+        iotlb->addr_mask = mask;
         iotlb->perm = perm;
         fault = 0;
         goto done;
@@ -1469,9 +1625,11 @@ static int riscv_iommu_translate(RISCVIOMMUState *s, RISCVIOMMUContext *ctx,
      */
     if (!fault && iotlb->translated_addr != iotlb->iova && enable_cache) {
         iot = g_new0(RISCVIOMMUEntry, 1);
-        iot->iova = PPN_DOWN(iotlb->iova);
-        iot->phys = PPN_DOWN(iotlb->translated_addr);
-        iot->gscid = get_field(ctx->gatp, RISCV_IOMMU_DC_IOHGATP_GSCID);
+        iot->level = riscv_iommu_iot_level(s, ctx, iotlb);
+        iot->iova = riscv_iommu_iot_ppn(PPN_DOWN(iotlb->iova), iot->level);
+        iot->phys = riscv_iommu_iot_ppn(PPN_DOWN(iotlb->translated_addr),
+                                        iot->level);
+        iot->gscid = riscv_iommu_iot_gscid(ctx, transtag);
         iot->pscid = get_field(ctx->ta, RISCV_IOMMU_DC_TA_PSCID);
         iot->perm = iotlb->perm;
         iot->tag = transtag;
@@ -1633,6 +1791,7 @@ static void riscv_iommu_process_ddtp(RISCVIOMMUState *s)
 
 static void riscv_iommu_process_cq_tail(RISCVIOMMUState *s)
 {
+    RISCVIOMMUInvalBatch batch = { .count = 0 };
     struct riscv_iommu_command cmd;
     MemTxResult res;
     dma_addr_t addr;
@@ -1666,9 +1825,22 @@ static void riscv_iommu_process_cq_tail(RISCVIOMMUState *s)
         cmd_opcode = get_field(cmd.dword0,
                                RISCV_IOMMU_CMD_OPCODE | RISCV_IOMMU_CMD_FUNC);
 
+        /* Queued invalidations must complete before any other command. */
+        if (get_field(cmd.dword0, RISCV_IOMMU_CMD_OPCODE) !=
+            RISCV_IOMMU_CMD_IOTINVAL_OPCODE) {
+            riscv_iommu_iot_inval_flush(s, &batch);
+        }
+
         switch (cmd_opcode) {
         case RISCV_IOMMU_CMD(RISCV_IOMMU_CMD_IOFENCE_FUNC_C,
                              RISCV_IOMMU_CMD_IOFENCE_OPCODE):
+            if ((cmd.dword0 & RISCV_IOMMU_CMD_IOFENCE_WSI) &&
+                !(riscv_iommu_reg_get32(s, RISCV_IOMMU_REG_FCTL) &
+                  RISCV_IOMMU_FCTL_WSI)) {
+                /* wired interrupt requested but MSIs are in use */
+                goto cmd_ill;
+            }
+
             res = riscv_iommu_iofence(s,
                 cmd.dword0 & RISCV_IOMMU_CMD_IOFENCE_AV, cmd.dword1 << 2,
                 get_field(cmd.dword0, RISCV_IOMMU_CMD_IOFENCE_DATA));
@@ -1678,6 +1850,14 @@ static void riscv_iommu_process_cq_tail(RISCVIOMMUState *s)
                                       RISCV_IOMMU_CQCSR_CQMF, 0);
                 goto fault;
             }
+
+            if (cmd.dword0 & RISCV_IOMMU_CMD_IOFENCE_WSI) {
+                riscv_iommu_reg_mod32(s, RISCV_IOMMU_REG_CQCSR,
+                                      RISCV_IOMMU_CQCSR_FENCE_W_IP, 0);
+                if (ctrl & RISCV_IOMMU_CQCSR_CIE) {
+                    riscv_iommu_notify(s, RISCV_IOMMU_INTR_CQ);
+                }
+            }
             break;
 
         case RISCV_IOMMU_CMD(RISCV_IOMMU_CMD_IOTINVAL_FUNC_GVMA,
@@ -1705,10 +1885,10 @@ static void riscv_iommu_process_cq_tail(RISCVIOMMUState *s)
             }
 
             riscv_iommu_iot_inval(
-                s, func, gscid, pscid, iova, RISCV_IOMMU_TRANS_TAG_VG);
+                s, &batch, func, gscid, pscid, iova, RISCV_IOMMU_TRANS_TAG_VG);
 
             riscv_iommu_iot_inval(
-                s, func, gscid, pscid, iova, RISCV_IOMMU_TRANS_TAG_VN);
+                s, &batch, func, gscid, pscid, iova, RISCV_IOMMU_TRANS_TAG_VN);
             break;
         }
 
@@ -1745,7 +1925,13 @@ static void riscv_iommu_process_cq_tail(RISCVIOMMUState *s)
                 }
             }
 
-            riscv_iommu_iot_inval(s, func, gscid, pscid, iova, transtag);
+            if (av && pscv) {
+                riscv_iommu_iot_inval_page(s, gv ? gscid : 0, pscid, iova,
+                                           transtag);
+            } else {
+                riscv_iommu_iot_inval(s, &batch, func, gscid, pscid, iova,
+                                      transtag);
+            }
             break;
         }
 
@@ -1806,14 +1992,32 @@ static void riscv_iommu_process_cq_tail(RISCVIOMMUState *s)
         head = (head + 1) & s->cq_mask;
         riscv_iommu_reg_set32(s, RISCV_IOMMU_REG_CQH, head);
     }
+    riscv_iommu_iot_inval_flush(s, &batch);
     return;
 
 fault:
+    riscv_iommu_iot_inval_flush(s, &batch);
     if (ctrl & RISCV_IOMMU_CQCSR_CIE) {
         riscv_iommu_notify(s, RISCV_IOMMU_INTR_CQ);
     }
 }
 
+/*
+ * Commands are executed from the main loop rather than from the MMIO write
+ * of the tail register, so that a vCPU posting a long run of commands is
+ * not stalled until all of them completed. Completion is observable by
+ * software through CQH and IOFENCE.C only.
+ */
+static void riscv_iommu_cq_bh(void *opaque)
+{
+    riscv_iommu_process_cq_tail(opaque);
+}
+
+static void riscv_iommu_kick_cq(RISCVIOMMUState *s)
+{
+    qemu_bh_schedule(s->cq_bh);
+}
+
 static void riscv_iommu_process_cq_control(RISCVIOMMUState *s)
 {
     uint64_t base;
@@ -2091,7 +2295,7 @@ static MemTxResult riscv_iommu_mmio_write(void *opaque, hwaddr addr,
         break;
 
     case RISCV_IOMMU_REG_CQT:
-        process_fn = riscv_iommu_process_cq_tail;
+        process_fn = riscv_iommu_kick_cq;
         break;
 
     case RISCV_IOMMU_REG_CQCSR:
@@ -2390,7 +2594,8 @@ static void riscv_iommu_realize(DeviceState *dev, Error **errp)
     stq_le_p(&s->regs_ro[RISCV_IOMMU_REG_PQB],
         ~(RISCV_IOMMU_PQB_LOG2SZ | RISCV_IOMMU_PQB_PPN));
     stl_le_p(&s->regs_wc[RISCV_IOMMU_REG_CQCSR], RISCV_IOMMU_CQCSR_CQMF |
-        RISCV_IOMMU_CQCSR_CMD_TO | RISCV_IOMMU_CQCSR_CMD_ILL);
+        RISCV_IOMMU_CQCSR_CMD_TO | RISCV_IOMMU_CQCSR_CMD_ILL |
+        RISCV_IOMMU_CQCSR_FENCE_W_IP);
     stl_le_p(&s->regs_ro[RISCV_IOMMU_REG_CQCSR], RISCV_IOMMU_CQCSR_CQON |
         RISCV_IOMMU_CQCSR_BUSY);
     stl_le_p(&s->regs_wc[RISCV_IOMMU_REG_FQCSR], RISCV_IOMMU_FQCSR_FQMF |
@@ -2443,12 +2648,16 @@ static void riscv_iommu_realize(DeviceState *dev, Error **errp)
             timer_new_ns(QEMU_CLOCK_VIRTUAL, riscv_iommu_hpm_timer_cb, s);
         s->hpm_event_ctr_map = g_hash_table_new(g_direct_hash, g_direct_equal);
     }
+
+    s->cq_bh = qemu_bh_new_guarded(riscv_iommu_cq_bh, s,
+                                   &dev->mem_reentrancy_guard);
 }
 
 static void riscv_iommu_unrealize(DeviceState *dev)
 {
     RISCVIOMMUState *s = RISCV_IOMMU(dev);
 
+    qemu_bh_delete(s->cq_bh);
     g_hash_table_unref(s->iot_cache);
     g_hash_table_unref(s->ctx_cache);
 
@@ -2491,6 +2700,7 @@ void riscv_iommu_reset(RISCVIOMMUState *s)
 
     g_hash_table_remove_all(s->ctx_cache);
     g_hash_table_remove_all(s->iot_cache);
+    s->iot_levels = 0;
 }
 
 static const Property riscv_iommu_properties[] = {
@@ -72,6 +72,10 @@ struct RISCVIOMMUState {
 
     GHashTable *iot_cache;          /* IO Translated Address Cache */
     unsigned iot_limit;             /* IO Translation Cache size limit */
+    unsigned iot_levels;            /* Page sizes present in iot_cache */
+
+    /* Command queue processing */
+    QEMUBH *cq_bh;
 
     /* MMIO Hardware Interface */
     MemoryRegion regs_mr;
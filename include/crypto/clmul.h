@@ -80,4 +80,31 @@ static inline Int128 clmul_64(uint64_t a, uint64_t b)
     }
 }
 
+/**
+ * clmul_64_vec:
+ * @lo: output for the low halves of the products, or NULL
+ * @hi: output for the high halves of the products, or NULL
+ * @a: first operands
+ * @b: second operands
+ * @b_stride: 1 to multiply @a[i] by @b[i], 0 to multiply all by @b[0]
+ * @n: number of elements
+ *
+ * Perform @n 64x64->128 carry-less multiplies, several at a time where
+ * the host allows. The outputs may be the same arrays as the inputs.
+ */
+void clmul_64_vec(uint64_t *lo, uint64_t *hi, const uint64_t *a,
+                  const uint64_t *b, size_t b_stride, size_t n);
+
+/**
+ * clmul_gf128_mul:
+ * @z: output, two 64-bit words
+ * @x: first operand, two 64-bit words
+ * @y: second operand, two 64-bit words
+ *
+ * Multiply in GF(2^128) modulo x^128 + x^7 + x^2 + x + 1, where bit i
+ * of the operands (word i / 64, bit i % 64) is the coefficient of x^i.
+ * @z may be the same array as @x or @y.
+ */
+void clmul_gf128_mul(uint64_t *z, const uint64_t *x, const uint64_t *y);
+
 #endif /* CRYPTO_CLMUL_H */
@@ -0,0 +1,70 @@
+/*
+ * SHA-256 round fragments, generic version
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef CRYPTO_SHA2_ROUND_H
+#define CRYPTO_SHA2_ROUND_H
+
+/*
+ * All operands are arrays of four host-order 32-bit words, laid out as
+ * for the x86 SHA extensions. The working variables are split into
+ * ABEF = { F, E, B, A } and CDGH = { H, G, D, C }; message words are in
+ * ascending order, W[i] in element 0. @ret may alias any operand.
+ */
+
+#include "host/crypto/sha2-round.h"
+
+/*
+ * Perform two rounds, with @wk holding W[i] + K[i] for each of them.
+ * Returns the new ABEF; the new CDGH is the old ABEF.
+ */
+
+void sha256_rnds2_gen(uint32_t *ret, const uint32_t *cdgh,
+                      const uint32_t *abef, const uint32_t *wk);
+
+static inline void sha256_rnds2(uint32_t *ret, const uint32_t *cdgh,
+                                const uint32_t *abef, const uint32_t *wk)
+{
+    if (HAVE_SHA256_ACCEL) {
+        sha256_rnds2_accel(ret, cdgh, abef, wk);
+    } else {
+        sha256_rnds2_gen(ret, cdgh, abef, wk);
+    }
+}
+
+/*
+ * First half of the message schedule: W[i] + sigma0(W[i + 1]) for
+ * @w0 = W[0..3] and @w4 = W[4..7], of which only W[4] is used.
+ */
+
+void sha256_msg1_gen(uint32_t *ret, const uint32_t *w0, const uint32_t *w4);
+
+static inline void sha256_msg1(uint32_t *ret, const uint32_t *w0,
+                               const uint32_t *w4)
+{
+    if (HAVE_SHA256_ACCEL) {
+        sha256_msg1_accel(ret, w0, w4);
+    } else {
+        sha256_msg1_gen(ret, w0, w4);
+    }
+}
+
+/*
+ * Second half of the message schedule: computes W[16..19] from @x, the
+ * partial sums W[i] + sigma0(W[i + 1]) + W[i + 9], and @w12 = W[12..15].
+ */
+
+void sha256_msg2_gen(uint32_t *ret, const uint32_t *x, const uint32_t *w12);
+
+static inline void sha256_msg2(uint32_t *ret, const uint32_t *x,
+                               const uint32_t *w12)
+{
+    if (HAVE_SHA256_ACCEL) {
+        sha256_msg2_accel(ret, x, w12);
+    } else {
+        sha256_msg2_gen(ret, x, w12);
+    }
+}
+
+#endif /* CRYPTO_SHA2_ROUND_H */
@@ -12,4 +12,40 @@ static inline uint32_t sm4_subword(uint32_t word)
            sm4_sbox[(word >> 24) & 0xff] << 24;
 }
 
+#include "host/crypto/sm4-round.h"
+
+/*
+ * Four rounds of SM4 on @x = X[0..3], element 0 being the oldest word,
+ * with round keys @rk. Returns X[4..7]; @ret may alias the operands.
+ */
+
+void sm4_rnds4_gen(uint32_t *ret, const uint32_t *x, const uint32_t *rk);
+
+static inline void sm4_rnds4(uint32_t *ret, const uint32_t *x,
+                             const uint32_t *rk)
+{
+    if (HAVE_SM4_ACCEL) {
+        sm4_rnds4_accel(ret, x, rk);
+    } else {
+        sm4_rnds4_gen(ret, x, rk);
+    }
+}
+
+/*
+ * Four steps of the SM4 key expansion on @k = K[0..3] with the
+ * constants @ck. Returns K[4..7]; @ret may alias the operands.
+ */
+
+void sm4_ekey4_gen(uint32_t *ret, const uint32_t *k, const uint32_t *ck);
+
+static inline void sm4_ekey4(uint32_t *ret, const uint32_t *k,
+                             const uint32_t *ck)
+{
+    if (HAVE_SM4_ACCEL) {
+        sm4_ekey4_accel(ret, k, ck);
+    } else {
+        sm4_ekey4_gen(ret, k, ck);
+    }
+}
+
 #endif
@@ -29,6 +29,10 @@
 
 #define XTS_BLOCK_SIZE 16
 
+/*
+ * The cipher functions work in ECB mode: @length is a multiple of
+ * XTS_BLOCK_SIZE and may cover several blocks, @dst and @src may alias.
+ */
 typedef void xts_cipher_func(const void *ctx,
                              size_t length,
                              uint8_t *dst,
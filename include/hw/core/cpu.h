@@ -358,6 +358,7 @@ typedef union IcountDecr {
  * @plugin_mem_cbs: active plugin memory callbacks
  * @plugin_mem_value_low: 64 lower bits of latest accessed mem value.
  * @plugin_mem_value_high: 64 higher bits of latest accessed mem value.
+ * @plugin_slabs: scoreboard storage of this vCPU.
  */
 typedef struct CPUNegativeOffsetState {
     CPUTLB tlb;
@@ -369,6 +370,7 @@ typedef struct CPUNegativeOffsetState {
     uint64_t plugin_mem_value_low;
     uint64_t plugin_mem_value_high;
     int32_t plugin_cb_flags;
+    struct qemu_plugin_slabs *plugin_slabs;
 #endif
     IcountDecr icount_decr;
     bool can_do_io;
@@ -438,6 +440,8 @@ struct qemu_work_item;
  * @gdb_regs: Additional GDB registers.
  * @gdb_num_regs: Number of total registers accessible to GDB.
  * @gdb_num_g_regs: Number of registers in GDB 'g' packets.
+ * @gdb_state_gen: Bumped when reset or loadvm replace the register state
+ *    while the CPU is stopped, so that the gdbstub drops cached values.
  * @node: QTAILQ of CPUs sharing TB cache.
  * @opaque: User data.
  * @mem_io_pc: Host Program Counter at which the memory was accessed.
@@ -454,6 +458,8 @@ struct qemu_work_item;
  *    ring is enabled.
  * @kvm_fetch_index: Keeps the index that we last fetched from the per-vCPU
  *    dirty ring structure.
+ * @dirty_ring_full_exits: Number of times this vCPU exited to userspace
+ *    because its KVM dirty ring was full.
  *
  * @neg_align: The CPUState is the common part of a concrete ArchCPU
  * which is allocated when an individual CPU instance is created. As
@@ -516,6 +522,7 @@ struct CPUState {
     GArray *gdb_regs;
     int gdb_num_regs;
     int gdb_num_g_regs;
+    uint32_t gdb_state_gen;
     QTAILQ_ENTRY(CPUState) node;
 
     /* ice debug support */
@@ -538,6 +545,7 @@ struct CPUState {
     struct kvm_dirty_gfn *kvm_dirty_gfns;
     uint32_t kvm_fetch_index;
     uint64_t dirty_pages;
+    uint64_t dirty_ring_full_exits;
     int kvm_vcpu_stats_fd;
 
     /* Use by accel-block: CPU is executing an ioctl() */
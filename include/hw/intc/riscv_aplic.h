@@ -53,6 +53,8 @@ struct RISCVAPLICState {
     uint32_t *idelivery;
     uint32_t *iforce;
     uint32_t *ithreshold;
+    /* sources with both pending and enabled set, derived from state */
+    unsigned long *enpend;
 
     /* topology */
 #define QEMU_APLIC_MAX_CHILDREN        16
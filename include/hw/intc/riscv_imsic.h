@@ -54,6 +54,11 @@ struct RISCVIMSICState {
     uint32_t *eidelivery;
     uint32_t *eithreshold;
     uint32_t *eistate;
+    /*
+     * Hint of the eistate entries that may be pending and enabled. Bits
+     * are set after eistate changes and only cleared by the topei scan.
+     */
+    unsigned long *eienpend;
 
     /* config */
     bool mmode;
@@ -58,6 +58,11 @@ struct SiFivePLICState {
     uint32_t *pending;
     uint32_t *claimed;
     uint32_t *enable;
+    /*
+     * Per context cache of the highest priority pending, enabled and
+     * unclaimed source, or PLIC_BEST_STALE when it must be recomputed.
+     */
+    uint32_t *best_irq;
 
     /* config */
     char *hart_config;
@@ -0,0 +1,40 @@
+/*
+ * Framebuffer comparison and pixel format conversion helpers
+ *
+ * Copyright (c) 2025 The QEMU Project Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef QEMU_PIXEL_OPS_H
+#define QEMU_PIXEL_OPS_H
+
+/**
+ * buffer_find_diff:
+ * @a: first buffer
+ * @b: second buffer
+ * @len: number of bytes to compare
+ *
+ * Returns: the offset of the first byte that differs between @a and @b,
+ * or @len if the buffers are equal.
+ */
+size_t buffer_find_diff(const void *a, const void *b, size_t len);
+
+/*
+ * Conversions between host endian pixels.  x8r8g8b8 pixels are stored
+ * in uint32_t, r5g6b5 pixels in uint16_t.  The x8 byte of the results
+ * is always zero, and the 5 and 6 bit channels are widened by bit
+ * replication, as pixman does.
+ */
+
+/* x8r8g8b8 to r5g6b5 */
+void pixel_rgb888_to_rgb565(uint16_t *dst, const uint32_t *src, size_t n);
+/* r5g6b5 to x8r8g8b8 */
+void pixel_rgb565_to_rgb888(uint32_t *dst, const uint16_t *src, size_t n);
+/* x8r8g8b8 to x8b8g8r8 and back */
+void pixel_swap_rb(uint32_t *dst, const uint32_t *src, size_t n);
+
+/* Switch to the next slower implementation, for benchmarks and tests */
+bool test_pixel_ops_next_accel(void);
+
+#endif /* QEMU_PIXEL_OPS_H */
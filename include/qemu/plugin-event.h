@@ -20,6 +20,8 @@ enum qemu_plugin_event {
     QEMU_PLUGIN_EV_VCPU_SYSCALL_RET,
     QEMU_PLUGIN_EV_FLUSH,
     QEMU_PLUGIN_EV_ATEXIT,
+    QEMU_PLUGIN_EV_VCPU_SAMPLE,
+    QEMU_PLUGIN_EV_VCPU_TB_HOT,
     QEMU_PLUGIN_EV_MAX, /* total number of plugin events we support */
 };
 
@@ -63,6 +63,8 @@ union qemu_plugin_cb_sig {
     qemu_plugin_vcpu_mem_cb_t        vcpu_mem;
     qemu_plugin_vcpu_syscall_cb_t    vcpu_syscall;
     qemu_plugin_vcpu_syscall_ret_cb_t vcpu_syscall_ret;
+    qemu_plugin_vcpu_sample_cb_t     vcpu_sample;
+    qemu_plugin_vcpu_tb_hot_cb_t     vcpu_tb_hot;
     void *generic;
 };
 
@@ -122,12 +124,37 @@ struct qemu_plugin_insn {
     bool mem_helper;
 };
 
-/* A scoreboard is an array of values, indexed by vcpu_index */
+/*
+ * Scoreboard storage
+ *
+ * Each vCPU owns a private copy of the scoreboard space, made of slabs
+ * of QEMU_PLUGIN_SLAB_SIZE bytes allocated on demand. A scoreboard is
+ * an offset in that space, so the entries of different vCPUs never
+ * share a cache line and never move once allocated: new vCPUs and new
+ * scoreboards only ever add slabs, without stopping the other vCPUs.
+ */
+#define QEMU_PLUGIN_SLAB_BITS 16
+#define QEMU_PLUGIN_SLAB_SIZE (1 << QEMU_PLUGIN_SLAB_BITS)
+#define QEMU_PLUGIN_SLAB_MAX  256
+
+struct qemu_plugin_slabs {
+    char *slab[QEMU_PLUGIN_SLAB_MAX];
+};
+
+/* A scoreboard is one entry of @element_size bytes per vCPU */
 struct qemu_plugin_scoreboard {
-    GArray *data;
-    QLIST_ENTRY(qemu_plugin_scoreboard) entry;
+    size_t element_size;
+    /* offset of the entry in the per-vCPU scoreboard space */
+    size_t offset;
 };
 
+static inline void *
+qemu_plugin_slabs_ptr(struct qemu_plugin_slabs *slabs, size_t offset)
+{
+    return slabs->slab[offset >> QEMU_PLUGIN_SLAB_BITS] +
+           (offset & (QEMU_PLUGIN_SLAB_SIZE - 1));
+}
+
 /* Internal context for this TranslationBlock */
 struct qemu_plugin_tb {
     GPtrArray *insns;
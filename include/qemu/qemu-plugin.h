@@ -72,11 +72,19 @@ typedef uint64_t qemu_plugin_id_t;
  * - added qemu_plugin_write_memory_hwaddr
  * - added qemu_plugin_write_register
  * - added qemu_plugin_translate_vaddr
+ *
+ * version 6:
+ * - added qemu_plugin_register_vcpu_sample_cb
+ * - added qemu_plugin_register_vcpu_tb_hot_cb
+ * - added qemu_plugin_tb_exec_count
+ * - added qemu_plugin_retranslate_range
+ * - added qemu_plugin_u64_min, qemu_plugin_u64_max
+ *   and qemu_plugin_u64_array_sum
  */
 
 extern QEMU_PLUGIN_EXPORT int qemu_plugin_version;
 
-#define QEMU_PLUGIN_VERSION 5
+#define QEMU_PLUGIN_VERSION 6
 
 /**
  * struct qemu_info_t - system information for plugins
@@ -751,6 +759,121 @@ void
 qemu_plugin_register_vcpu_syscall_ret_cb(qemu_plugin_id_t id,
                                          qemu_plugin_vcpu_syscall_ret_cb_t cb);
 
+/**
+ * typedef qemu_plugin_vcpu_sample_cb_t - sampling callback
+ * @vcpu_index: the executing vCPU
+ * @pc: virtual address of the block about to be executed
+ * @userdata: any user data attached to the callback
+ */
+typedef void (*qemu_plugin_vcpu_sample_cb_t)(unsigned int vcpu_index,
+                                             uint64_t pc,
+                                             void *userdata);
+
+/**
+ * qemu_plugin_register_vcpu_sample_cb() - register a sampling callback
+ * @id: plugin ID
+ * @cb: callback function, NULL to stop sampling
+ * @flags: does the plugin read or write the CPU's registers?
+ * @period: mean number of guest instructions between two samples
+ * @userdata: any plugin data to pass to the @cb?
+ *
+ * The @cb function is called on each vCPU roughly every @period
+ * executed instructions, without the plugin having to instrument any
+ * block itself. Instructions are accounted for at block entry, so the
+ * sample is taken on the block that crosses the threshold and @pc is
+ * the address of its first instruction. The distance between two
+ * samples is randomised over [@period / 2, 3 * @period / 2] to avoid
+ * aliasing with periodic guest behaviour.
+ *
+ * Sampling only costs an inline add and compare per executed block
+ * while enabled and nothing when no plugin requested it. It should be
+ * enabled from qemu_plugin_install(): blocks translated before the
+ * registration are not sampled until they are retranslated.
+ */
+QEMU_PLUGIN_API
+void qemu_plugin_register_vcpu_sample_cb(qemu_plugin_id_t id,
+                                         qemu_plugin_vcpu_sample_cb_t cb,
+                                         enum qemu_plugin_cb_flags flags,
+                                         uint64_t period,
+                                         void *userdata);
+
+
+/**
+ * typedef qemu_plugin_vcpu_tb_hot_cb_t - hot block callback
+ * @vcpu_index: the executing vCPU
+ * @vaddr: virtual address of the block that became hot
+ * @userdata: any user data attached to the callback
+ */
+typedef void (*qemu_plugin_vcpu_tb_hot_cb_t)(unsigned int vcpu_index,
+                                             uint64_t vaddr,
+                                             void *userdata);
+
+/**
+ * qemu_plugin_register_vcpu_tb_hot_cb() - track block execution counts
+ * @id: plugin ID
+ * @cb: callback function, NULL to stop tracking
+ * @threshold: executions on one vCPU after which @cb is called, or 0
+ * @userdata: any plugin data to pass to the @cb?
+ *
+ * Ask the core to count how many times each block is executed. The
+ * counts are kept per vCPU with an inline add at block entry and are
+ * keyed by the virtual address of the block, so they survive
+ * retranslation. They can be read back with qemu_plugin_tb_exec_count().
+ *
+ * If @threshold is not 0, @cb is called the first time a block has
+ * been executed @threshold times on a given vCPU.
+ *
+ * Counters are limited to 131072 distinct block addresses; blocks
+ * first translated after that are not counted.
+ */
+QEMU_PLUGIN_API
+void qemu_plugin_register_vcpu_tb_hot_cb(qemu_plugin_id_t id,
+                                         qemu_plugin_vcpu_tb_hot_cb_t cb,
+                                         uint64_t threshold,
+                                         void *userdata);
+
+/**
+ * qemu_plugin_tb_exec_count() - number of executions of a block
+ * @vaddr: virtual address of the start of the block
+ *
+ * Returns the number of times the block starting at @vaddr was executed
+ * on all vCPUs since block counting was enabled with
+ * qemu_plugin_register_vcpu_tb_hot_cb(), or 0 if it was never seen.
+ */
+QEMU_PLUGIN_API
+uint64_t qemu_plugin_tb_exec_count(uint64_t vaddr);
+
+/**
+ * enum qemu_plugin_tb_hint - translation hints
+ *
+ * @QEMU_PLUGIN_TB_HINT_NONE: translate as usual
+ * @QEMU_PLUGIN_TB_HINT_NO_INSTRUMENT: do not call this plugin's translation
+ * callback for blocks starting in the range
+ */
+enum qemu_plugin_tb_hint {
+    QEMU_PLUGIN_TB_HINT_NONE = 0,
+    QEMU_PLUGIN_TB_HINT_NO_INSTRUMENT = 1 << 0,
+};
+
+/**
+ * qemu_plugin_retranslate_range() - retranslate code with new hints
+ * @id: plugin ID
+ * @vaddr: virtual address of the start of the range
+ * @size: size of the range in bytes
+ * @hints: new hints for blocks starting in the range
+ *
+ * Record @hints for the given range, replacing any hints this plugin
+ * previously set on it, and drop the translated code so that blocks
+ * are retranslated with them. This typically lets a plugin stop
+ * instrumenting hot code once it has seen enough of it.
+ *
+ * The code cache is flushed asynchronously, blocks already executing
+ * carry on with their current instrumentation until they exit.
+ */
+QEMU_PLUGIN_API
+void qemu_plugin_retranslate_range(qemu_plugin_id_t id,
+                                   uint64_t vaddr, uint64_t size,
+                                   enum qemu_plugin_tb_hint hints);
 
 /**
  * qemu_plugin_insn_disas() - return disassembly string for instruction
@@ -1102,8 +1225,9 @@ void qemu_plugin_scoreboard_free(struct qemu_plugin_scoreboard *score);
  * @score: scoreboard to query
  * @vcpu_index: entry index
  *
- * Returns address of entry of a scoreboard matching a given vcpu_index. This
- * address can be modified later if scoreboard is resized.
+ * Returns address of entry of a scoreboard matching a given vcpu_index. The
+ * entries of a vcpu are never moved, so the address remains valid until the
+ * scoreboard is freed.
  */
 QEMU_PLUGIN_API
 void *qemu_plugin_scoreboard_find(struct qemu_plugin_scoreboard *score,
@@ -1150,4 +1274,34 @@ void qemu_plugin_u64_set(qemu_plugin_u64 entry, unsigned int vcpu_index,
 QEMU_PLUGIN_API
 uint64_t qemu_plugin_u64_sum(qemu_plugin_u64 entry);
 
+/**
+ * qemu_plugin_u64_min() - return minimum of all vcpu entries in a scoreboard
+ * @entry: entry to reduce
+ *
+ * Returns 0 if no vCPU was started yet.
+ */
+QEMU_PLUGIN_API
+uint64_t qemu_plugin_u64_min(qemu_plugin_u64 entry);
+
+/**
+ * qemu_plugin_u64_max() - return maximum of all vcpu entries in a scoreboard
+ * @entry: entry to reduce
+ */
+QEMU_PLUGIN_API
+uint64_t qemu_plugin_u64_max(qemu_plugin_u64 entry);
+
+/**
+ * qemu_plugin_u64_array_sum() - merge an array of counters of all vcpus
+ * @entry: first uint64_t of the array in the scoreboard entry
+ * @sums: array of @n_elems uint64_t receiving the result
+ * @n_elems: number of elements in the array
+ *
+ * Sum each of the @n_elems uint64_t starting at @entry over all vcpus,
+ * typically to merge per-vcpu histograms. The array must fit in the
+ * scoreboard entry.
+ */
+QEMU_PLUGIN_API
+void qemu_plugin_u64_array_sum(qemu_plugin_u64 entry, uint64_t *sums,
+                               size_t n_elems);
+
 #endif /* QEMU_QEMU_PLUGIN_H */
@@ -27,8 +27,8 @@ typedef struct JSONMessageParser {
     JSONLexer lexer;
     int brace_count;
     int bracket_count;
-    GQueue tokens;
-    uint64_t token_size;
+    GArray *tokens;
+    GString *token_text;
 } JSONMessageParser;
 
 void json_message_parser_init(JSONMessageParser *parser,
@@ -100,6 +100,10 @@ struct KVMDirtyRingReaper {
     QemuThread reaper_thr;
     volatile uint64_t reaper_iteration; /* iteration number of reaper thr */
     volatile enum KVMDirtyRingReaperState reaper_state; /* reap thr state */
+    /* Workers reaping the rings in parallel, NULL if there are few vCPUs */
+    struct ThreadPool *pool;
+    uint32_t reap_max;      /* most entries reaped from one ring */
+    uint32_t full_exits;    /* dirty ring full exits since last reaper pass */
 };
 struct KVMState
 {
@@ -112,6 +116,9 @@ struct KVMState
     int coalesced_pio;
     struct kvm_coalesced_mmio_ring *coalesced_mmio_ring;
     bool coalesced_flush_in_progress;
+    /* Period of the coalesced MMIO ring poll in us, 0 if disabled */
+    uint32_t coalesced_poll_us;
+    QEMUTimer *coalesced_poll_timer;
     int vcpu_events;
 #ifdef TARGET_KVM_HAVE_GUEST_DEBUG
     QTAILQ_HEAD(, kvm_sw_breakpoint) kvm_sw_breakpoints;
@@ -46,6 +46,8 @@ typedef struct ReplayNetState ReplayNetState;
 
 /* Name of the initial VM snapshot */
 extern char *replay_snapshot;
+/* Instructions between the automatic snapshots in replay mode, 0 if none */
+extern uint64_t replay_snapshot_period;
 
 /* Replay locking
  *
@@ -32,6 +32,19 @@ int page_get_flags(vaddr address);
  */
 void page_set_flags(vaddr start, vaddr last, int flags);
 
+/**
+ * page_set_flags_is_nop:
+ * @start: first byte of range
+ * @last: last byte of range
+ * @flags: flags that would be passed to page_set_flags(), without PAGE_RESET
+ *
+ * Return true if every page in [@start, @last] already has the flags
+ * page_set_flags() would leave it with, so that neither the flags nor
+ * the host protection need to change.  The lookup does not take the
+ * mmap lock and may return false for a range that is up to date.
+ */
+bool page_set_flags_is_nop(vaddr start, vaddr last, int flags);
+
 void page_reset_target_data(vaddr start, vaddr last);
 
 /**
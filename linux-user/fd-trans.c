@@ -335,6 +335,7 @@ enum {
 TargetFdTrans **target_fd_trans;
 QemuMutex target_fd_trans_lock;
 unsigned int target_fd_max;
+unsigned int target_fd_trans_count;
 
 static void tswap_nlmsghdr(struct nlmsghdr *nlh)
 {
@@ -30,6 +30,12 @@ extern TargetFdTrans **target_fd_trans;
 extern QemuMutex target_fd_trans_lock;
 
 extern unsigned int target_fd_max;
+/*
+ * Number of file descriptors with a translator, updated under
+ * target_fd_trans_lock. Most programs never register one, so lookups
+ * check it first and skip the lock on the common I/O path.
+ */
+extern unsigned int target_fd_trans_count;
 
 static inline void fd_trans_init(void)
 {
@@ -48,7 +54,7 @@ static inline void fd_trans_postfork(void)
 
 static inline TargetFdDataFunc fd_trans_target_to_host_data(int fd)
 {
-    if (fd < 0) {
+    if (fd < 0 || !qatomic_read(&target_fd_trans_count)) {
         return NULL;
     }
 
@@ -61,7 +67,7 @@ static inline TargetFdDataFunc fd_trans_target_to_host_data(int fd)
 
 static inline TargetFdDataFunc fd_trans_host_to_target_data(int fd)
 {
-    if (fd < 0) {
+    if (fd < 0 || !qatomic_read(&target_fd_trans_count)) {
         return NULL;
     }
 
@@ -74,7 +80,7 @@ static inline TargetFdDataFunc fd_trans_host_to_target_data(int fd)
 
 static inline TargetFdAddrFunc fd_trans_target_to_host_addr(int fd)
 {
-    if (fd < 0) {
+    if (fd < 0 || !qatomic_read(&target_fd_trans_count)) {
         return NULL;
     }
 
@@ -98,6 +104,9 @@ static inline void internal_fd_trans_register_unsafe(int fd,
         memset((void *)(target_fd_trans + oldmax), 0,
                (target_fd_max - oldmax) * sizeof(TargetFdTrans *));
     }
+    if (!target_fd_trans[fd]) {
+        qatomic_set(&target_fd_trans_count, target_fd_trans_count + 1);
+    }
     target_fd_trans[fd] = trans;
 }
 
@@ -109,8 +118,9 @@ static inline void fd_trans_register(int fd, TargetFdTrans *trans)
 
 static inline void internal_fd_trans_unregister_unsafe(int fd)
 {
-    if (fd >= 0 && fd < target_fd_max) {
+    if (fd >= 0 && fd < target_fd_max && target_fd_trans[fd]) {
         target_fd_trans[fd] = NULL;
+        qatomic_set(&target_fd_trans_count, target_fd_trans_count - 1);
     }
 }
 
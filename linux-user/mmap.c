@@ -195,6 +195,16 @@ int target_mprotect(abi_ulong start, abi_ulong len, int target_prot)
     }
 
     last = start + len - 1;
+
+    /*
+     * Allocators and garbage collectors often re-apply the protection a
+     * range already has.  Answer those without the mmap lock and without
+     * a host syscall.
+     */
+    if (page_set_flags_is_nop(start, last, page_flags)) {
+        return 0;
+    }
+
     host_start = start & -host_page_size;
     host_last = ROUND_UP(last, host_page_size) - 1;
     nranges = 0;
@@ -593,12 +603,10 @@ static abi_long mmap_end(abi_ulong start, abi_ulong last,
  * Special case host page size == target page size,
  * where there are no edge conditions.
  */
-static abi_long mmap_h_eq_g(abi_ulong start, abi_ulong len,
-                            int host_prot, int flags, int page_flags,
-                            int fd, off_t offset)
+static void *mmap_h_eq_g_host(abi_ulong start, abi_ulong len,
+                              int host_prot, int flags, int fd, off_t offset)
 {
     void *p, *want_p = NULL;
-    abi_ulong last;
 
     if (start || (flags & (MAP_FIXED | MAP_FIXED_NOREPLACE))) {
         want_p = g2h_untagged(start);
@@ -606,12 +614,25 @@ static abi_long mmap_h_eq_g(abi_ulong start, abi_ulong len,
 
     p = mmap(want_p, len, host_prot, flags, fd, offset);
     if (p == MAP_FAILED) {
-        return -1;
+        return p;
     }
     /* If the host kernel does not support MAP_FIXED_NOREPLACE, emulate. */
     if ((flags & MAP_FIXED_NOREPLACE) && p != want_p) {
         do_munmap(p, len);
         errno = EEXIST;
+        return MAP_FAILED;
+    }
+    return p;
+}
+
+static abi_long mmap_h_eq_g(abi_ulong start, abi_ulong len,
+                            int host_prot, int flags, int page_flags,
+                            int fd, off_t offset)
+{
+    void *p = mmap_h_eq_g_host(start, len, host_prot, flags, fd, offset);
+    abi_ulong last;
+
+    if (p == MAP_FAILED) {
         return -1;
     }
 
@@ -993,12 +1014,32 @@ abi_long target_mmap(abi_ulong start, abi_ulong len, int target_prot,
         }
     }
 
-    mmap_lock();
-
-    ret = target_mmap__locked(start, len, target_prot, flags,
-                              page_flags, fd, offset);
+    if (!reserved_va && qemu_real_host_page_size() == TARGET_PAGE_SIZE &&
+        !(flags & (MAP_FIXED | MAP_FIXED_NOREPLACE))) {
+        /*
+         * The host picks the address and there are no partial host
+         * pages to fix up, so only recording the page flags needs the
+         * lock.  The new range cannot carry stale flags: every unmap
+         * drops them before or together with freeing the host range.
+         */
+        int host_prot = target_to_host_prot(target_prot);
+        void *p = mmap_h_eq_g_host(start, len, host_prot, flags, fd, offset);
 
-    mmap_unlock();
+        if (p == MAP_FAILED) {
+            ret = -1;
+        } else {
+            start = h2g(p);
+            mmap_lock();
+            ret = mmap_end(start, start + len - 1, start, start + len - 1,
+                           flags, page_flags);
+            mmap_unlock();
+        }
+    } else {
+        mmap_lock();
+        ret = target_mmap__locked(start, len, target_prot, flags,
+                                  page_flags, fd, offset);
+        mmap_unlock();
+    }
 
     /*
      * If we're mapping shared memory, ensure we generate code for parallel
@@ -1091,6 +1132,22 @@ int target_munmap(abi_ulong start, abi_ulong len)
         return -1;
     }
 
+    if (!reserved_va && qemu_real_host_page_size() == TARGET_PAGE_SIZE) {
+        /*
+         * Whole host pages are unmapped and nothing is reserved in their
+         * place, so the host munmap can run outside the lock.  Drop the
+         * flags first: once the range is free the host may hand it to a
+         * concurrent target_mmap, whose flags must not be cleared here.
+         * If munmap fails the pages stay mapped on the host but are gone
+         * for the guest, which only leaks them.
+         */
+        mmap_lock();
+        page_set_flags(start, start + len - 1, 0);
+        shm_region_rm_complete(start, start + len - 1);
+        mmap_unlock();
+        return munmap(g2h_untagged(start), len);
+    }
+
     mmap_lock();
     ret = mmap_reserve_or_unmap(start, len);
     if (likely(ret == 0)) {
@@ -1225,6 +1282,16 @@ abi_long target_madvise(abi_ulong start, abi_ulong len_in, int advice)
     /* we do not care about the other MADV_xxx values yet */
     }
 
+    switch (advice) {
+    case MADV_DONTNEED:
+    case MADV_WIPEONFORK:
+    case MADV_KEEPONFORK:
+        break;
+    default:
+        /* Pure hints are ignored, don't serialize them on the mmap lock. */
+        return 0;
+    }
+
     /*
      * Most advice values are hints, so ignoring and returning success is ok.
      *
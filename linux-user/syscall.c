@@ -3329,13 +3329,14 @@ static abi_long do_sendrecvmsg_locked(int fd, struct target_msghdr *msgp,
     msg.msg_iov = vec;
 
     if (send) {
-        if (fd_trans_target_to_host_data(fd)) {
+        TargetFdDataFunc trans = fd_trans_target_to_host_data(fd);
+
+        if (trans) {
             void *host_msg;
 
             host_msg = g_malloc(msg.msg_iov->iov_len);
             memcpy(host_msg, msg.msg_iov->iov_base, msg.msg_iov->iov_len);
-            ret = fd_trans_target_to_host_data(fd)(host_msg,
-                                                   msg.msg_iov->iov_len);
+            ret = trans(host_msg, msg.msg_iov->iov_len);
             if (ret >= 0) {
                 msg.msg_iov->iov_base = host_msg;
                 ret = get_errno(safe_sendmsg(fd, &msg, flags));
@@ -3348,12 +3349,15 @@ static abi_long do_sendrecvmsg_locked(int fd, struct target_msghdr *msgp,
             }
         }
     } else {
+        TargetFdDataFunc trans = fd_trans_host_to_target_data(fd);
+
+        /* the iovec points at guest memory, the host fills it in place */
         ret = get_errno(safe_recvmsg(fd, &msg, flags));
         if (!is_error(ret)) {
             len = ret;
-            if (fd_trans_host_to_target_data(fd)) {
-                ret = fd_trans_host_to_target_data(fd)(msg.msg_iov->iov_base,
-                                               MIN(msg.msg_iov->iov_len, len));
+            if (trans) {
+                ret = trans(msg.msg_iov->iov_base,
+                            MIN(msg.msg_iov->iov_len, len));
             }
             if (!is_error(ret)) {
                 ret = host_to_target_cmsg(msgp, &msg);
@@ -9284,12 +9288,17 @@ static abi_long do_syscall1(CPUArchState *cpu_env, int num, abi_long arg1,
         if (arg2 == 0 && arg3 == 0) {
             return get_errno(safe_read(arg1, 0, 0));
         } else {
+            TargetFdDataFunc trans = fd_trans_host_to_target_data(arg1);
+
+            /*
+             * Without CONFIG_DEBUG_REMAP lock_user() returns the guest
+             * buffer itself, so the host reads straight into it.
+             */
             if (!(p = lock_user(VERIFY_WRITE, arg2, arg3, 0)))
                 return -TARGET_EFAULT;
             ret = get_errno(safe_read(arg1, p, arg3));
-            if (ret >= 0 &&
-                fd_trans_host_to_target_data(arg1)) {
-                ret = fd_trans_host_to_target_data(arg1)(p, ret);
+            if (ret >= 0 && trans) {
+                ret = trans(p, ret);
             }
             unlock_user(p, arg2, ret);
         }
@@ -9300,16 +9309,20 @@ static abi_long do_syscall1(CPUArchState *cpu_env, int num, abi_long arg1,
         }
         if (!(p = lock_user(VERIFY_READ, arg2, arg3, 1)))
             return -TARGET_EFAULT;
-        if (fd_trans_target_to_host_data(arg1)) {
-            void *copy = g_malloc(arg3);
-            memcpy(copy, p, arg3);
-            ret = fd_trans_target_to_host_data(arg1)(copy, arg3);
-            if (ret >= 0) {
-                ret = get_errno(safe_write(arg1, copy, ret));
+        {
+            TargetFdDataFunc trans = fd_trans_target_to_host_data(arg1);
+
+            if (trans) {
+                void *copy = g_malloc(arg3);
+                memcpy(copy, p, arg3);
+                ret = trans(copy, arg3);
+                if (ret >= 0) {
+                    ret = get_errno(safe_write(arg1, copy, ret));
+                }
+                g_free(copy);
+            } else {
+                ret = get_errno(safe_write(arg1, p, arg3));
             }
-            g_free(copy);
-        } else {
-            ret = get_errno(safe_write(arg1, p, arg3));
         }
         unlock_user(p, arg2, 0);
         return ret;
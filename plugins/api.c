@@ -605,9 +605,7 @@ void *qemu_plugin_scoreboard_find(struct qemu_plugin_scoreboard *score,
                                   unsigned int vcpu_index)
 {
     g_assert(vcpu_index < qemu_plugin_num_vcpus());
-    /* we can't use g_array_index since entry size is not statically known */
-    char *base_ptr = score->data->data;
-    return base_ptr + vcpu_index * g_array_get_element_size(score->data);
+    return plugin_scoreboard_find(score, vcpu_index);
 }
 
 static uint64_t *plugin_u64_address(qemu_plugin_u64 entry,
@@ -644,3 +642,37 @@ uint64_t qemu_plugin_u64_sum(qemu_plugin_u64 entry)
     return total;
 }
 
+uint64_t qemu_plugin_u64_min(qemu_plugin_u64 entry)
+{
+    int n = qemu_plugin_num_vcpus();
+    uint64_t min = n ? UINT64_MAX : 0;
+    for (int i = 0; i < n; ++i) {
+        min = MIN(min, qemu_plugin_u64_get(entry, i));
+    }
+    return min;
+}
+
+uint64_t qemu_plugin_u64_max(qemu_plugin_u64 entry)
+{
+    uint64_t max = 0;
+    for (int i = 0, n = qemu_plugin_num_vcpus(); i < n; ++i) {
+        max = MAX(max, qemu_plugin_u64_get(entry, i));
+    }
+    return max;
+}
+
+void qemu_plugin_u64_array_sum(qemu_plugin_u64 entry, uint64_t *sums,
+                               size_t n_elems)
+{
+    g_assert(entry.offset + n_elems * sizeof(uint64_t) <=
+             entry.score->element_size);
+
+    memset(sums, 0, n_elems * sizeof(uint64_t));
+    for (int i = 0, n = qemu_plugin_num_vcpus(); i < n; ++i) {
+        const uint64_t *vals = plugin_u64_address(entry, i);
+        for (size_t j = 0; j < n_elems; j++) {
+            sums[j] += vals[j];
+        }
+    }
+}
+
@@ -12,6 +12,7 @@
  * SPDX-License-Identifier: GPL-2.0-or-later
  */
 #include "qemu/osdep.h"
+#include "qemu/cacheinfo.h"
 #include "qemu/lockable.h"
 #include "qemu/option.h"
 #include "qemu/plugin.h"
@@ -205,52 +206,118 @@ CPUPluginState *qemu_plugin_create_vcpu_state(void)
     return g_new0(CPUPluginState, 1);
 }
 
-static void plugin_grow_scoreboards__locked(CPUState *cpu)
+/*
+ * Scoreboard space
+ *
+ * The space is handed out in uint64_t units from a bitmap. An entry
+ * never straddles two slabs, so generated code only needs to look up
+ * the slab of the executing vCPU and add a constant offset.
+ */
+#define PLUGIN_SLAB_UNITS (QEMU_PLUGIN_SLAB_SIZE / sizeof(uint64_t))
+#define PLUGIN_SLAB_MAP_SIZE (QEMU_PLUGIN_SLAB_MAX * PLUGIN_SLAB_UNITS)
+
+static char *plugin_slab_new(void)
 {
-    size_t scoreboard_size = plugin.scoreboard_alloc_size;
-    bool need_realloc = false;
+    char *slab = qemu_memalign(qemu_dcache_linesize, QEMU_PLUGIN_SLAB_SIZE);
 
-    if (cpu->cpu_index < scoreboard_size) {
-        return;
+    memset(slab, 0, QEMU_PLUGIN_SLAB_SIZE);
+    return slab;
+}
+
+static void plugin_vcpu_slabs_init__locked(CPUState *cpu)
+{
+    struct qemu_plugin_slab_table *old = plugin.slab_table;
+    struct qemu_plugin_slab_table *table = old;
+    unsigned int n = old ? old->n : 0;
+    struct qemu_plugin_slabs *slabs;
+    int idx;
+    size_t i;
+
+    if (cpu->cpu_index >= n) {
+        unsigned int new_n = MAX(n * 2, cpu->cpu_index + 1);
+
+        table = g_malloc0(sizeof(*table) + new_n * sizeof(table->vcpu[0]));
+        table->n = new_n;
+        if (old) {
+            memcpy(table->vcpu, old->vcpu, n * sizeof(old->vcpu[0]));
+        }
     }
 
-    while (cpu->cpu_index >= scoreboard_size) {
-        scoreboard_size *= 2;
-        need_realloc = true;
+    /*
+     * vCPUs can come up out of order, but readers iterate over every
+     * index below plugin.num_vcpus; give the lower indexes their slabs
+     * too so that they read as zero.  A vcpu_index can also be reused,
+     * in which case it keeps accumulating into its slabs.
+     */
+    for (idx = 0; idx <= cpu->cpu_index; idx++) {
+        if (!table->vcpu[idx]) {
+            slabs = g_new0(struct qemu_plugin_slabs, 1);
+            for (i = 0; i < plugin.nr_slabs; i++) {
+                slabs->slab[i] = plugin_slab_new();
+            }
+            qatomic_rcu_set(&table->vcpu[idx], slabs);
+        }
     }
+    slabs = table->vcpu[cpu->cpu_index];
 
-    if (!need_realloc) {
-        return;
+    if (table != old) {
+        qatomic_rcu_set(&plugin.slab_table, table);
+        if (old) {
+            g_free_rcu(old, rcu);
+        }
     }
+    cpu->neg.plugin_slabs = slabs;
+}
 
-    if (QLIST_EMPTY(&plugin.scoreboards)) {
-        /* just update size for future scoreboards */
-        plugin.scoreboard_alloc_size = scoreboard_size;
-        return;
+/* Returns the offset of the new entry, or -1 if the space is exhausted */
+static size_t plugin_slab_alloc__locked(size_t size)
+{
+    struct qemu_plugin_slab_table *table = plugin.slab_table;
+    unsigned long nr = DIV_ROUND_UP(size, sizeof(uint64_t));
+    unsigned long start = 0;
+    unsigned long idx, slab;
+    unsigned int i;
+
+    g_assert(size > 0 && size <= QEMU_PLUGIN_SLAB_SIZE);
+
+    if (!plugin.slab_map) {
+        plugin.slab_map = bitmap_new(PLUGIN_SLAB_MAP_SIZE);
     }
 
-    /*
-     * A scoreboard creation/deletion might be in progress. If a new vcpu is
-     * initialized at the same time, we are safe, as the new
-     * plugin.scoreboard_alloc_size was not yet written.
-     */
-    qemu_rec_mutex_unlock(&plugin.lock);
+    for (;;) {
+        idx = bitmap_find_next_zero_area(plugin.slab_map, PLUGIN_SLAB_MAP_SIZE,
+                                         start, nr, 0);
+        if (idx + nr > PLUGIN_SLAB_MAP_SIZE) {
+            return -1;
+        }
+        if (idx / PLUGIN_SLAB_UNITS == (idx + nr - 1) / PLUGIN_SLAB_UNITS) {
+            break;
+        }
+        start = QEMU_ALIGN_UP(idx + 1, PLUGIN_SLAB_UNITS);
+    }
+    bitmap_set(plugin.slab_map, idx, nr);
+
+    /* new slabs are published before any code can refer to them */
+    slab = idx / PLUGIN_SLAB_UNITS;
+    for (; plugin.nr_slabs <= slab; plugin.nr_slabs++) {
+        for (i = 0; table && i < table->n; i++) {
+            if (table->vcpu[i]) {
+                qatomic_rcu_set(&table->vcpu[i]->slab[plugin.nr_slabs],
+                                plugin_slab_new());
+            }
+        }
+    }
 
-    /* cpus must be stopped, as tb might still use an existing scoreboard. */
-    start_exclusive();
-    /* re-acquire lock */
-    qemu_rec_mutex_lock(&plugin.lock);
-    /* in case another vcpu is created between unlock and exclusive section. */
-    if (scoreboard_size > plugin.scoreboard_alloc_size) {
-        struct qemu_plugin_scoreboard *score;
-        QLIST_FOREACH(score, &plugin.scoreboards, entry) {
-            g_array_set_size(score->data, scoreboard_size);
+    /* space released by a previous scoreboard must read as zero again */
+    for (i = 0; table && i < table->n; i++) {
+        if (table->vcpu[i]) {
+            memset(qemu_plugin_slabs_ptr(table->vcpu[i],
+                                         idx * sizeof(uint64_t)),
+                   0, nr * sizeof(uint64_t));
         }
-        plugin.scoreboard_alloc_size = scoreboard_size;
-        /* force all tb to be flushed, as scoreboard pointers were changed. */
-        tb_flush(cpu);
     }
-    end_exclusive();
+
+    return idx * sizeof(uint64_t);
 }
 
 static void qemu_plugin_vcpu_init__async(CPUState *cpu, run_on_cpu_data unused)
@@ -259,12 +326,13 @@ static void qemu_plugin_vcpu_init__async(CPUState *cpu, run_on_cpu_data unused)
 
     assert(cpu->cpu_index != UNASSIGNED_CPU_INDEX);
     qemu_rec_mutex_lock(&plugin.lock);
+    /* scoreboard entries must exist before the vcpu is accounted for */
+    plugin_vcpu_slabs_init__locked(cpu);
     plugin.num_vcpus = MAX(plugin.num_vcpus, cpu->cpu_index + 1);
     plugin_cpu_update__locked(&cpu->cpu_index, NULL, NULL);
     success = g_hash_table_insert(plugin.cpu_ht, &cpu->cpu_index,
                                   &cpu->cpu_index);
     g_assert(success);
-    plugin_grow_scoreboards__locked(cpu);
     qemu_rec_mutex_unlock(&plugin.lock);
 
     qemu_plugin_set_cb_flags(cpu, QEMU_PLUGIN_CB_RW_REGS);
@@ -465,6 +533,367 @@ void plugin_register_vcpu_mem_cb(GArray **arr,
     dyn_cb->regular = regular_cb;
 }
 
+/*
+ * Sampling
+ *
+ * Each block entry adds the block's instruction count to a per-vCPU
+ * counter and a conditional callback fires once the counter crosses
+ * 3/2 of the period. The counter is then re-armed with a random value
+ * in [0, period] plus whatever the last block overshot, so the sampling
+ * interval is uniform over [period / 2, 3 * period / 2] with a mean of
+ * exactly one period.
+ */
+static uint64_t plugin_sample_threshold(uint64_t period)
+{
+    return period + period / 2;
+}
+
+/*
+ * Disable CFI checks.
+ * The callback function has been loaded from an external library so we do not
+ * have type information
+ */
+QEMU_DISABLE_CFI
+static void plugin_vcpu_sample__cb(unsigned int cpu_index, void *udata)
+{
+    struct qemu_plugin_ctx *ctx = udata;
+    struct qemu_plugin_sampler *s = &ctx->sampler;
+    qemu_plugin_u64 count = qemu_plugin_scoreboard_u64(s->count);
+    uint64_t period = qatomic_read(&s->period);
+    uint64_t threshold = plugin_sample_threshold(period);
+    uint64_t overshoot, jitter, pc;
+    struct qemu_plugin_cb *cb;
+
+    /*
+     * The block may have been translated with the threshold of a smaller
+     * period, in which case the counter can be below the current one.
+     */
+    overshoot = qemu_plugin_u64_get(count, cpu_index);
+    overshoot = overshoot > threshold ? overshoot - threshold : 0;
+    jitter = g_random_double() * period;
+    qemu_plugin_u64_set(count, cpu_index, jitter + overshoot);
+
+    /* the plugin may have stopped sampling after this block was translated */
+    cb = qatomic_read(&ctx->callbacks[QEMU_PLUGIN_EV_VCPU_SAMPLE]);
+    if (cb) {
+        pc = qemu_plugin_u64_get(qemu_plugin_scoreboard_u64(plugin.sample_pc),
+                                 cpu_index);
+        cb->f.vcpu_sample(cpu_index, pc, cb->udata);
+    }
+}
+
+static void plugin_tb_sample(struct qemu_plugin_tb *tb)
+{
+    enum qemu_plugin_event ev = QEMU_PLUGIN_EV_VCPU_SAMPLE;
+    struct qemu_plugin_cb *cb;
+
+    qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+        tb, QEMU_PLUGIN_INLINE_STORE_U64,
+        qemu_plugin_scoreboard_u64(plugin.sample_pc),
+        qemu_plugin_tb_vaddr(tb));
+
+    QLIST_FOREACH_RCU(cb, &plugin.cb_lists[ev], entry) {
+        struct qemu_plugin_sampler *s = &cb->ctx->sampler;
+        qemu_plugin_u64 count = qemu_plugin_scoreboard_u64(s->count);
+
+        qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+            tb, QEMU_PLUGIN_INLINE_ADD_U64, count, tb->n);
+        qemu_plugin_register_vcpu_tb_exec_cond_cb(
+            tb, plugin_vcpu_sample__cb, s->flags, QEMU_PLUGIN_COND_GE,
+            count, plugin_sample_threshold(qatomic_read(&s->period)),
+            cb->ctx);
+    }
+}
+
+void qemu_plugin_register_vcpu_sample_cb(qemu_plugin_id_t id,
+                                         qemu_plugin_vcpu_sample_cb_t cb,
+                                         enum qemu_plugin_cb_flags flags,
+                                         uint64_t period,
+                                         void *udata)
+{
+    struct qemu_plugin_ctx *ctx;
+
+    if (period == 0) {
+        cb = NULL;
+    }
+
+    WITH_QEMU_LOCK_GUARD(&plugin.lock) {
+        ctx = plugin_id_to_ctx_locked(id);
+        if (cb) {
+            if (!plugin.sample_pc) {
+                plugin.sample_pc = plugin_scoreboard_new(sizeof(uint64_t));
+            }
+            if (!ctx->sampler.count) {
+                ctx->sampler.count = plugin_scoreboard_new(sizeof(uint64_t));
+            }
+            ctx->sampler.flags = flags;
+            qatomic_set(&ctx->sampler.period, period);
+        }
+    }
+    plugin_register_cb_udata(id, QEMU_PLUGIN_EV_VCPU_SAMPLE, cb, udata);
+}
+
+/*
+ * Block hotness
+ *
+ * Execution counts are kept per block start address so that they carry
+ * over retranslations. Plugins asking for a hot callback share the
+ * counters; a single conditional callback is emitted per distinct
+ * threshold and dispatches to every plugin using it.
+ *
+ * The counters are handed out in order from scoreboards of one slab
+ * each, so that translating a block does not search the scoreboard
+ * space. Once PLUGIN_TB_HOT_MAX_CHUNKS are used up, or the space is
+ * exhausted, blocks seen for the first time are no longer counted.
+ */
+#define PLUGIN_TB_HOT_PER_CHUNK (QEMU_PLUGIN_SLAB_SIZE / sizeof(uint64_t))
+#define PLUGIN_TB_HOT_MAX_CHUNKS (QEMU_PLUGIN_SLAB_MAX / 16)
+
+/*
+ * Disable CFI checks.
+ * The callback function has been loaded from an external library so we do not
+ * have type information
+ */
+QEMU_DISABLE_CFI
+static void plugin_vcpu_tb_hot__cb(unsigned int cpu_index, void *udata)
+{
+    struct qemu_plugin_tb_hot *hot = udata;
+    enum qemu_plugin_event ev = QEMU_PLUGIN_EV_VCPU_TB_HOT;
+    struct qemu_plugin_cb *cb, *next;
+    uint64_t count;
+
+    count = qemu_plugin_u64_get(hot->count, cpu_index);
+    QLIST_FOREACH_SAFE_RCU(cb, &plugin.cb_lists[ev], entry, next) {
+        if (cb->ctx->tb_hot_threshold == count) {
+            cb->f.vcpu_tb_hot(cpu_index, hot->vaddr, cb->udata);
+        }
+    }
+}
+
+static bool plugin_tb_hot_threshold_seen(struct qemu_plugin_cb *cb)
+{
+    enum qemu_plugin_event ev = QEMU_PLUGIN_EV_VCPU_TB_HOT;
+    struct qemu_plugin_cb *prev;
+
+    QLIST_FOREACH_RCU(prev, &plugin.cb_lists[ev], entry) {
+        if (prev == cb) {
+            return false;
+        }
+        if (prev->ctx->tb_hot_threshold == cb->ctx->tb_hot_threshold) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool plugin_tb_hot_counter_new__locked(qemu_plugin_u64 *count)
+{
+    GPtrArray *chunks = plugin.tb_hot_chunks;
+
+    if (!chunks->len || plugin.tb_hot_used == PLUGIN_TB_HOT_PER_CHUNK) {
+        struct qemu_plugin_scoreboard *score;
+
+        if (chunks->len == PLUGIN_TB_HOT_MAX_CHUNKS) {
+            return false;
+        }
+        score = plugin_scoreboard_try_new(QEMU_PLUGIN_SLAB_SIZE);
+        if (!score) {
+            return false;
+        }
+        g_ptr_array_add(chunks, score);
+        plugin.tb_hot_used = 0;
+    }
+
+    count->score = g_ptr_array_index(chunks, chunks->len - 1);
+    count->offset = plugin.tb_hot_used++ * sizeof(uint64_t);
+    return true;
+}
+
+static void plugin_tb_hot(struct qemu_plugin_tb *tb)
+{
+    enum qemu_plugin_event ev = QEMU_PLUGIN_EV_VCPU_TB_HOT;
+    uint64_t vaddr = qemu_plugin_tb_vaddr(tb);
+    struct qemu_plugin_tb_hot *hot;
+    struct qemu_plugin_cb *cb;
+    qemu_plugin_u64 count;
+
+    WITH_QEMU_LOCK_GUARD(&plugin.lock) {
+        hot = g_hash_table_lookup(plugin.tb_hot_ht, &vaddr);
+        if (!hot) {
+            if (!plugin_tb_hot_counter_new__locked(&count)) {
+                warn_report_once("plugin: too many blocks, "
+                                 "new blocks are not counted");
+                return;
+            }
+            hot = g_new(struct qemu_plugin_tb_hot, 1);
+            hot->vaddr = vaddr;
+            hot->count = count;
+            g_hash_table_insert(plugin.tb_hot_ht, &hot->vaddr, hot);
+        }
+    }
+
+    count = hot->count;
+    qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+        tb, QEMU_PLUGIN_INLINE_ADD_U64, count, 1);
+
+    QLIST_FOREACH_RCU(cb, &plugin.cb_lists[ev], entry) {
+        uint64_t threshold = cb->ctx->tb_hot_threshold;
+
+        if (threshold == 0 || plugin_tb_hot_threshold_seen(cb)) {
+            continue;
+        }
+        qemu_plugin_register_vcpu_tb_exec_cond_cb(
+            tb, plugin_vcpu_tb_hot__cb, QEMU_PLUGIN_CB_NO_REGS,
+            QEMU_PLUGIN_COND_EQ, count, threshold, hot);
+    }
+}
+
+void qemu_plugin_register_vcpu_tb_hot_cb(qemu_plugin_id_t id,
+                                         qemu_plugin_vcpu_tb_hot_cb_t cb,
+                                         uint64_t threshold,
+                                         void *udata)
+{
+    WITH_QEMU_LOCK_GUARD(&plugin.lock) {
+        plugin_id_to_ctx_locked(id)->tb_hot_threshold = threshold;
+    }
+    plugin_register_cb_udata(id, QEMU_PLUGIN_EV_VCPU_TB_HOT, cb, udata);
+}
+
+/*
+ * Drop the counters once no plugin asks for them anymore. Called after
+ * the code cache was flushed, so no block refers to them.
+ */
+void plugin_tb_hot_gc__locked(void)
+{
+    if (QLIST_EMPTY(&plugin.cb_lists[QEMU_PLUGIN_EV_VCPU_TB_HOT])) {
+        g_hash_table_remove_all(plugin.tb_hot_ht);
+        g_ptr_array_set_size(plugin.tb_hot_chunks, 0);
+        plugin.tb_hot_used = 0;
+    }
+}
+
+uint64_t qemu_plugin_tb_exec_count(uint64_t vaddr)
+{
+    struct qemu_plugin_tb_hot *hot;
+
+    QEMU_LOCK_GUARD(&plugin.lock);
+    hot = g_hash_table_lookup(plugin.tb_hot_ht, &vaddr);
+    if (!hot) {
+        return 0;
+    }
+    return qemu_plugin_u64_sum(hot->count);
+}
+
+/*
+ * Translation hints
+ *
+ * Hints are looked up when a block is translated, changing them drops
+ * the whole code cache: this is meant for infrequent, profile driven
+ * decisions and keeps the TB invalidation paths out of the plugin core.
+ */
+static enum qemu_plugin_tb_hint plugin_tb_hints(struct qemu_plugin_ctx *ctx,
+                                                struct qemu_plugin_tb *tb)
+{
+    uint64_t vaddr = qemu_plugin_tb_vaddr(tb);
+    guint i;
+
+    /* most plugins never set hints, do not take the lock for them */
+    if (!qatomic_read(&ctx->tb_hints)) {
+        return QEMU_PLUGIN_TB_HINT_NONE;
+    }
+
+    QEMU_LOCK_GUARD(&plugin.lock);
+    if (!ctx->tb_hints) {
+        return QEMU_PLUGIN_TB_HINT_NONE;
+    }
+    for (i = 0; i < ctx->tb_hints->len; i++) {
+        struct qemu_plugin_tb_range *range =
+            &g_array_index(ctx->tb_hints, struct qemu_plugin_tb_range, i);
+
+        if (vaddr >= range->start && vaddr <= range->last) {
+            return range->hints;
+        }
+    }
+    return QEMU_PLUGIN_TB_HINT_NONE;
+}
+
+/*
+ * Replace the hints of @ctx over @new's range: existing ranges are
+ * trimmed or dropped so that the array never holds overlapping ranges.
+ */
+static void plugin_tb_hints_set__locked(struct qemu_plugin_ctx *ctx,
+                                        struct qemu_plugin_tb_range *new)
+{
+    GArray *old = ctx->tb_hints;
+    GArray *hints = g_array_new(false, false,
+                                sizeof(struct qemu_plugin_tb_range));
+    guint i;
+
+    for (i = 0; old && i < old->len; i++) {
+        struct qemu_plugin_tb_range range =
+            g_array_index(old, struct qemu_plugin_tb_range, i);
+
+        if (range.last < new->start || range.start > new->last) {
+            g_array_append_val(hints, range);
+            continue;
+        }
+        if (range.start < new->start) {
+            struct qemu_plugin_tb_range head = range;
+
+            head.last = new->start - 1;
+            g_array_append_val(hints, head);
+        }
+        if (range.last > new->last) {
+            struct qemu_plugin_tb_range tail = range;
+
+            tail.start = new->last + 1;
+            g_array_append_val(hints, tail);
+        }
+    }
+    if (new->hints != QEMU_PLUGIN_TB_HINT_NONE) {
+        g_array_append_val(hints, *new);
+    }
+
+    if (!hints->len) {
+        g_array_free(hints, true);
+        hints = NULL;
+    }
+    qatomic_set(&ctx->tb_hints, hints);
+    if (old) {
+        g_array_free(old, true);
+    }
+}
+
+static void plugin_tb_flush__async(CPUState *cpu, run_on_cpu_data unused)
+{
+    tb_flush(cpu);
+}
+
+void qemu_plugin_retranslate_range(qemu_plugin_id_t id,
+                                   uint64_t vaddr, uint64_t size,
+                                   enum qemu_plugin_tb_hint hints)
+{
+    struct qemu_plugin_tb_range range = {
+        .start = vaddr,
+        .last = vaddr + size - 1,
+        .hints = hints,
+    };
+    CPUState *cpu = current_cpu ? current_cpu : first_cpu;
+
+    if (size == 0) {
+        return;
+    }
+
+    WITH_QEMU_LOCK_GUARD(&plugin.lock) {
+        plugin_tb_hints_set__locked(plugin_id_to_ctx_locked(id), &range);
+    }
+
+    /* nothing has been translated before the first vCPU exists */
+    if (cpu) {
+        async_safe_run_on_cpu(cpu, plugin_tb_flush__async, RUN_ON_CPU_NULL);
+    }
+}
+
 /*
  * Disable CFI checks.
  * The callback function has been loaded from an external library so we do not
@@ -481,10 +910,20 @@ void qemu_plugin_tb_trans_cb(CPUState *cpu, struct qemu_plugin_tb *tb)
     QLIST_FOREACH_SAFE_RCU(cb, &plugin.cb_lists[ev], entry, next) {
         qemu_plugin_vcpu_tb_trans_cb_t func = cb->f.vcpu_tb_trans;
 
+        if (plugin_tb_hints(cb->ctx, tb) & QEMU_PLUGIN_TB_HINT_NO_INSTRUMENT) {
+            continue;
+        }
         qemu_plugin_set_cb_flags(cpu, QEMU_PLUGIN_CB_RW_REGS);
         func(cb->ctx->id, tb);
         qemu_plugin_set_cb_flags(cpu, QEMU_PLUGIN_CB_NO_REGS);
     }
+
+    if (!QLIST_EMPTY_RCU(&plugin.cb_lists[QEMU_PLUGIN_EV_VCPU_SAMPLE])) {
+        plugin_tb_sample(tb);
+    }
+    if (!QLIST_EMPTY_RCU(&plugin.cb_lists[QEMU_PLUGIN_EV_VCPU_TB_HOT])) {
+        plugin_tb_hot(tb);
+    }
 }
 
 /*
@@ -593,11 +1032,8 @@ void exec_inline_op(enum plugin_dyn_cb_type type,
                     struct qemu_plugin_inline_cb *cb,
                     int cpu_index)
 {
-    char *ptr = cb->entry.score->data->data;
-    size_t elem_size = g_array_get_element_size(
-        cb->entry.score->data);
-    size_t offset = cb->entry.offset;
-    uint64_t *val = (uint64_t *)(ptr + offset + cpu_index * elem_size);
+    char *ptr = plugin_scoreboard_find(cb->entry.score, cpu_index);
+    uint64_t *val = (uint64_t *)(ptr + cb->entry.offset);
 
     switch (type) {
     case PLUGIN_CB_INLINE_ADD_U64:
@@ -746,8 +1182,10 @@ static void __attribute__((__constructor__)) plugin_init(void)
     qemu_rec_mutex_init(&plugin.lock);
     plugin.id_ht = g_hash_table_new(g_int64_hash, g_int64_equal);
     plugin.cpu_ht = g_hash_table_new(g_int_hash, g_int_equal);
-    QLIST_INIT(&plugin.scoreboards);
-    plugin.scoreboard_alloc_size = 16; /* avoid frequent reallocation */
+    plugin.tb_hot_ht = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+                                             NULL, g_free);
+    plugin.tb_hot_chunks = g_ptr_array_new_with_free_func(
+        (GDestroyNotify)plugin_scoreboard_free);
     QTAILQ_INIT(&plugin.ctxs);
     qht_init(&plugin.dyn_cb_arr_ht, plugin_dyn_cb_arr_cmp, 16,
              QHT_MODE_AUTO_RESIZE);
@@ -759,30 +1197,64 @@ int plugin_num_vcpus(void)
     return plugin.num_vcpus;
 }
 
-struct qemu_plugin_scoreboard *plugin_scoreboard_new(size_t element_size)
+struct qemu_plugin_scoreboard *plugin_scoreboard_try_new(size_t element_size)
 {
-    struct qemu_plugin_scoreboard *score =
-        g_malloc0(sizeof(struct qemu_plugin_scoreboard));
-    score->data = g_array_new(FALSE, TRUE, element_size);
-    g_array_set_size(score->data, plugin.scoreboard_alloc_size);
+    struct qemu_plugin_scoreboard *score;
+    size_t offset;
 
     qemu_rec_mutex_lock(&plugin.lock);
-    QLIST_INSERT_HEAD(&plugin.scoreboards, score, entry);
+    offset = plugin_slab_alloc__locked(element_size);
     qemu_rec_mutex_unlock(&plugin.lock);
+    if (offset == (size_t)-1) {
+        return NULL;
+    }
 
+    score = g_new0(struct qemu_plugin_scoreboard, 1);
+    score->element_size = element_size;
+    score->offset = offset;
+    return score;
+}
+
+struct qemu_plugin_scoreboard *plugin_scoreboard_new(size_t element_size)
+{
+    struct qemu_plugin_scoreboard *score =
+        plugin_scoreboard_try_new(element_size);
+
+    if (!score) {
+        error_report("plugin: out of scoreboard space");
+        abort();
+    }
     return score;
 }
 
 void plugin_scoreboard_free(struct qemu_plugin_scoreboard *score)
 {
     qemu_rec_mutex_lock(&plugin.lock);
-    QLIST_REMOVE(score, entry);
+    bitmap_clear(plugin.slab_map, score->offset / sizeof(uint64_t),
+                 DIV_ROUND_UP(score->element_size, sizeof(uint64_t)));
     qemu_rec_mutex_unlock(&plugin.lock);
 
-    g_array_free(score->data, TRUE);
     g_free(score);
 }
 
+void *plugin_scoreboard_find(struct qemu_plugin_scoreboard *score,
+                             unsigned int vcpu_index)
+{
+    struct qemu_plugin_slab_table *table;
+
+    if (current_cpu && current_cpu->cpu_index == vcpu_index) {
+        return qemu_plugin_slabs_ptr(current_cpu->neg.plugin_slabs,
+                                     score->offset);
+    }
+
+    /* slabs are never freed, only the table can be replaced */
+    RCU_READ_LOCK_GUARD();
+    table = qatomic_rcu_read(&plugin.slab_table);
+    g_assert(table && vcpu_index < table->n && table->vcpu[vcpu_index]);
+    return qemu_plugin_slabs_ptr(qatomic_rcu_read(&table->vcpu[vcpu_index]),
+                                 score->offset);
+}
+
 enum qemu_plugin_cb_flags tcg_call_to_qemu_plugin_cb_flags(int flags)
 {
     if (flags & TCG_CALL_NO_RWG) {
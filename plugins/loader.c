@@ -334,6 +334,17 @@ static void plugin_reset_destroy__locked(struct qemu_plugin_reset_data *data)
         plugin_unregister_cb__locked(ctx, ev);
     }
 
+    /* the code cache was flushed, no block refers to the counters anymore */
+    if (ctx->sampler.count) {
+        plugin_scoreboard_free(ctx->sampler.count);
+        ctx->sampler.count = NULL;
+    }
+    if (ctx->tb_hints) {
+        g_array_free(ctx->tb_hints, true);
+        qatomic_set(&ctx->tb_hints, NULL);
+    }
+    plugin_tb_hot_gc__locked();
+
     if (data->reset) {
         g_assert(ctx->resetting);
         if (data->cb) {
@@ -15,9 +15,17 @@
 #include <gmodule.h>
 #include "qemu/queue.h"
 #include "qemu/qht.h"
+#include "qemu/rcu.h"
 
 #define QEMU_PLUGIN_MIN_VERSION 2
 
+/* Scoreboard storage of each vCPU, indexed by vcpu_index */
+struct qemu_plugin_slab_table {
+    struct rcu_head rcu;
+    unsigned int n;
+    struct qemu_plugin_slabs *vcpu[];
+};
+
 /* global state */
 struct qemu_plugin_state {
     QTAILQ_HEAD(, qemu_plugin_ctx) ctxs;
@@ -32,8 +40,20 @@ struct qemu_plugin_state {
      * but with the HT we avoid adding a field to CPUState.
      */
     GHashTable *cpu_ht;
-    QLIST_HEAD(, qemu_plugin_scoreboard) scoreboards;
-    size_t scoreboard_alloc_size;
+    /* allocation map of the scoreboard space, one bit per uint64_t */
+    unsigned long *slab_map;
+    /* number of slabs every vCPU has */
+    size_t nr_slabs;
+    /* RCU-protected, only replaced with @lock held */
+    struct qemu_plugin_slab_table *slab_table;
+    /* pc of the last block entered, only maintained while sampling */
+    struct qemu_plugin_scoreboard *sample_pc;
+    /* block execution counters, keyed by vaddr (struct qemu_plugin_tb_hot) */
+    GHashTable *tb_hot_ht;
+    /* scoreboards the block execution counters are taken from */
+    GPtrArray *tb_hot_chunks;
+    /* counters taken from the last of @tb_hot_chunks */
+    size_t tb_hot_used;
     DECLARE_BITMAP(mask, QEMU_PLUGIN_EV_MAX);
     /*
      * @lock protects the struct as well as ctx->uninstalling.
@@ -51,11 +71,35 @@ struct qemu_plugin_state {
     int num_vcpus;
 };
 
+/* Sampling configuration, see qemu_plugin_register_vcpu_sample_cb() */
+struct qemu_plugin_sampler {
+    enum qemu_plugin_cb_flags flags;
+    uint64_t period;
+    /* instructions executed since the last sample */
+    struct qemu_plugin_scoreboard *count;
+};
+
+/* Execution counter of the blocks starting at @vaddr */
+struct qemu_plugin_tb_hot {
+    uint64_t vaddr;
+    qemu_plugin_u64 count;
+};
+
+/* Translation hints set with qemu_plugin_retranslate_range() */
+struct qemu_plugin_tb_range {
+    uint64_t start;
+    uint64_t last;
+    enum qemu_plugin_tb_hint hints;
+};
 
 struct qemu_plugin_ctx {
     GModule *handle;
     qemu_plugin_id_t id;
     struct qemu_plugin_cb *callbacks[QEMU_PLUGIN_EV_MAX];
+    struct qemu_plugin_sampler sampler;
+    uint64_t tb_hot_threshold;
+    /* array of non-overlapping struct qemu_plugin_tb_range, or NULL */
+    GArray *tb_hints;
     QTAILQ_ENTRY(qemu_plugin_ctx) entry;
     /*
      * keep a reference to @desc until uninstall, so that plugins do not have
@@ -85,6 +129,8 @@ void plugin_register_cb(qemu_plugin_id_t id, enum qemu_plugin_event ev,
 void plugin_unregister_cb__locked(struct qemu_plugin_ctx *ctx,
                                   enum qemu_plugin_event ev);
 
+void plugin_tb_hot_gc__locked(void);
+
 void
 plugin_register_cb_udata(qemu_plugin_id_t id, enum qemu_plugin_event ev,
                          void *func, void *udata);
@@ -117,8 +163,14 @@ int plugin_num_vcpus(void);
 
 struct qemu_plugin_scoreboard *plugin_scoreboard_new(size_t element_size);
 
+/* Like plugin_scoreboard_new(), but returns NULL when out of space */
+struct qemu_plugin_scoreboard *plugin_scoreboard_try_new(size_t element_size);
+
 void plugin_scoreboard_free(struct qemu_plugin_scoreboard *score);
 
+void *plugin_scoreboard_find(struct qemu_plugin_scoreboard *score,
+                             unsigned int vcpu_index);
+
 /**
  * qemu_plugin_fillin_mode_info() - populate mode specific info
  * info: pointer to qemu_info_t structure
@@ -35,7 +35,19 @@ typedef enum json_token_type {
     JSON_MAX = JSON_END_OF_INPUT
 } JSONTokenType;
 
-typedef struct JSONToken JSONToken;
+/*
+ * Tokens of a message are kept in an array that is reused for the next
+ * message, and their text is stored NUL-separated in a single buffer,
+ * so that parsing allocates nothing once the buffers have grown.
+ */
+typedef struct JSONToken {
+    JSONTokenType type;
+    int x;
+    int y;
+    /* offset of the text in the token buffer until the message is parsed */
+    size_t offset;
+    const char *str;
+} JSONToken;
 
 /* json-lexer.c */
 void json_lexer_init(JSONLexer *lexer, bool enable_interpolation);
@@ -48,7 +60,7 @@ void json_message_process_token(JSONLexer *lexer, GString *input,
                                 JSONTokenType type, int x, int y);
 
 /* json-parser.c */
-JSONToken *json_token(JSONTokenType type, int x, int y, GString *tokstr);
-QObject *json_parser_parse(GQueue *tokens, va_list *ap, Error **errp);
+QObject *json_parser_parse(JSONToken *tokens, size_t count, va_list *ap,
+                           Error **errp);
 
 #endif
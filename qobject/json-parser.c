@@ -24,17 +24,11 @@
 #include "qobject/qstring.h"
 #include "json-parser-int.h"
 
-struct JSONToken {
-    JSONTokenType type;
-    int x;
-    int y;
-    char str[];
-};
-
 typedef struct JSONParserContext {
     Error *err;
-    JSONToken *current;
-    GQueue *buf;
+    JSONToken *tokens;
+    size_t count;
+    size_t next;
     va_list *ap;
 } JSONParserContext;
 
@@ -235,20 +229,24 @@ out:
     return NULL;
 }
 
-/* Note: the token object returned by parser_context_peek_token or
- * parser_context_pop_token is deleted as soon as parser_context_pop_token
- * is called again.
+/* Note: the token objects returned by parser_context_peek_token and
+ * parser_context_pop_token belong to the caller of json_parser_parse()
+ * and stay valid until it returns.
  */
 static JSONToken *parser_context_pop_token(JSONParserContext *ctxt)
 {
-    g_free(ctxt->current);
-    ctxt->current = g_queue_pop_head(ctxt->buf);
-    return ctxt->current;
+    if (ctxt->next == ctxt->count) {
+        return NULL;
+    }
+    return &ctxt->tokens[ctxt->next++];
 }
 
 static JSONToken *parser_context_peek_token(JSONParserContext *ctxt)
 {
-    return g_queue_peek_head(ctxt->buf);
+    if (ctxt->next == ctxt->count) {
+        return NULL;
+    }
+    return &ctxt->tokens[ctxt->next];
 }
 
 /**
@@ -559,32 +557,16 @@ static QObject *parse_value(JSONParserContext *ctxt)
     }
 }
 
-JSONToken *json_token(JSONTokenType type, int x, int y, GString *tokstr)
+QObject *json_parser_parse(JSONToken *tokens, size_t count, va_list *ap,
+                           Error **errp)
 {
-    JSONToken *token = g_malloc(sizeof(JSONToken) + tokstr->len + 1);
-
-    token->type = type;
-    memcpy(token->str, tokstr->str, tokstr->len);
-    token->str[tokstr->len] = 0;
-    token->x = x;
-    token->y = y;
-    return token;
-}
-
-QObject *json_parser_parse(GQueue *tokens, va_list *ap, Error **errp)
-{
-    JSONParserContext ctxt = { .buf = tokens, .ap = ap };
+    JSONParserContext ctxt = { .tokens = tokens, .count = count, .ap = ap };
     QObject *result;
 
     result = parse_value(&ctxt);
-    assert(ctxt.err || g_queue_is_empty(ctxt.buf));
+    assert(ctxt.err || ctxt.next == ctxt.count);
 
     error_propagate(errp, ctxt.err);
 
-    while (!g_queue_is_empty(ctxt.buf)) {
-        parser_context_pop_token(&ctxt);
-    }
-    g_free(ctxt.current);
-
     return result;
 }
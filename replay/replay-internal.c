@@ -15,6 +15,11 @@
 #include "replay-internal.h"
 #include "qemu/error-report.h"
 #include "qemu/main-loop.h"
+#include "qemu/units.h"
+#include "qemu/bswap.h"
+#ifdef CONFIG_ZSTD
+#include <zstd.h>
+#endif
 
 /* Mutex to protect reading and writing events to the log.
    data_kind and has_unread_data are also protected
@@ -30,6 +35,41 @@ static unsigned long mutex_head, mutex_tail;
 static bool write_error;
 FILE *replay_file;
 
+/*
+ * The event stream is stored in chunks of up to REPLAY_CHUNK_SIZE bytes.
+ * Every chunk starts with two big-endian dwords: the number of event
+ * bytes in the chunk and the number of bytes stored in the file.
+ * They differ when the chunk is compressed with zstd.
+ *
+ * The chunk index is appended after the last chunk and its file offset
+ * is kept in the log header. The index lets the replay restart from
+ * any snapshot without decoding the log from the beginning.
+ */
+#define REPLAY_HEADER_SIZE          (sizeof(uint32_t) + sizeof(uint64_t))
+#define REPLAY_CHUNK_SIZE           (256 * KiB)
+#define REPLAY_CHUNK_HEADER_SIZE    (2 * sizeof(uint32_t))
+#define REPLAY_INDEX_ENTRY_SIZE     (3 * sizeof(uint64_t))
+#define REPLAY_ZSTD_LEVEL           1
+
+typedef struct ReplayChunk {
+    /* offset of the chunk header in the file */
+    uint64_t file_offset;
+    /* offset of the first chunk byte in the event stream */
+    uint64_t log_offset;
+    /* instruction count when the chunk was started */
+    uint64_t icount;
+} ReplayChunk;
+
+static GArray *chunk_index;
+static uint8_t *chunk_buf;
+static size_t chunk_len;
+/* Read position inside the current chunk in play mode */
+static size_t chunk_pos;
+/* Current chunk: being filled in record mode, being read in play mode */
+static guint chunk_cur;
+static uint64_t chunk_icount;
+static uint64_t chunk_log_offset;
+
 static void replay_write_error(void)
 {
     if (!write_error) {
@@ -44,12 +84,228 @@ static void replay_read_error(void)
     exit(1);
 }
 
+static void replay_flush_chunk(void)
+{
+    ReplayChunk chunk = {
+        .file_offset = ftell(replay_file),
+        .log_offset = chunk_log_offset,
+        .icount = chunk_icount,
+    };
+    const uint8_t *data = chunk_buf;
+    size_t stored = chunk_len;
+    uint8_t header[REPLAY_CHUNK_HEADER_SIZE];
+#ifdef CONFIG_ZSTD
+    g_autofree uint8_t *zbuf = NULL;
+    size_t zbound, zlen;
+#endif
+
+    if (!chunk_len) {
+        return;
+    }
+
+#ifdef CONFIG_ZSTD
+    zbound = ZSTD_compressBound(chunk_len);
+    zbuf = g_malloc(zbound);
+    zlen = ZSTD_compress(zbuf, zbound, chunk_buf, chunk_len,
+                         REPLAY_ZSTD_LEVEL);
+    if (!ZSTD_isError(zlen) && zlen < chunk_len) {
+        data = zbuf;
+        stored = zlen;
+    }
+#endif
+
+    stl_be_p(header, chunk_len);
+    stl_be_p(header + 4, stored);
+    if (fwrite(header, 1, sizeof(header), replay_file) != sizeof(header) ||
+        fwrite(data, 1, stored, replay_file) != stored) {
+        replay_write_error();
+    }
+    g_array_append_val(chunk_index, chunk);
+
+    chunk_log_offset += chunk_len;
+    chunk_icount = replay_state.current_icount;
+    chunk_len = 0;
+}
+
+static void replay_load_chunk(guint index)
+{
+    ReplayChunk *chunk;
+    uint8_t header[REPLAY_CHUNK_HEADER_SIZE];
+    uint32_t len, stored;
+
+    if (index >= chunk_index->len) {
+        replay_read_error();
+    }
+    chunk = &g_array_index(chunk_index, ReplayChunk, index);
+
+    if (fseek(replay_file, chunk->file_offset, SEEK_SET) ||
+        fread(header, 1, sizeof(header), replay_file) != sizeof(header)) {
+        replay_read_error();
+    }
+    len = ldl_be_p(header);
+    stored = ldl_be_p(header + 4);
+    if (len > REPLAY_CHUNK_SIZE || stored > REPLAY_CHUNK_SIZE) {
+        replay_read_error();
+    }
+
+    if (stored == len) {
+        if (fread(chunk_buf, 1, len, replay_file) != len) {
+            replay_read_error();
+        }
+    } else {
+#ifdef CONFIG_ZSTD
+        g_autofree uint8_t *zbuf = g_malloc(stored);
+
+        if (fread(zbuf, 1, stored, replay_file) != stored ||
+            ZSTD_decompress(chunk_buf, len, zbuf, stored) != len) {
+            replay_read_error();
+        }
+#else
+        error_report("replay log is compressed with zstd, "
+                     "which is not supported by this build");
+        exit(1);
+#endif
+    }
+
+    chunk_cur = index;
+    chunk_len = len;
+    chunk_pos = 0;
+}
+
+void replay_log_open(void)
+{
+    chunk_index = g_array_new(false, false, sizeof(ReplayChunk));
+    chunk_buf = g_malloc(REPLAY_CHUNK_SIZE);
+    chunk_len = 0;
+    chunk_pos = 0;
+    chunk_cur = 0;
+    chunk_icount = 0;
+    chunk_log_offset = 0;
+
+    /* skip file header for RECORD and read the chunk index for PLAY */
+    if (replay_mode == REPLAY_MODE_RECORD) {
+        fseek(replay_file, REPLAY_HEADER_SIZE, SEEK_SET);
+    } else if (replay_mode == REPLAY_MODE_PLAY) {
+        uint8_t buf[REPLAY_INDEX_ENTRY_SIZE];
+        uint64_t index_offset;
+        uint32_t count;
+
+        if (fread(buf, 1, REPLAY_HEADER_SIZE, replay_file)
+            != REPLAY_HEADER_SIZE) {
+            replay_read_error();
+        }
+        if (ldl_be_p(buf) != REPLAY_VERSION) {
+            fprintf(stderr, "Replay: invalid input log file version\n");
+            exit(1);
+        }
+        index_offset = ldq_be_p(buf + sizeof(uint32_t));
+
+        if (fseek(replay_file, index_offset, SEEK_SET) ||
+            fread(buf, 1, sizeof(uint32_t), replay_file) != sizeof(uint32_t)) {
+            replay_read_error();
+        }
+        count = ldl_be_p(buf);
+        for (uint32_t i = 0; i < count; i++) {
+            ReplayChunk chunk;
+
+            if (fread(buf, 1, sizeof(buf), replay_file) != sizeof(buf)) {
+                replay_read_error();
+            }
+            chunk.file_offset = ldq_be_p(buf);
+            chunk.log_offset = ldq_be_p(buf + 8);
+            chunk.icount = ldq_be_p(buf + 16);
+            g_array_append_val(chunk_index, chunk);
+        }
+
+        /* go to the beginning */
+        replay_load_chunk(0);
+    }
+}
+
+void replay_log_close(void)
+{
+    if (replay_mode == REPLAY_MODE_RECORD) {
+        uint8_t buf[REPLAY_INDEX_ENTRY_SIZE];
+        uint64_t index_offset;
+
+        replay_flush_chunk();
+
+        index_offset = ftell(replay_file);
+        stl_be_p(buf, chunk_index->len);
+        if (fwrite(buf, 1, sizeof(uint32_t), replay_file) != sizeof(uint32_t)) {
+            replay_write_error();
+        }
+        for (guint i = 0; i < chunk_index->len; i++) {
+            ReplayChunk *chunk = &g_array_index(chunk_index, ReplayChunk, i);
+
+            stq_be_p(buf, chunk->file_offset);
+            stq_be_p(buf + 8, chunk->log_offset);
+            stq_be_p(buf + 16, chunk->icount);
+            if (fwrite(buf, 1, sizeof(buf), replay_file) != sizeof(buf)) {
+                replay_write_error();
+            }
+        }
+
+        /* write header */
+        stl_be_p(buf, REPLAY_VERSION);
+        stq_be_p(buf + sizeof(uint32_t), index_offset);
+        fseek(replay_file, 0, SEEK_SET);
+        if (fwrite(buf, 1, REPLAY_HEADER_SIZE, replay_file)
+            != REPLAY_HEADER_SIZE) {
+            replay_write_error();
+        }
+    }
+
+    g_array_free(chunk_index, true);
+    chunk_index = NULL;
+    g_free(chunk_buf);
+    chunk_buf = NULL;
+}
+
+uint64_t replay_log_tell(void)
+{
+    if (replay_mode == REPLAY_MODE_PLAY) {
+        return g_array_index(chunk_index, ReplayChunk, chunk_cur).log_offset
+               + chunk_pos;
+    }
+    return chunk_log_offset + chunk_len;
+}
+
+void replay_log_seek(uint64_t offset)
+{
+    guint lo = 0, hi = chunk_index->len;
+
+    assert(replay_mode == REPLAY_MODE_PLAY);
+
+    /* find the last chunk starting at or before the offset */
+    while (hi - lo > 1) {
+        guint mid = lo + (hi - lo) / 2;
+
+        if (g_array_index(chunk_index, ReplayChunk, mid).log_offset
+            <= offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo != chunk_cur) {
+        replay_load_chunk(lo);
+    }
+    chunk_pos = offset -
+        g_array_index(chunk_index, ReplayChunk, chunk_cur).log_offset;
+    if (chunk_pos > chunk_len) {
+        replay_read_error();
+    }
+}
+
 void replay_put_byte(uint8_t byte)
 {
     if (replay_file) {
-        if (putc(byte, replay_file) == EOF) {
-            replay_write_error();
+        if (chunk_len == REPLAY_CHUNK_SIZE) {
+            replay_flush_chunk();
         }
+        chunk_buf[chunk_len++] = byte;
     }
 }
 
@@ -82,8 +338,17 @@ void replay_put_array(const uint8_t *buf, size_t size)
 {
     if (replay_file) {
         replay_put_dword(size);
-        if (fwrite(buf, 1, size, replay_file) != size) {
-            replay_write_error();
+        while (size) {
+            size_t n;
+
+            if (chunk_len == REPLAY_CHUNK_SIZE) {
+                replay_flush_chunk();
+            }
+            n = MIN(size, REPLAY_CHUNK_SIZE - chunk_len);
+            memcpy(chunk_buf + chunk_len, buf, n);
+            chunk_len += n;
+            buf += n;
+            size -= n;
         }
     }
 }
@@ -92,11 +357,10 @@ uint8_t replay_get_byte(void)
 {
     uint8_t byte = 0;
     if (replay_file) {
-        int r = getc(replay_file);
-        if (r == EOF) {
-            replay_read_error();
+        if (chunk_pos == chunk_len) {
+            replay_load_chunk(chunk_cur + 1);
         }
-        byte = r;
+        byte = chunk_buf[chunk_pos++];
     }
     return byte;
 }
@@ -134,13 +398,27 @@ int64_t replay_get_qword(void)
     return qword;
 }
 
+static void replay_get_bytes(uint8_t *buf, size_t size)
+{
+    while (size) {
+        size_t n;
+
+        if (chunk_pos == chunk_len) {
+            replay_load_chunk(chunk_cur + 1);
+        }
+        n = MIN(size, chunk_len - chunk_pos);
+        memcpy(buf, chunk_buf + chunk_pos, n);
+        chunk_pos += n;
+        buf += n;
+        size -= n;
+    }
+}
+
 void replay_get_array(uint8_t *buf, size_t *size)
 {
     if (replay_file) {
         *size = replay_get_dword();
-        if (fread(buf, 1, *size, replay_file) != *size) {
-            replay_read_error();
-        }
+        replay_get_bytes(buf, *size);
     }
 }
 
@@ -149,9 +427,7 @@ void replay_get_array_alloc(uint8_t **buf, size_t *size)
     if (replay_file) {
         *size = replay_get_dword();
         *buf = g_malloc(*size);
-        if (fread(*buf, 1, *size, replay_file) != *size) {
-            replay_read_error();
-        }
+        replay_get_bytes(*buf, *size);
     }
 }
 
@@ -82,7 +82,7 @@ enum ReplayEvents {
  * @current_event: current event index
  * @data_kind: current event
  * @has_unread_data: true if event not yet processed
- * @file_offset: offset into replay log at replay snapshot
+ * @file_offset: offset into replay event stream at replay snapshot
  * @block_request_id: current serialised block request id
  * @read_event_id: current async read event id
  */
@@ -99,6 +99,10 @@ typedef struct ReplayState {
 } ReplayState;
 extern ReplayState replay_state;
 
+/* Current version of the replay mechanism.
+   Increase it when file format changes. */
+#define REPLAY_VERSION              0xe0200d
+
 /* File for replay writing */
 extern FILE *replay_file;
 /* Instruction count of the replay breakpoint */
@@ -113,6 +117,17 @@ void replay_put_dword(uint32_t dword);
 void replay_put_qword(int64_t qword);
 void replay_put_array(const uint8_t *buf, size_t size);
 
+/*! Skips the log header in record mode, reads the header
+    and the chunk index in play mode. */
+void replay_log_open(void);
+/*! Writes the pending chunk, the chunk index and the log header
+    in record mode and frees the chunk buffers. */
+void replay_log_close(void);
+/*! Returns the current offset in the uncompressed event stream. */
+uint64_t replay_log_tell(void);
+/*! Moves the play position to @offset in the event stream. */
+void replay_log_seek(uint64_t offset);
+
 uint8_t replay_get_byte(void);
 uint16_t replay_get_word(void);
 uint32_t replay_get_dword(void);
@@ -211,5 +226,9 @@ G_NORETURN void replay_sync_error(const char *error);
    Should be called before virtual devices initialization
    to make cached timers available for post_load functions. */
 void replay_vmstate_register(void);
+/* Starts taking VM snapshots every replay_snapshot_period
+   instructions in replay mode. */
+void replay_vmstate_start_auto_snapshot(void);
+void replay_vmstate_stop_auto_snapshot(void);
 
 #endif
@@ -16,13 +16,15 @@
 #include "monitor/monitor.h"
 #include "qobject/qstring.h"
 #include "qemu/error-report.h"
+#include "qemu/timer.h"
+#include "system/runstate.h"
 #include "migration/vmstate.h"
 #include "migration/snapshot.h"
 
 static int replay_pre_save(void *opaque)
 {
     ReplayState *state = opaque;
-    state->file_offset = ftell(replay_file);
+    state->file_offset = replay_log_tell();
 
     return 0;
 }
@@ -31,7 +33,7 @@ static int replay_post_load(void *opaque, int version_id)
 {
     ReplayState *state = opaque;
     if (replay_mode == REPLAY_MODE_PLAY) {
-        fseek(replay_file, state->file_offset, SEEK_SET);
+        replay_log_seek(state->file_offset);
         /* If this was a vmstate, saved in recording mode,
            we need to initialize replay data fields. */
         replay_fetch_data_kind();
@@ -92,6 +94,63 @@ void replay_vmstate_init(void)
     }
 }
 
+/* How often the icount is checked against the auto snapshot period */
+#define REPLAY_AUTO_SNAPSHOT_POLL_MS    100
+
+static QEMUTimer *replay_auto_snapshot_timer;
+/* Instruction count of the latest automatic snapshot */
+static uint64_t replay_auto_snapshot_icount;
+
+static void replay_auto_snapshot(void *opaque)
+{
+    uint64_t icount = replay_get_current_icount();
+    Error *err = NULL;
+
+    /*
+     * After seeking backwards the snapshots up to the latest one
+     * already exist, so only the new part of the replay is covered.
+     */
+    if (runstate_is_running() && !replay_running_debug()
+        && icount >= replay_auto_snapshot_icount + replay_snapshot_period
+        && replay_can_snapshot()) {
+        g_autofree char *name = g_strdup_printf("replay_auto_%" PRIu64,
+                                                icount);
+
+        if (!save_snapshot(name, true, NULL, false, NULL, &err)) {
+            error_report_err(err);
+            warn_report("Disabling automatic replay snapshots");
+            return;
+        }
+        replay_auto_snapshot_icount = icount;
+    }
+
+    timer_mod(replay_auto_snapshot_timer,
+              qemu_clock_get_ms(QEMU_CLOCK_REALTIME) +
+              REPLAY_AUTO_SNAPSHOT_POLL_MS);
+}
+
+void replay_vmstate_start_auto_snapshot(void)
+{
+    if (replay_mode != REPLAY_MODE_PLAY || !replay_snapshot_period) {
+        return;
+    }
+
+    replay_auto_snapshot_icount = replay_get_current_icount();
+    replay_auto_snapshot_timer = timer_new_ms(QEMU_CLOCK_REALTIME,
+                                              replay_auto_snapshot, NULL);
+    timer_mod(replay_auto_snapshot_timer,
+              qemu_clock_get_ms(QEMU_CLOCK_REALTIME) +
+              REPLAY_AUTO_SNAPSHOT_POLL_MS);
+}
+
+void replay_vmstate_stop_auto_snapshot(void)
+{
+    if (replay_auto_snapshot_timer) {
+        timer_free(replay_auto_snapshot_timer);
+        replay_auto_snapshot_timer = NULL;
+    }
+}
+
 bool replay_can_snapshot(void)
 {
     return replay_mode == REPLAY_MODE_NONE
@@ -20,14 +20,9 @@
 #include "system/cpus.h"
 #include "qemu/error-report.h"
 
-/* Current version of the replay mechanism.
-   Increase it when file format changes. */
-#define REPLAY_VERSION              0xe0200c
-/* Size of replay log header */
-#define HEADER_SIZE                 (sizeof(uint32_t) + sizeof(uint64_t))
-
 ReplayMode replay_mode = REPLAY_MODE_NONE;
 char *replay_snapshot;
+uint64_t replay_snapshot_period;
 
 /* Name of replay file  */
 static char *replay_filename;
@@ -371,17 +366,8 @@ static void replay_enable(const char *fname, int mode)
     replay_state.current_event = 0;
     replay_state.has_unread_data = 0;
 
-    /* skip file header for RECORD and check it for PLAY */
-    if (replay_mode == REPLAY_MODE_RECORD) {
-        fseek(replay_file, HEADER_SIZE, SEEK_SET);
-    } else if (replay_mode == REPLAY_MODE_PLAY) {
-        unsigned int version = replay_get_dword();
-        if (version != REPLAY_VERSION) {
-            fprintf(stderr, "Replay: invalid input log file version\n");
-            exit(1);
-        }
-        /* go to the beginning */
-        fseek(replay_file, HEADER_SIZE, SEEK_SET);
+    replay_log_open();
+    if (replay_mode == REPLAY_MODE_PLAY) {
         replay_fetch_data_kind();
     }
 
@@ -424,6 +410,7 @@ void replay_configure(QemuOpts *opts)
     }
 
     replay_snapshot = g_strdup(qemu_opt_get(opts, "rrsnapshot"));
+    replay_snapshot_period = qemu_opt_get_number(opts, "rrsnapshot-period", 0);
     replay_vmstate_register();
     replay_enable(fname, mode);
 
@@ -446,7 +433,7 @@ void replay_start(void)
         exit(1);
     }
 
-    /* Timer for snapshotting will be set up here. */
+    replay_vmstate_start_auto_snapshot();
 
     replay_enable_events();
 }
@@ -469,12 +456,10 @@ void replay_finish(void)
             replay_shutdown_request(SHUTDOWN_CAUSE_HOST_SIGNAL);
             /* write end event */
             replay_put_event(EVENT_END);
-
-            /* write header */
-            fseek(replay_file, 0, SEEK_SET);
-            replay_put_dword(REPLAY_VERSION);
         }
 
+        /* write the chunk index and header */
+        replay_log_close();
         fclose(replay_file);
         replay_file = NULL;
     }
@@ -483,6 +468,7 @@ void replay_finish(void)
 
     g_free(replay_snapshot);
     replay_snapshot = NULL;
+    replay_vmstate_stop_auto_snapshot();
 
     replay_finish_events();
     replay_mode = REPLAY_MODE_NONE;
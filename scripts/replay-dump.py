@@ -19,6 +19,7 @@
 # License along with this library; if not, see <http://www.gnu.org/licenses/>.
 
 import argparse
+import io
 import struct
 import os
 import sys
@@ -403,18 +404,43 @@ def parse_arguments():
                         required=True)
     return parser.parse_args()
 
+def read_chunks(fin, index_offset):
+    "Read the chunked event stream of a v13 log into memory"
+    fin.seek(index_offset)
+    count = read_dword(fin)
+    index = [struct.unpack('>QQQ', fin.read(24)) for _ in range(count)]
+    print("INDEX: %d chunks" % (count))
+
+    events = bytearray()
+    for file_offset, log_offset, icount in index:
+        fin.seek(file_offset)
+        size = read_dword(fin)
+        stored = read_dword(fin)
+        data = fin.read(stored)
+        if stored != size:
+            import zstandard
+            data = zstandard.ZstdDecompressor().decompress(data, size)
+        print("CHUNK: offset %d icount %d size %d stored %d" %
+              (log_offset, icount, size, stored))
+        events += data
+    return io.BytesIO(bytes(events)), len(events)
+
 def decode_file(filename):
     "Decode a record/replay dump"
     dumpfile = open(filename, "rb")
     dumpsize = path.getsize(filename)
-    # read and throwaway the header
+    # read the header
     version = read_dword(dumpfile)
-    junk = read_qword(dumpfile)
+    index_offset = read_qword(dumpfile)
 
     # see REPLAY_VERSION
     print("HEADER: version 0x%x" % (version))
 
-    if version == 0xe0200c:
+    if version == 0xe0200d:
+        dumpfile, dumpsize = read_chunks(dumpfile, index_offset)
+        event_decode_table = v12_event_table
+        replay_state.checkpoint_start = 30
+    elif version == 0xe0200c:
         event_decode_table = v12_event_table
         replay_state.checkpoint_start = 30
     elif version == 0xe02007:
@@ -0,0 +1,509 @@
+/*
+ * Shared memory export of runtime-collected statistics
+ *
+ * The statistics of all providers are periodically copied into a
+ * memfd-backed region, so that collectors can sample them without QMP
+ * round trips.  The layout is described in
+ * docs/interop/stats-export.rst.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or
+ * (at your option) any later version.
+ */
+
+#include "qemu/osdep.h"
+#include "system/stats.h"
+#include "qapi/qapi-commands-stats.h"
+#include "qapi/error.h"
+#include "qemu/atomic.h"
+#include "qemu/memfd.h"
+#include "qemu/timer.h"
+
+#define STATS_EXPORT_MAGIC              0x41545351 /* "QSTA" */
+#define STATS_EXPORT_VERSION            1
+
+#define STATS_EXPORT_NONE               0xff
+#define STATS_EXPORT_NO_STRING          UINT32_MAX
+
+#define STATS_EXPORT_FLAG_BOOLEAN       1
+#define STATS_EXPORT_FLAG_LIST          2
+
+#define STATS_EXPORT_MIN_INTERVAL       10
+#define STATS_EXPORT_DEFAULT_INTERVAL   1000
+
+typedef struct StatsExportHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t seq;
+    uint32_t generation;
+    uint64_t size;
+    uint64_t timestamp;
+    uint32_t nr_desc;
+    uint32_t desc_offset;
+    uint32_t strings_offset;
+    uint32_t values_offset;
+    uint32_t nr_values;
+    uint32_t interval;
+    uint64_t reserved;
+} StatsExportHeader;
+
+typedef struct StatsExportDesc {
+    uint32_t name;
+    uint32_t qom_path;
+    uint32_t value_index;
+    uint32_t nr_values;
+    uint8_t provider;
+    uint8_t target;
+    uint8_t type;
+    uint8_t unit;
+    int8_t base;
+    uint8_t flags;
+    int16_t exponent;
+    uint32_t bucket_size;
+    uint32_t reserved;
+} StatsExportDesc;
+
+QEMU_BUILD_BUG_ON(sizeof(StatsExportHeader) != 64);
+QEMU_BUILD_BUG_ON(sizeof(StatsExportDesc) != 32);
+
+/* Host copy of a descriptor, used to notice when the layout changes */
+typedef struct StatsExportEntry {
+    StatsProvider provider;
+    StatsTarget target;
+    char *qom_path;
+    char *name;
+    uint32_t nr_values;
+    uint8_t flags;
+} StatsExportEntry;
+
+typedef struct StatsExport {
+    int fd;
+    void *ptr;
+    size_t size;
+    uint32_t interval;
+    uint32_t generation;
+    QEMUTimer *timer;
+    GArray *entries;
+} StatsExport;
+
+static StatsExport *stats_export;
+
+static void stats_export_entry_clear(void *opaque)
+{
+    StatsExportEntry *entry = opaque;
+
+    g_free(entry->qom_path);
+    g_free(entry->name);
+}
+
+static uint32_t stats_value_count(StatsValue *value)
+{
+    uint32_t n = 0;
+    uint64List *list;
+
+    if (value->type != QTYPE_QLIST) {
+        return 1;
+    }
+    for (list = value->u.list; list; list = list->next) {
+        n++;
+    }
+    return n;
+}
+
+static uint8_t stats_value_flags(StatsValue *value)
+{
+    switch (value->type) {
+    case QTYPE_QBOOL:
+        return STATS_EXPORT_FLAG_BOOLEAN;
+    case QTYPE_QLIST:
+        return STATS_EXPORT_FLAG_LIST;
+    default:
+        return 0;
+    }
+}
+
+static StatsSchemaValue *find_schema_value(StatsSchemaList *schemas,
+                                           StatsProvider provider,
+                                           StatsTarget target,
+                                           const char *name)
+{
+    StatsSchemaList *node;
+    StatsSchemaValueList *value;
+
+    for (node = schemas; node; node = node->next) {
+        if (node->value->provider != provider ||
+            node->value->target != target) {
+            continue;
+        }
+        for (value = node->value->stats; value; value = value->next) {
+            if (g_str_equal(value->value->name, name)) {
+                return value->value;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Gather the statistics of all providers, one list per target */
+static bool stats_export_collect(StatsResultList **results, Error **errp)
+{
+    ERRP_GUARD();
+
+    for (int i = 0; i < STATS_TARGET__MAX; i++) {
+        StatsFilter filter = { .target = i };
+
+        results[i] = qmp_query_stats(&filter, errp);
+        if (*errp) {
+            while (i-- > 0) {
+                qapi_free_StatsResultList(results[i]);
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool stats_export_layout_matches(StatsExport *se,
+                                        StatsResultList **results)
+{
+    guint n = 0;
+
+    for (int i = 0; i < STATS_TARGET__MAX; i++) {
+        StatsResultList *result;
+        StatsList *stats;
+
+        for (result = results[i]; result; result = result->next) {
+            for (stats = result->value->stats; stats; stats = stats->next) {
+                StatsValue *value = stats->value->value;
+                StatsExportEntry *entry;
+
+                if (n == se->entries->len) {
+                    return false;
+                }
+                entry = &g_array_index(se->entries, StatsExportEntry, n++);
+                if (entry->provider != result->value->provider ||
+                    entry->target != i ||
+                    g_strcmp0(entry->qom_path, result->value->qom_path) ||
+                    !g_str_equal(entry->name, stats->value->name) ||
+                    entry->nr_values != stats_value_count(value) ||
+                    entry->flags != stats_value_flags(value)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return n == se->entries->len;
+}
+
+static bool stats_export_resize(StatsExport *se, size_t size, Error **errp)
+{
+    void *ptr;
+
+    size = ROUND_UP(size, qemu_real_host_page_size());
+    if (size <= se->size) {
+        return true;
+    }
+
+    if (ftruncate(se->fd, size) < 0) {
+        error_setg_errno(errp, errno, "failed to grow statistics region");
+        return false;
+    }
+    ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, se->fd, 0);
+    if (ptr == MAP_FAILED) {
+        error_setg_errno(errp, errno, "failed to map statistics region");
+        return false;
+    }
+    munmap(se->ptr, se->size);
+    se->ptr = ptr;
+    se->size = size;
+    return true;
+}
+
+/*
+ * Rebuild the descriptor table and string table for @results, growing
+ * the region if needed.  Called inside the write side of the seqlock.
+ */
+static bool stats_export_relayout(StatsExport *se, StatsResultList **results,
+                                  Error **errp)
+{
+    ERRP_GUARD();
+    g_autoptr(StatsSchemaList) schemas = NULL;
+    StatsExportHeader *hdr;
+    StatsExportDesc *desc;
+    char *strings;
+    size_t strings_len = 0, str;
+    uint32_t nr_values = 0;
+    uint32_t desc_offset, strings_offset, values_offset;
+
+    schemas = qmp_query_stats_schemas(false, 0, errp);
+    if (*errp) {
+        return false;
+    }
+
+    g_array_set_size(se->entries, 0);
+    for (int i = 0; i < STATS_TARGET__MAX; i++) {
+        StatsResultList *result;
+        StatsList *stats;
+
+        for (result = results[i]; result; result = result->next) {
+            if (result->value->qom_path) {
+                strings_len += strlen(result->value->qom_path) + 1;
+            }
+            for (stats = result->value->stats; stats; stats = stats->next) {
+                StatsExportEntry entry = {
+                    .provider = result->value->provider,
+                    .target = i,
+                    .qom_path = g_strdup(result->value->qom_path),
+                    .name = g_strdup(stats->value->name),
+                    .nr_values = stats_value_count(stats->value->value),
+                    .flags = stats_value_flags(stats->value->value),
+                };
+
+                strings_len += strlen(entry.name) + 1;
+                nr_values += entry.nr_values;
+                g_array_append_val(se->entries, entry);
+            }
+        }
+    }
+
+    desc_offset = sizeof(StatsExportHeader);
+    strings_offset = desc_offset + se->entries->len * sizeof(StatsExportDesc);
+    values_offset = ROUND_UP(strings_offset + strings_len, sizeof(uint64_t));
+    if (!stats_export_resize(se, values_offset +
+                             (size_t)nr_values * sizeof(uint64_t), errp)) {
+        return false;
+    }
+
+    hdr = se->ptr;
+    desc = se->ptr + desc_offset;
+    strings = se->ptr + strings_offset;
+    str = 0;
+    nr_values = 0;
+    for (int i = 0; i < STATS_TARGET__MAX; i++) {
+        StatsResultList *result;
+        StatsList *stats;
+
+        for (result = results[i]; result; result = result->next) {
+            uint32_t qom_path = STATS_EXPORT_NO_STRING;
+
+            if (result->value->qom_path) {
+                qom_path = str;
+                str = g_stpcpy(strings + str, result->value->qom_path) + 1 -
+                      strings;
+            }
+            for (stats = result->value->stats; stats; stats = stats->next) {
+                StatsSchemaValue *schema =
+                    find_schema_value(schemas, result->value->provider, i,
+                                      stats->value->name);
+
+                *desc = (StatsExportDesc) {
+                    .name = str,
+                    .qom_path = qom_path,
+                    .value_index = nr_values,
+                    .nr_values = stats_value_count(stats->value->value),
+                    .provider = result->value->provider,
+                    .target = i,
+                    .type = schema ? schema->type : STATS_EXPORT_NONE,
+                    .unit = schema && schema->has_unit
+                            ? schema->unit : STATS_EXPORT_NONE,
+                    .base = schema && schema->has_base ? schema->base : 0,
+                    .flags = stats_value_flags(stats->value->value),
+                    .exponent = schema ? schema->exponent : 0,
+                    .bucket_size = schema && schema->has_bucket_size
+                                   ? schema->bucket_size : 0,
+                };
+                str = g_stpcpy(strings + str, stats->value->name) + 1 -
+                      strings;
+                nr_values += desc->nr_values;
+                desc++;
+            }
+        }
+    }
+
+    hdr->generation = ++se->generation;
+    hdr->nr_desc = se->entries->len;
+    hdr->desc_offset = desc_offset;
+    hdr->strings_offset = strings_offset;
+    hdr->values_offset = values_offset;
+    hdr->nr_values = nr_values;
+    hdr->size = se->size;
+    return true;
+}
+
+static void stats_export_write_values(StatsExport *se,
+                                      StatsResultList **results)
+{
+    StatsExportHeader *hdr = se->ptr;
+    uint64_t *values = se->ptr + hdr->values_offset;
+
+    for (int i = 0; i < STATS_TARGET__MAX; i++) {
+        StatsResultList *result;
+        StatsList *stats;
+
+        for (result = results[i]; result; result = result->next) {
+            for (stats = result->value->stats; stats; stats = stats->next) {
+                StatsValue *value = stats->value->value;
+                uint64List *list;
+
+                switch (value->type) {
+                case QTYPE_QNUM:
+                    *values++ = value->u.scalar;
+                    break;
+                case QTYPE_QBOOL:
+                    *values++ = value->u.boolean;
+                    break;
+                case QTYPE_QLIST:
+                    for (list = value->u.list; list; list = list->next) {
+                        *values++ = list->value;
+                    }
+                    break;
+                default:
+                    abort();
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Copy the current statistics into the region.  Readers retry while
+ * the sequence count is odd or has changed across their read, the same
+ * protocol as QemuSeqLock but on a field of the shared region.
+ */
+static bool stats_export_refresh(StatsExport *se, Error **errp)
+{
+    StatsResultList *results[STATS_TARGET__MAX];
+    StatsExportHeader *hdr = se->ptr;
+    bool ok = true;
+
+    if (!stats_export_collect(results, errp)) {
+        return false;
+    }
+
+    qatomic_set(&hdr->seq, hdr->seq + 1);
+    /* Write sequence before updating the region.  */
+    smp_wmb();
+
+    if (!stats_export_layout_matches(se, results)) {
+        ok = stats_export_relayout(se, results, errp);
+        hdr = se->ptr;
+        if (!ok) {
+            /*
+             * The descriptors in the region no longer match the
+             * statistics; publish an empty layout rather than stale
+             * values, and retry the layout on the next refresh.
+             */
+            g_array_set_size(se->entries, 0);
+            hdr->generation = ++se->generation;
+            hdr->nr_desc = 0;
+            hdr->nr_values = 0;
+        }
+    }
+    if (ok) {
+        stats_export_write_values(se, results);
+        hdr->timestamp = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+    }
+    hdr->interval = se->interval;
+
+    /* Update the region before finalizing sequence.  */
+    smp_wmb();
+    qatomic_set(&hdr->seq, hdr->seq + 1);
+
+    for (int i = 0; i < STATS_TARGET__MAX; i++) {
+        qapi_free_StatsResultList(results[i]);
+    }
+    return ok;
+}
+
+static void stats_export_timer(void *opaque)
+{
+    StatsExport *se = opaque;
+    Error *err = NULL;
+
+    if (!stats_export_refresh(se, &err)) {
+        warn_report_err_once(err);
+    }
+    timer_mod(se->timer,
+              qemu_clock_get_ms(QEMU_CLOCK_REALTIME) + se->interval);
+}
+
+static void stats_export_free(StatsExport *se)
+{
+    timer_free(se->timer);
+    qemu_memfd_free(se->ptr, se->size, se->fd);
+    g_array_free(se->entries, true);
+    g_free(se);
+}
+
+static StatsExportInfo *stats_export_info(StatsExport *se)
+{
+    StatsExportInfo *info = g_new0(StatsExportInfo, 1);
+
+    info->fd = se->fd;
+    info->size = se->size;
+    info->interval = se->interval;
+    return info;
+}
+
+StatsExportInfo *qmp_stats_export_start(bool has_interval, uint32_t interval,
+                                        Error **errp)
+{
+    StatsExport *se;
+    StatsExportHeader *hdr;
+
+    if (!has_interval) {
+        interval = STATS_EXPORT_DEFAULT_INTERVAL;
+    }
+    if (interval < STATS_EXPORT_MIN_INTERVAL) {
+        error_setg(errp, "Parameter 'interval' must be at least %d",
+                   STATS_EXPORT_MIN_INTERVAL);
+        return NULL;
+    }
+
+    if (stats_export) {
+        stats_export->interval = interval;
+        timer_mod(stats_export->timer,
+                  qemu_clock_get_ms(QEMU_CLOCK_REALTIME) + interval);
+        return stats_export_info(stats_export);
+    }
+
+    se = g_new0(StatsExport, 1);
+    se->size = qemu_real_host_page_size();
+    se->ptr = qemu_memfd_alloc("qemu-stats", se->size, F_SEAL_SHRINK,
+                               &se->fd, errp);
+    if (!se->ptr) {
+        g_free(se);
+        return NULL;
+    }
+    se->interval = interval;
+    se->entries = g_array_new(false, false, sizeof(StatsExportEntry));
+    g_array_set_clear_func(se->entries, stats_export_entry_clear);
+    se->timer = timer_new_ms(QEMU_CLOCK_REALTIME, stats_export_timer, se);
+
+    hdr = se->ptr;
+    hdr->magic = STATS_EXPORT_MAGIC;
+    hdr->version = STATS_EXPORT_VERSION;
+    hdr->desc_offset = sizeof(StatsExportHeader);
+    hdr->strings_offset = sizeof(StatsExportHeader);
+    hdr->values_offset = sizeof(StatsExportHeader);
+    hdr->size = se->size;
+
+    if (!stats_export_refresh(se, errp)) {
+        stats_export_free(se);
+        return NULL;
+    }
+
+    stats_export = se;
+    timer_mod(se->timer, qemu_clock_get_ms(QEMU_CLOCK_REALTIME) + interval);
+    return stats_export_info(se);
+}
+
+void qmp_stats_export_stop(Error **errp)
+{
+    if (!stats_export) {
+        error_setg(errp, "Statistics export is not active");
+        return;
+    }
+
+    stats_export_free(stats_export);
+    stats_export = NULL;
+}
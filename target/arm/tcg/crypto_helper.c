@@ -14,6 +14,7 @@
 
 #include "tcg/tcg-gvec-desc.h"
 #include "crypto/aes-round.h"
+#include "crypto/sha2-round.h"
 #include "crypto/sm4.h"
 #include "vec_internal.h"
 
@@ -272,28 +273,56 @@ void HELPER(crypto_sha1su1)(void *vd, void *vm, uint32_t desc)
 }
 
 /*
- * The SHA-256 logical functions, according to
- * http://csrc.nist.gov/groups/STM/cavp/documents/shs/sha256-384-512.pdf
+ * The SHA-256 operations are done by the crypto/sha2-round.h helpers,
+ * which keep the state as {F, E, B, A} and {H, G, D, C} words.
  */
 
-static uint32_t S0(uint32_t x)
+static void crypto_state_to_words(uint32_t *w, union CRYPTO_STATE *st)
 {
-    return ror32(x, 2) ^ ror32(x, 13) ^ ror32(x, 22);
-}
-
-static uint32_t S1(uint32_t x)
-{
-    return ror32(x, 6) ^ ror32(x, 11) ^ ror32(x, 25);
+    for (int i = 0; i < 4; i++) {
+        w[i] = CR_ST_WORD(*st, i);
+    }
 }
 
-static uint32_t s0(uint32_t x)
+static void crypto_state_from_words(union CRYPTO_STATE *st, const uint32_t *w)
 {
-    return ror32(x, 7) ^ ror32(x, 18) ^ (x >> 3);
+    for (int i = 0; i < 4; i++) {
+        CR_ST_WORD(*st, i) = w[i];
+    }
 }
 
-static uint32_t s1(uint32_t x)
-{
-    return ror32(x, 17) ^ ror32(x, 19) ^ (x >> 10);
+/*
+ * Four rounds on the {A, B, C, D} and {E, F, G, H} halves of the state,
+ * both of which are updated.
+ */
+static void do_crypto_sha256_rnds4(union CRYPTO_STATE *abcd,
+                                   union CRYPTO_STATE *efgh,
+                                   union CRYPTO_STATE *wk)
+{
+    uint32_t abef[4] = {
+        CR_ST_WORD(*efgh, 1), CR_ST_WORD(*efgh, 0),
+        CR_ST_WORD(*abcd, 1), CR_ST_WORD(*abcd, 0),
+    };
+    uint32_t cdgh[4] = {
+        CR_ST_WORD(*efgh, 3), CR_ST_WORD(*efgh, 2),
+        CR_ST_WORD(*abcd, 3), CR_ST_WORD(*abcd, 2),
+    };
+    uint32_t k[4];
+
+    crypto_state_to_words(k, wk);
+
+    /* After two rounds, CDGH is the previous ABEF */
+    sha256_rnds2(cdgh, cdgh, abef, k);
+    sha256_rnds2(abef, abef, cdgh, k + 2);
+
+    CR_ST_WORD(*abcd, 0) = abef[3];
+    CR_ST_WORD(*abcd, 1) = abef[2];
+    CR_ST_WORD(*abcd, 2) = cdgh[3];
+    CR_ST_WORD(*abcd, 3) = cdgh[2];
+    CR_ST_WORD(*efgh, 0) = abef[1];
+    CR_ST_WORD(*efgh, 1) = abef[0];
+    CR_ST_WORD(*efgh, 2) = cdgh[1];
+    CR_ST_WORD(*efgh, 3) = cdgh[0];
 }
 
 void HELPER(crypto_sha256h)(void *vd, void *vn, void *vm, uint32_t desc)
@@ -304,26 +333,8 @@ void HELPER(crypto_sha256h)(void *vd, void *vn, void *vm, uint32_t desc)
     union CRYPTO_STATE d = { .l = { rd[0], rd[1] } };
     union CRYPTO_STATE n = { .l = { rn[0], rn[1] } };
     union CRYPTO_STATE m = { .l = { rm[0], rm[1] } };
-    int i;
-
-    for (i = 0; i < 4; i++) {
-        uint32_t t = cho(CR_ST_WORD(n, 0), CR_ST_WORD(n, 1), CR_ST_WORD(n, 2))
-                     + CR_ST_WORD(n, 3) + S1(CR_ST_WORD(n, 0))
-                     + CR_ST_WORD(m, i);
-
-        CR_ST_WORD(n, 3) = CR_ST_WORD(n, 2);
-        CR_ST_WORD(n, 2) = CR_ST_WORD(n, 1);
-        CR_ST_WORD(n, 1) = CR_ST_WORD(n, 0);
-        CR_ST_WORD(n, 0) = CR_ST_WORD(d, 3) + t;
 
-        t += maj(CR_ST_WORD(d, 0), CR_ST_WORD(d, 1), CR_ST_WORD(d, 2))
-             + S0(CR_ST_WORD(d, 0));
-
-        CR_ST_WORD(d, 3) = CR_ST_WORD(d, 2);
-        CR_ST_WORD(d, 2) = CR_ST_WORD(d, 1);
-        CR_ST_WORD(d, 1) = CR_ST_WORD(d, 0);
-        CR_ST_WORD(d, 0) = t;
-    }
+    do_crypto_sha256_rnds4(&d, &n, &m);
 
     rd[0] = d.l[0];
     rd[1] = d.l[1];
@@ -339,18 +350,8 @@ void HELPER(crypto_sha256h2)(void *vd, void *vn, void *vm, uint32_t desc)
     union CRYPTO_STATE d = { .l = { rd[0], rd[1] } };
     union CRYPTO_STATE n = { .l = { rn[0], rn[1] } };
     union CRYPTO_STATE m = { .l = { rm[0], rm[1] } };
-    int i;
-
-    for (i = 0; i < 4; i++) {
-        uint32_t t = cho(CR_ST_WORD(d, 0), CR_ST_WORD(d, 1), CR_ST_WORD(d, 2))
-                     + CR_ST_WORD(d, 3) + S1(CR_ST_WORD(d, 0))
-                     + CR_ST_WORD(m, i);
 
-        CR_ST_WORD(d, 3) = CR_ST_WORD(d, 2);
-        CR_ST_WORD(d, 2) = CR_ST_WORD(d, 1);
-        CR_ST_WORD(d, 1) = CR_ST_WORD(d, 0);
-        CR_ST_WORD(d, 0) = CR_ST_WORD(n, 3 - i) + t;
-    }
+    do_crypto_sha256_rnds4(&n, &d, &m);
 
     rd[0] = d.l[0];
     rd[1] = d.l[1];
@@ -364,11 +365,12 @@ void HELPER(crypto_sha256su0)(void *vd, void *vm, uint32_t desc)
     uint64_t *rm = vm;
     union CRYPTO_STATE d = { .l = { rd[0], rd[1] } };
     union CRYPTO_STATE m = { .l = { rm[0], rm[1] } };
+    uint32_t w0[4], w4[4];
 
-    CR_ST_WORD(d, 0) += s0(CR_ST_WORD(d, 1));
-    CR_ST_WORD(d, 1) += s0(CR_ST_WORD(d, 2));
-    CR_ST_WORD(d, 2) += s0(CR_ST_WORD(d, 3));
-    CR_ST_WORD(d, 3) += s0(CR_ST_WORD(m, 0));
+    crypto_state_to_words(w0, &d);
+    crypto_state_to_words(w4, &m);
+    sha256_msg1(w0, w0, w4);
+    crypto_state_from_words(&d, w0);
 
     rd[0] = d.l[0];
     rd[1] = d.l[1];
@@ -384,11 +386,15 @@ void HELPER(crypto_sha256su1)(void *vd, void *vn, void *vm, uint32_t desc)
     union CRYPTO_STATE d = { .l = { rd[0], rd[1] } };
     union CRYPTO_STATE n = { .l = { rn[0], rn[1] } };
     union CRYPTO_STATE m = { .l = { rm[0], rm[1] } };
+    uint32_t x[4], w12[4];
 
-    CR_ST_WORD(d, 0) += s1(CR_ST_WORD(m, 2)) + CR_ST_WORD(n, 1);
-    CR_ST_WORD(d, 1) += s1(CR_ST_WORD(m, 3)) + CR_ST_WORD(n, 2);
-    CR_ST_WORD(d, 2) += s1(CR_ST_WORD(d, 0)) + CR_ST_WORD(n, 3);
-    CR_ST_WORD(d, 3) += s1(CR_ST_WORD(d, 1)) + CR_ST_WORD(m, 0);
+    crypto_state_to_words(w12, &m);
+    x[0] = CR_ST_WORD(d, 0) + CR_ST_WORD(n, 1);
+    x[1] = CR_ST_WORD(d, 1) + CR_ST_WORD(n, 2);
+    x[2] = CR_ST_WORD(d, 2) + CR_ST_WORD(n, 3);
+    x[3] = CR_ST_WORD(d, 3) + CR_ST_WORD(m, 0);
+    sha256_msg2(x, x, w12);
+    crypto_state_from_words(&d, x);
 
     rd[0] = d.l[0];
     rd[1] = d.l[1];
@@ -608,19 +614,12 @@ static void do_crypto_sm4e(uint64_t *rd, uint64_t *rn, uint64_t *rm)
 {
     union CRYPTO_STATE d = { .l = { rn[0], rn[1] } };
     union CRYPTO_STATE n = { .l = { rm[0], rm[1] } };
-    uint32_t t, i;
+    uint32_t x[4], rk[4];
 
-    for (i = 0; i < 4; i++) {
-        t = CR_ST_WORD(d, (i + 1) % 4) ^
-            CR_ST_WORD(d, (i + 2) % 4) ^
-            CR_ST_WORD(d, (i + 3) % 4) ^
-            CR_ST_WORD(n, i);
-
-        t = sm4_subword(t);
-
-        CR_ST_WORD(d, i) ^= t ^ rol32(t, 2) ^ rol32(t, 10) ^ rol32(t, 18) ^
-                            rol32(t, 24);
-    }
+    crypto_state_to_words(x, &d);
+    crypto_state_to_words(rk, &n);
+    sm4_rnds4(x, x, rk);
+    crypto_state_from_words(&d, x);
 
     rd[0] = d.l[0];
     rd[1] = d.l[1];
@@ -641,19 +640,12 @@ static void do_crypto_sm4ekey(uint64_t *rd, uint64_t *rn, uint64_t *rm)
     union CRYPTO_STATE d;
     union CRYPTO_STATE n = { .l = { rn[0], rn[1] } };
     union CRYPTO_STATE m = { .l = { rm[0], rm[1] } };
-    uint32_t t, i;
+    uint32_t k[4], ck[4];
 
-    d = n;
-    for (i = 0; i < 4; i++) {
-        t = CR_ST_WORD(d, (i + 1) % 4) ^
-            CR_ST_WORD(d, (i + 2) % 4) ^
-            CR_ST_WORD(d, (i + 3) % 4) ^
-            CR_ST_WORD(m, i);
-
-        t = sm4_subword(t);
-
-        CR_ST_WORD(d, i) ^= t ^ rol32(t, 13) ^ rol32(t, 23);
-    }
+    crypto_state_to_words(k, &n);
+    crypto_state_to_words(ck, &m);
+    sm4_ekey4(k, k, ck);
+    crypto_state_from_words(&d, k);
 
     rd[0] = d.l[0];
     rd[1] = d.l[1];
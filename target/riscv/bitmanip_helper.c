@@ -20,34 +20,21 @@
 
 #include "qemu/osdep.h"
 #include "qemu/host-utils.h"
+#include "crypto/clmul.h"
 #include "exec/target_long.h"
 #include "exec/helper-proto.h"
 #include "tcg/tcg.h"
 
 target_ulong HELPER(clmul)(target_ulong rs1, target_ulong rs2)
 {
-    target_ulong result = 0;
-
-    for (int i = 0; i < TARGET_LONG_BITS; i++) {
-        if ((rs2 >> i) & 1) {
-            result ^= (rs1 << i);
-        }
-    }
-
-    return result;
+    return int128_getlo(clmul_64(rs1, rs2));
 }
 
 target_ulong HELPER(clmulr)(target_ulong rs1, target_ulong rs2)
 {
-    target_ulong result = 0;
-
-    for (int i = 0; i < TARGET_LONG_BITS; i++) {
-        if ((rs2 >> i) & 1) {
-            result ^= (rs1 >> (TARGET_LONG_BITS - i - 1));
-        }
-    }
-
-    return result;
+    /* bits 2 * XLEN - 2 .. XLEN - 1 of the product */
+    return int128_getlo(int128_urshift(clmul_64(rs1, rs2),
+                                       TARGET_LONG_BITS - 1));
 }
 
 static inline target_ulong do_swap(target_ulong x, uint64_t mask, int shift)
@@ -304,6 +304,8 @@ static GDBFeature *ricsv_gen_dynamic_vector_feature(CPUState *cs, int base_reg)
 {
     RISCVCPU *cpu = RISCV_CPU(cs);
     int bitsize = cpu->cfg.vlenb << 3;
+    /* the quads view is only useful alongside 64-bit elements */
+    int max_lane = cpu->cfg.elen == 64 ? 128 : cpu->cfg.elen;
     GDBFeatureBuilder builder;
     int i;
 
@@ -311,9 +313,15 @@ static GDBFeature *ricsv_gen_dynamic_vector_feature(CPUState *cs, int base_reg)
                              "org.gnu.gdb.riscv.vector", "riscv-vector.xml",
                              base_reg);
 
-    /* First define types and totals in a whole VL */
+    /*
+     * First define types and totals in a whole VL. Lanes wider than
+     * the register or than the supported element width are left out.
+     */
     for (i = 0; i < ARRAY_SIZE(vec_lanes); i++) {
         int count = bitsize / vec_lanes[i].size;
+        if (!count || vec_lanes[i].size > max_lane) {
+            continue;
+        }
         gdb_feature_builder_append_tag(
             &builder, "<vector id=\"%s\" type=\"%s\" count=\"%d\"/>",
             vec_lanes[i].id, vec_lanes[i].gdb_type, count);
@@ -322,6 +330,9 @@ static GDBFeature *ricsv_gen_dynamic_vector_feature(CPUState *cs, int base_reg)
     /* Define unions */
     gdb_feature_builder_append_tag(&builder, "<union id=\"riscv_vector\">");
     for (i = 0; i < ARRAY_SIZE(vec_lanes); i++) {
+        if (vec_lanes[i].size > bitsize || vec_lanes[i].size > max_lane) {
+            continue;
+        }
         gdb_feature_builder_append_tag(&builder,
                                        "<field name=\"%c\" type=\"%s\"/>",
                                        vec_lanes[i].suffix, vec_lanes[i].id);
@@ -24,42 +24,80 @@
 #include "cpu.h"
 #include "crypto/aes.h"
 #include "crypto/aes-round.h"
+#include "crypto/clmul.h"
+#include "crypto/sha2-round.h"
 #include "crypto/sm4.h"
 #include "exec/memop.h"
 #include "exec/helper-proto.h"
 #include "internals.h"
 #include "vector_internals.h"
 
-static uint64_t clmul64(uint64_t y, uint64_t x)
+/*
+ * Unmasked operations hand the whole register group to clmul_64_vec(),
+ * which multiplies several elements per host instruction if it can.
+ */
+static void do_vclmul(void *vd, void *v0, const uint64_t *s1,
+                      size_t s1_stride, void *vs2, CPURISCVState *env,
+                      uint32_t desc, bool high)
 {
-    uint64_t result = 0;
-    for (int j = 63; j >= 0; j--) {
-        if ((y >> j) & 1) {
-            result ^= (x << j);
+    uint32_t vm = vext_vm(desc);
+    uint32_t vl = env->vl;
+    uint32_t esz = sizeof(uint64_t);
+    uint32_t total_elems = vext_get_total_elems(env, desc, esz);
+    uint32_t vta = vext_vta(desc);
+    uint32_t vma = vext_vma(desc);
+    uint64_t *d = vd;
+    const uint64_t *s2 = vs2;
+    uint32_t i = env->vstart;
+
+    VSTART_CHECK_EARLY_EXIT(env, vl);
+
+    if (vm) {
+        clmul_64_vec(high ? NULL : d + i, high ? d + i : NULL, s2 + i,
+                     s1 + i * s1_stride, s1_stride, vl - i);
+    } else {
+        for (; i < vl; i++) {
+            if (!vext_elem_mask(v0, i)) {
+                /* set masked-off elements to 1s */
+                vext_set_elems_1s(vd, vma, i * esz, (i + 1) * esz);
+                continue;
+            }
+            clmul_64_vec(high ? NULL : d + i, high ? d + i : NULL, s2 + i,
+                         s1 + i * s1_stride, 0, 1);
         }
     }
-    return result;
+    env->vstart = 0;
+    /* set tail elements to 1s */
+    vext_set_elems_1s(vd, vta, vl * esz, total_elems * esz);
 }
 
-static uint64_t clmulh64(uint64_t y, uint64_t x)
+void HELPER(vclmul_vv)(void *vd, void *v0, void *vs1, void *vs2,
+                       CPURISCVState *env, uint32_t desc)
 {
-    uint64_t result = 0;
-    for (int j = 63; j >= 1; j--) {
-        if ((y >> j) & 1) {
-            result ^= (x >> (64 - j));
-        }
-    }
-    return result;
+    do_vclmul(vd, v0, vs1, 1, vs2, env, desc, false);
 }
 
-RVVCALL(OPIVV2, vclmul_vv, OP_UUU_D, H8, H8, H8, clmul64)
-GEN_VEXT_VV(vclmul_vv, 8)
-RVVCALL(OPIVX2, vclmul_vx, OP_UUU_D, H8, H8, clmul64)
-GEN_VEXT_VX(vclmul_vx, 8)
-RVVCALL(OPIVV2, vclmulh_vv, OP_UUU_D, H8, H8, H8, clmulh64)
-GEN_VEXT_VV(vclmulh_vv, 8)
-RVVCALL(OPIVX2, vclmulh_vx, OP_UUU_D, H8, H8, clmulh64)
-GEN_VEXT_VX(vclmulh_vx, 8)
+void HELPER(vclmul_vx)(void *vd, void *v0, target_ulong s1, void *vs2,
+                       CPURISCVState *env, uint32_t desc)
+{
+    uint64_t x = (target_long)s1;
+
+    do_vclmul(vd, v0, &x, 0, vs2, env, desc, false);
+}
+
+void HELPER(vclmulh_vv)(void *vd, void *v0, void *vs1, void *vs2,
+                        CPURISCVState *env, uint32_t desc)
+{
+    do_vclmul(vd, v0, vs1, 1, vs2, env, desc, true);
+}
+
+void HELPER(vclmulh_vx)(void *vd, void *v0, target_ulong s1, void *vs2,
+                        CPURISCVState *env, uint32_t desc)
+{
+    uint64_t x = (target_long)s1;
+
+    do_vclmul(vd, v0, &x, 0, vs2, env, desc, true);
+}
 
 RVVCALL(OPIVV2, vror_vv_b, OP_UUU_B, H1, H1, H1, ror8)
 RVVCALL(OPIVV2, vror_vv_h, OP_UUU_H, H2, H2, H2, ror16)
@@ -406,14 +444,18 @@ void HELPER(vaeskf2_vi)(void *vd_vptr, void *vs2_vptr, uint32_t uimm,
     vext_set_elems_1s(vd, vta, vl * 4, total_elems * 4);
 }
 
-static inline uint32_t sig0_sha256(uint32_t x)
+static inline void vsha2_load_e32(uint32_t *w, const uint32_t *v)
 {
-    return ror32(x, 7) ^ ror32(x, 18) ^ (x >> 3);
+    for (int i = 0; i < 4; i++) {
+        w[i] = v[H4(i)];
+    }
 }
 
-static inline uint32_t sig1_sha256(uint32_t x)
+static inline void vsha2_store_e32(uint32_t *v, const uint32_t *w)
 {
-    return ror32(x, 17) ^ ror32(x, 19) ^ (x >> 10);
+    for (int i = 0; i < 4; i++) {
+        v[H4(i)] = w[i];
+    }
 }
 
 static inline uint64_t sig0_sha512(uint64_t x)
@@ -426,21 +468,26 @@ static inline uint64_t sig1_sha512(uint64_t x)
     return ror64(x, 19) ^ ror64(x, 61) ^ (x >> 6);
 }
 
+/*
+ * vd holds W[0..3], vs2 holds W[4], W[9..11] and vs1 holds W[12..15]:
+ * the host message schedule helpers only need W[9..12] added in between.
+ */
 static inline void vsha2ms_e32(uint32_t *vd, uint32_t *vs1, uint32_t *vs2)
 {
-    uint32_t res[4];
-    res[0] = sig1_sha256(vs1[H4(2)]) + vs2[H4(1)] + sig0_sha256(vd[H4(1)]) +
-             vd[H4(0)];
-    res[1] = sig1_sha256(vs1[H4(3)]) + vs2[H4(2)] + sig0_sha256(vd[H4(2)]) +
-             vd[H4(1)];
-    res[2] =
-        sig1_sha256(res[0]) + vs2[H4(3)] + sig0_sha256(vd[H4(3)]) + vd[H4(2)];
-    res[3] =
-        sig1_sha256(res[1]) + vs1[H4(0)] + sig0_sha256(vs2[H4(0)]) + vd[H4(3)];
-    vd[H4(3)] = res[3];
-    vd[H4(2)] = res[2];
-    vd[H4(1)] = res[1];
-    vd[H4(0)] = res[0];
+    uint32_t w0[4], w4[4], w12[4], x[4];
+
+    vsha2_load_e32(w0, vd);
+    vsha2_load_e32(w4, vs2);
+    vsha2_load_e32(w12, vs1);
+
+    sha256_msg1(x, w0, w4);
+    x[0] += w4[1];
+    x[1] += w4[2];
+    x[2] += w4[3];
+    x[3] += w12[0];
+    sha256_msg2(x, x, w12);
+
+    vsha2_store_e32(vd, x);
 }
 
 static inline void vsha2ms_e64(uint64_t *vd, uint64_t *vs1, uint64_t *vs2)
@@ -487,21 +534,11 @@ static inline uint64_t sum0_64(uint64_t x)
     return ror64(x, 28) ^ ror64(x, 34) ^ ror64(x, 39);
 }
 
-static inline uint32_t sum0_32(uint32_t x)
-{
-    return ror32(x, 2) ^ ror32(x, 13) ^ ror32(x, 22);
-}
-
 static inline uint64_t sum1_64(uint64_t x)
 {
     return ror64(x, 14) ^ ror64(x, 18) ^ ror64(x, 41);
 }
 
-static inline uint32_t sum1_32(uint32_t x)
-{
-    return ror32(x, 6) ^ ror32(x, 11) ^ ror32(x, 25);
-}
-
 #define ch(x, y, z) ((x & y) ^ ((~x) & z))
 
 #define maj(x, y, z) ((x & y) ^ (x & z) ^ (y & z))
@@ -540,38 +577,19 @@ static void vsha2c_64(uint64_t *vs2, uint64_t *vd, uint64_t *vs1)
     vd[3] = a;
 }
 
+/*
+ * vs2 holds {f, e, b, a} and vd holds {h, g, d, c}, the layout used by
+ * the host helpers, so both rounds map to a single sha256_rnds2().
+ */
 static void vsha2c_32(uint32_t *vs2, uint32_t *vd, uint32_t *vs1)
 {
-    uint32_t a = vs2[H4(3)], b = vs2[H4(2)], e = vs2[H4(1)], f = vs2[H4(0)];
-    uint32_t c = vd[H4(3)], d = vd[H4(2)], g = vd[H4(1)], h = vd[H4(0)];
-    uint32_t W0 = vs1[H4(0)], W1 = vs1[H4(1)];
-    uint32_t T1 = h + sum1_32(e) + ch(e, f, g) + W0;
-    uint32_t T2 = sum0_32(a) + maj(a, b, c);
-
-    h = g;
-    g = f;
-    f = e;
-    e = d + T1;
-    d = c;
-    c = b;
-    b = a;
-    a = T1 + T2;
+    uint32_t abef[4], cdgh[4];
+    uint32_t wk[2] = { vs1[H4(0)], vs1[H4(1)] };
 
-    T1 = h + sum1_32(e) + ch(e, f, g) + W1;
-    T2 = sum0_32(a) + maj(a, b, c);
-    h = g;
-    g = f;
-    f = e;
-    e = d + T1;
-    d = c;
-    c = b;
-    b = a;
-    a = T1 + T2;
-
-    vd[H4(0)] = f;
-    vd[H4(1)] = e;
-    vd[H4(2)] = b;
-    vd[H4(3)] = a;
+    vsha2_load_e32(abef, vs2);
+    vsha2_load_e32(cdgh, vd);
+    sha256_rnds2(abef, cdgh, abef, wk);
+    vsha2_store_e32(vd, abef);
 }
 
 void HELPER(vsha2ch32_vv)(void *vd, void *vs1, void *vs2, CPURISCVState *env,
@@ -807,22 +825,11 @@ void HELPER(vghsh_vv)(void *vd_vptr, void *vs1_vptr, void *vs2_vptr,
         uint64_t Y[2] = {vd[i * 2 + 0], vd[i * 2 + 1]};
         uint64_t H[2] = {brev8(vs2[i * 2 + 0]), brev8(vs2[i * 2 + 1])};
         uint64_t X[2] = {vs1[i * 2 + 0], vs1[i * 2 + 1]};
-        uint64_t Z[2] = {0, 0};
+        uint64_t Z[2];
 
         uint64_t S[2] = {brev8(Y[0] ^ X[0]), brev8(Y[1] ^ X[1])};
 
-        for (int j = 0; j < 128; j++) {
-            if ((S[j / 64] >> (j % 64)) & 1) {
-                Z[0] ^= H[0];
-                Z[1] ^= H[1];
-            }
-            bool reduce = ((H[1] >> 63) & 1);
-            H[1] = H[1] << 1 | H[0] >> 63;
-            H[0] = H[0] << 1;
-            if (reduce) {
-                H[0] ^= 0x87;
-            }
-        }
+        clmul_gf128_mul(Z, S, H);
 
         vd[i * 2 + 0] = brev8(Z[0]);
         vd[i * 2 + 1] = brev8(Z[1]);
@@ -845,20 +852,9 @@ void HELPER(vgmul_vv)(void *vd_vptr, void *vs2_vptr, CPURISCVState *env,
     for (uint32_t i = env->vstart / 4; i < env->vl / 4; i++) {
         uint64_t Y[2] = {brev8(vd[i * 2 + 0]), brev8(vd[i * 2 + 1])};
         uint64_t H[2] = {brev8(vs2[i * 2 + 0]), brev8(vs2[i * 2 + 1])};
-        uint64_t Z[2] = {0, 0};
+        uint64_t Z[2];
 
-        for (int j = 0; j < 128; j++) {
-            if ((Y[j / 64] >> (j % 64)) & 1) {
-                Z[0] ^= H[0];
-                Z[1] ^= H[1];
-            }
-            bool reduce = ((H[1] >> 63) & 1);
-            H[1] = H[1] << 1 | H[0] >> 63;
-            H[0] = H[0] << 1;
-            if (reduce) {
-                H[0] ^= 0x87;
-            }
-        }
+        clmul_gf128_mul(Z, Y, H);
 
         vd[i * 2 + 0] = brev8(Z[0]);
         vd[i * 2 + 1] = brev8(Z[1]);
@@ -890,18 +886,7 @@ void HELPER(vsm4k_vi)(void *vd, void *vs2, uint32_t uimm5, CPURISCVState *env,
             rk[j - vstart] = *((uint32_t *)vs2 + H4(j));
         }
 
-        for (uint32_t j = 0; j < egs; ++j) {
-            tmp[j] = rk[j];
-        }
-
-        for (uint32_t j = 0; j < egs; ++j) {
-            uint32_t b, s;
-            b = tmp[j + 1] ^ tmp[j + 2] ^ tmp[j + 3] ^ sm4_ck[rnd * 4 + j];
-
-            s = sm4_subword(b);
-
-            tmp[j + 4] = tmp[j] ^ (s ^ rol32(s, 13) ^ rol32(s, 23));
-        }
+        sm4_ekey4(tmp + egs, rk, &sm4_ck[rnd * 4]);
 
         for (uint32_t j = vstart; j < vend; ++j) {
             *((uint32_t *)vd + H4(j)) = tmp[egs + (j - vstart)];
@@ -915,17 +900,7 @@ void HELPER(vsm4k_vi)(void *vd, void *vs2, uint32_t uimm5, CPURISCVState *env,
 
 static void do_sm4_round(uint32_t *rk, uint32_t *buf)
 {
-    const uint32_t egs = 4;
-    uint32_t s, b;
-
-    for (uint32_t j = egs; j < egs * 2; ++j) {
-        b = buf[j - 3] ^ buf[j - 2] ^ buf[j - 1] ^ rk[j - 4];
-
-        s = sm4_subword(b);
-
-        buf[j] = buf[j - 4] ^ (s ^ rol32(s, 2) ^ rol32(s, 10) ^ rol32(s, 18) ^
-                               rol32(s, 24));
-    }
+    sm4_rnds4(buf + 4, buf, rk);
 }
 
 void HELPER(vsm4r_vv)(void *vd, void *vs2, CPURISCVState *env, uint32_t desc)
@@ -0,0 +1,77 @@
+/*
+ * QEMU carry-less multiply speed benchmark
+ *
+ * Copyright (c) 2025 The QEMU Project Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include "qemu/osdep.h"
+#include "crypto/clmul.h"
+
+/* one element, and a 2048-bit vector register group at LMUL=8 */
+static const size_t sizes[] = { 1, 4, 32, 256 };
+
+static void test_gen(void)
+{
+    uint64_t a = 0x9e3779b97f4a7c15ull, b = 0xbf58476d1ce4e5b9ull;
+    double total = 0.0;
+
+    g_test_timer_start();
+    do {
+        for (int i = 0; i < 1000; i++) {
+            Int128 r = clmul_64_gen(a, b);
+
+            a = int128_getlo(r) ^ int128_gethi(r);
+        }
+        total += 1000;
+    } while (g_test_timer_elapsed() < 0.5);
+
+    g_test_message("clmul_64_gen: %8.1f Mmul/sec %" PRIx64,
+                   total / g_test_timer_last() / 1e6, a);
+}
+
+static void test_vec(void)
+{
+    size_t max = sizes[ARRAY_SIZE(sizes) - 1];
+    uint64_t *a = g_new(uint64_t, max);
+    uint64_t *b = g_new(uint64_t, max);
+    uint64_t *lo = g_new(uint64_t, max);
+    uint64_t *hi = g_new(uint64_t, max);
+
+    for (size_t i = 0; i < max; i++) {
+        a[i] = i * 0x9e3779b97f4a7c15ull;
+        b[i] = i * 0xbf58476d1ce4e5b9ull;
+    }
+
+    g_test_message("host clmul: %s, 4-way: %s",
+                   HAVE_CLMUL_ACCEL ? "yes" : "no",
+                   HAVE_CLMUL_X4_ACCEL ? "yes" : "no");
+    for (size_t i = 0; i < ARRAY_SIZE(sizes); i++) {
+        size_t n = sizes[i];
+        double total = 0.0;
+
+        g_test_timer_start();
+        do {
+            for (int j = 0; j < 100; j++) {
+                clmul_64_vec(lo, hi, a, b, 1, n);
+            }
+            total += 100 * n;
+        } while (g_test_timer_elapsed() < 0.5);
+
+        g_test_message("clmul_64_vec: %3zu elements %8.1f Mmul/sec",
+                       n, total / g_test_timer_last() / 1e6);
+    }
+
+    g_free(a);
+    g_free(b);
+    g_free(lo);
+    g_free(hi);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/clmul/gen", test_gen);
+    g_test_add_func("/clmul/vec", test_vec);
+    return g_test_run();
+}
@@ -0,0 +1,87 @@
+/*
+ * QEMU framebuffer comparison and pixel conversion speed benchmark
+ *
+ * Copyright (c) 2025 The QEMU Project Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include "qemu/osdep.h"
+#include "qemu/pixel-ops.h"
+#include "qemu/units.h"
+
+/* A line of a 4K framebuffer, and a whole one */
+#define LINE_PIXELS     3840
+#define FB_PIXELS       (3840 * 2160)
+
+typedef void BenchFunc(void *dst, const void *src, size_t n);
+
+static void bench_find_diff(void *dst, const void *src, size_t n)
+{
+    buffer_find_diff(dst, src, n * 4);
+}
+
+static void bench_to_rgb565(void *dst, const void *src, size_t n)
+{
+    pixel_rgb888_to_rgb565(dst, src, n);
+}
+
+static void bench_from_rgb565(void *dst, const void *src, size_t n)
+{
+    pixel_rgb565_to_rgb888(dst, src, n);
+}
+
+static void bench_swap_rb(void *dst, const void *src, size_t n)
+{
+    pixel_swap_rb(dst, src, n);
+}
+
+static const struct {
+    const char *name;
+    BenchFunc *fn;
+} benchs[] = {
+    { "find_diff", bench_find_diff },
+    { "rgb888_to_rgb565", bench_to_rgb565 },
+    { "rgb565_to_rgb888", bench_from_rgb565 },
+    { "swap_rb", bench_swap_rb },
+};
+
+static void test(void)
+{
+    static const size_t sizes[] = { LINE_PIXELS, FB_PIXELS };
+    void *src = g_malloc0(FB_PIXELS * 4);
+    void *dst = g_malloc0(FB_PIXELS * 4);
+    int accel_index = 0;
+
+    do {
+        if (accel_index != 0) {
+            g_test_message("%s", "");  /* gnu_printf Werror for simple "" */
+        }
+        for (size_t i = 0; i < ARRAY_SIZE(benchs); i++) {
+            for (size_t j = 0; j < ARRAY_SIZE(sizes); j++) {
+                size_t n = sizes[j];
+                double total = 0.0;
+
+                g_test_timer_start();
+                do {
+                    benchs[i].fn(dst, src, n);
+                    total += n;
+                } while (g_test_timer_elapsed() < 0.5);
+
+                g_test_message("%s #%d: %7zu pixels %8.0f Mpixels/sec",
+                               benchs[i].name, accel_index, n,
+                               total / MiB / g_test_timer_last());
+            }
+        }
+        accel_index++;
+    } while (test_pixel_ops_next_accel());
+
+    g_free(src);
+    g_free(dst);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/pixel-ops/speed", test);
+    return g_test_run();
+}
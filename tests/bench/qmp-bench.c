@@ -0,0 +1,181 @@
+/*
+ * QEMU QMP JSON speed benchmark
+ *
+ * Measures the JSON work done for a QMP exchange: parsing a stream of
+ * commands, and emitting a statistics reply through a QObject tree and
+ * qobject_to_json() the way the QMP marshallers do.
+ *
+ * Copyright (c) 2025 The QEMU Project Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include "qemu/osdep.h"
+#include "qapi/error.h"
+#include "qapi/visitor.h"
+#include "qapi/qobject-output-visitor.h"
+#include "qobject/json-parser.h"
+#include "qobject/qjson.h"
+#include "qobject/qobject.h"
+
+#define BENCH_DEVICES   64
+#define BENCH_COUNTERS  24
+
+static const char bench_command[] =
+    "{ \"execute\": \"query-blockstats\", "
+    "\"arguments\": { \"query-nodes\": true, \"id\": \"drive-virtio-disk0\" }, "
+    "\"id\": 123456 }\n";
+
+typedef struct BenchDevice {
+    char *device;
+    char *node_name;
+    bool account_failed;
+    int64_t counters[BENCH_COUNTERS];
+} BenchDevice;
+
+typedef struct BenchDeviceList {
+    struct BenchDeviceList *next;
+    BenchDevice *value;
+} BenchDeviceList;
+
+static const char *const counter_names[BENCH_COUNTERS] = {
+    "rd_bytes", "wr_bytes", "zone_append_bytes", "unmap_bytes",
+    "rd_operations", "wr_operations", "zone_append_operations",
+    "flush_operations", "unmap_operations", "rd_total_time_ns",
+    "wr_total_time_ns", "zone_append_total_time_ns",
+    "flush_total_time_ns", "unmap_total_time_ns", "wr_highest_offset",
+    "rd_merged", "wr_merged", "zone_append_merged", "unmap_merged",
+    "failed_rd_operations", "failed_wr_operations",
+    "invalid_rd_operations", "invalid_wr_operations", "idle_time_ns",
+};
+
+static size_t parsed_messages;
+
+static void bench_emit(void *opaque, QObject *json, Error *err)
+{
+    assert(json && !err);
+    qobject_unref(json);
+    parsed_messages++;
+}
+
+static void test_parse(void)
+{
+    JSONMessageParser parser;
+    size_t len = strlen(bench_command);
+    double bytes = 0.0;
+
+    parsed_messages = 0;
+    json_message_parser_init(&parser, bench_emit, NULL, NULL);
+
+    g_test_timer_start();
+    do {
+        for (int i = 0; i < 1000; i++) {
+            json_message_parser_feed(&parser, bench_command, len);
+        }
+        bytes += 1000 * len;
+    } while (g_test_timer_elapsed() < 0.5);
+
+    json_message_parser_destroy(&parser);
+
+    g_test_message("parse: %8.1f Kmsg/sec %8.1f MB/sec",
+                   parsed_messages / g_test_timer_last() / 1e3,
+                   bytes / g_test_timer_last() / 1e6);
+}
+
+static void visit_bench_device(Visitor *v, BenchDevice *dev)
+{
+    visit_start_struct(v, NULL, NULL, 0, &error_abort);
+    visit_type_str(v, "device", &dev->device, &error_abort);
+    visit_type_str(v, "node-name", &dev->node_name, &error_abort);
+    visit_type_bool(v, "account_failed", &dev->account_failed, &error_abort);
+    for (int i = 0; i < BENCH_COUNTERS; i++) {
+        visit_type_int(v, counter_names[i], &dev->counters[i], &error_abort);
+    }
+    visit_check_struct(v, &error_abort);
+    visit_end_struct(v, NULL);
+}
+
+static void visit_bench_reply(Visitor *v, BenchDeviceList **list)
+{
+    GenericList *tail;
+
+    visit_start_list(v, NULL, (GenericList **)list, sizeof(**list),
+                     &error_abort);
+    for (tail = (GenericList *)*list; tail;
+         tail = visit_next_list(v, tail, sizeof(**list))) {
+        visit_bench_device(v, ((BenchDeviceList *)tail)->value);
+    }
+    visit_check_list(v, &error_abort);
+    visit_end_list(v, (void **)list);
+}
+
+static BenchDeviceList *bench_reply_new(void)
+{
+    BenchDeviceList *head = NULL;
+
+    for (int i = BENCH_DEVICES - 1; i >= 0; i--) {
+        BenchDeviceList *elt = g_new0(BenchDeviceList, 1);
+        BenchDevice *dev = g_new0(BenchDevice, 1);
+
+        dev->device = g_strdup_printf("drive-virtio-disk%d", i);
+        dev->node_name = g_strdup_printf("#block%03d", i);
+        dev->account_failed = true;
+        for (int j = 0; j < BENCH_COUNTERS; j++) {
+            dev->counters[j] = (int64_t)(i + 1) * 0x9e3779b9 * (j + 1);
+        }
+        elt->value = dev;
+        elt->next = head;
+        head = elt;
+    }
+    return head;
+}
+
+static void bench_reply_free(BenchDeviceList *list)
+{
+    while (list) {
+        BenchDeviceList *next = list->next;
+
+        g_free(list->value->device);
+        g_free(list->value->node_name);
+        g_free(list->value);
+        g_free(list);
+        list = next;
+    }
+}
+
+static void test_output(void)
+{
+    BenchDeviceList *list = bench_reply_new();
+    double total = 0.0, bytes = 0.0;
+
+    g_test_timer_start();
+    do {
+        for (int i = 0; i < 100; i++) {
+            QObject *obj = NULL;
+            Visitor *v = qobject_output_visitor_new(&obj);
+            GString *json;
+
+            visit_bench_reply(v, &list);
+            visit_complete(v, &obj);
+            json = qobject_to_json(obj);
+            bytes += json->len;
+            g_string_free(json, true);
+            qobject_unref(obj);
+            visit_free(v);
+        }
+        total += 100;
+    } while (g_test_timer_elapsed() < 0.5);
+
+    g_test_message("output: %8.1f Kreplies/sec %8.1f MB/sec",
+                   total / g_test_timer_last() / 1e3,
+                   bytes / g_test_timer_last() / 1e6);
+
+    bench_reply_free(list);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/qmp/parse", test_parse);
+    g_test_add_func("/qmp/output", test_output);
+    return g_test_run();
+}
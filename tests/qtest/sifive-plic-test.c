@@ -0,0 +1,144 @@
+/*
+ * QTest testcase for the SiFive PLIC claim/complete logic
+ *
+ * The UART of the virt machine is used as interrupt source: enabling its
+ * transmit holding register empty interrupt raises the line right away.
+ *
+ * Copyright (c) 2025 The QEMU Project Developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+
+#define PLIC_BASE           0xc000000
+#define PLIC_PRIORITY(irq)  (PLIC_BASE + (irq) * 4)
+#define PLIC_ENABLE(ctx)    (PLIC_BASE + 0x2000 + (ctx) * 0x80)
+#define PLIC_THRESHOLD(ctx) (PLIC_BASE + 0x200000 + (ctx) * 0x1000)
+#define PLIC_CLAIM(ctx)     (PLIC_THRESHOLD(ctx) + 4)
+
+#define UART_BASE           0x10000000
+#define UART_IER            (UART_BASE + 1)
+#define UART_IER_THRI       0x02
+#define UART_IRQ            10
+
+/* context 0 is the M-mode context of hart 0 */
+#define CTX                 0
+
+static void uart_raise(QTestState *qts)
+{
+    qtest_writeb(qts, UART_IER, 0);
+    qtest_writeb(qts, UART_IER, UART_IER_THRI);
+}
+
+static uint32_t plic_claim(QTestState *qts)
+{
+    return qtest_readl(qts, PLIC_CLAIM(CTX));
+}
+
+static void plic_complete(QTestState *qts, uint32_t irq)
+{
+    qtest_writel(qts, PLIC_CLAIM(CTX), irq);
+}
+
+static QTestState *plic_init(void)
+{
+    QTestState *qts = qtest_init("-machine virt");
+
+    qtest_writel(qts, PLIC_PRIORITY(UART_IRQ), 1);
+    qtest_writel(qts, PLIC_ENABLE(CTX), 1U << UART_IRQ);
+    qtest_writel(qts, PLIC_THRESHOLD(CTX), 0);
+    return qts;
+}
+
+static void test_claim_complete(void)
+{
+    QTestState *qts = plic_init();
+
+    uart_raise(qts);
+    g_assert_cmpuint(plic_claim(qts), ==, UART_IRQ);
+    /* claimed sources are not returned again until completed */
+    g_assert_cmpuint(plic_claim(qts), ==, 0);
+    plic_complete(qts, UART_IRQ);
+    g_assert_cmpuint(plic_claim(qts), ==, 0);
+
+    uart_raise(qts);
+    g_assert_cmpuint(plic_claim(qts), ==, UART_IRQ);
+    plic_complete(qts, UART_IRQ);
+
+    qtest_quit(qts);
+}
+
+static void test_threshold(void)
+{
+    QTestState *qts = plic_init();
+
+    uart_raise(qts);
+    qtest_writel(qts, PLIC_THRESHOLD(CTX), 1);
+    g_assert_cmpuint(plic_claim(qts), ==, 0);
+    qtest_writel(qts, PLIC_THRESHOLD(CTX), 0);
+    g_assert_cmpuint(plic_claim(qts), ==, UART_IRQ);
+    plic_complete(qts, UART_IRQ);
+
+    qtest_quit(qts);
+}
+
+static void test_enable_priority(void)
+{
+    QTestState *qts = plic_init();
+
+    uart_raise(qts);
+    qtest_writel(qts, PLIC_ENABLE(CTX), 0);
+    g_assert_cmpuint(plic_claim(qts), ==, 0);
+    qtest_writel(qts, PLIC_ENABLE(CTX), 1U << UART_IRQ);
+    qtest_writel(qts, PLIC_PRIORITY(UART_IRQ), 0);
+    g_assert_cmpuint(plic_claim(qts), ==, 0);
+    qtest_writel(qts, PLIC_PRIORITY(UART_IRQ), 7);
+    g_assert_cmpuint(plic_claim(qts), ==, UART_IRQ);
+    plic_complete(qts, UART_IRQ);
+
+    qtest_quit(qts);
+}
+
+/* Only run with -m perf: claim/complete round trips per second */
+static void test_claim_rate(void)
+{
+    QTestState *qts = plic_init();
+    const int iterations = 20000;
+    gint64 start = g_get_monotonic_time();
+    double secs;
+
+    for (int i = 0; i < iterations; i++) {
+        uart_raise(qts);
+        g_assert_cmpuint(plic_claim(qts), ==, UART_IRQ);
+        plic_complete(qts, UART_IRQ);
+    }
+    secs = (g_get_monotonic_time() - start) / 1e6;
+    g_test_minimized_result(secs / iterations * 1e6,
+                            "%d claims in %.3fs", iterations, secs);
+
+    qtest_quit(qts);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("/sifive-plic/claim-complete", test_claim_complete);
+    qtest_add_func("/sifive-plic/threshold", test_threshold);
+    qtest_add_func("/sifive-plic/enable-priority", test_enable_priority);
+    if (g_test_perf()) {
+        qtest_add_func("/sifive-plic/claim-rate", test_claim_rate);
+    }
+
+    return g_test_run();
+}
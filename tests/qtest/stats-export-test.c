@@ -0,0 +1,214 @@
+/*
+ * QTest testcase for the shared memory statistics export
+ *
+ * Copyright (c) 2025 The QEMU Project Developers
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/atomic.h"
+#include "libqtest.h"
+#include "qobject/qdict.h"
+#include "qobject/qlist.h"
+#include "qobject/qnum.h"
+
+/* Layout from docs/interop/stats-export.rst */
+#define STATS_EXPORT_MAGIC      0x41545351
+#define STATS_EXPORT_VERSION    1
+#define STATS_EXPORT_NO_STRING  UINT32_MAX
+
+typedef struct StatsExportHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t seq;
+    uint32_t generation;
+    uint64_t size;
+    uint64_t timestamp;
+    uint32_t nr_desc;
+    uint32_t desc_offset;
+    uint32_t strings_offset;
+    uint32_t values_offset;
+    uint32_t nr_values;
+    uint32_t interval;
+    uint64_t reserved;
+} StatsExportHeader;
+
+typedef struct StatsExportDesc {
+    uint32_t name;
+    uint32_t qom_path;
+    uint32_t value_index;
+    uint32_t nr_values;
+    uint8_t provider;
+    uint8_t target;
+    uint8_t type;
+    uint8_t unit;
+    int8_t base;
+    uint8_t flags;
+    int16_t exponent;
+    uint32_t bucket_size;
+    uint32_t reserved;
+} StatsExportDesc;
+
+QEMU_BUILD_BUG_ON(sizeof(StatsExportHeader) != 64);
+QEMU_BUILD_BUG_ON(sizeof(StatsExportDesc) != 32);
+
+/* StatsProvider and StatsTarget values of the cryptodev statistics */
+#define PROVIDER_CRYPTODEV      1
+#define TARGET_CRYPTODEV        2
+
+/* Take a consistent copy of the region, following the seqlock protocol */
+static uint8_t *stats_export_snapshot(const uint8_t *region, size_t size)
+{
+    const StatsExportHeader *hdr = (const StatsExportHeader *)region;
+    uint8_t *copy = g_malloc(size);
+    uint32_t seq;
+
+    do {
+        seq = qatomic_load_acquire(&hdr->seq);
+        if (seq & 1) {
+            g_usleep(1000);
+            continue;
+        }
+        memcpy(copy, region, size);
+        smp_rmb();
+    } while ((seq & 1) || qatomic_read(&hdr->seq) != seq);
+
+    return copy;
+}
+
+static const StatsExportDesc *find_desc(const uint8_t *region,
+                                        const char *qom_path,
+                                        const char *name)
+{
+    const StatsExportHeader *hdr = (const StatsExportHeader *)region;
+    const StatsExportDesc *desc =
+        (const StatsExportDesc *)(region + hdr->desc_offset);
+    const char *strings = (const char *)region + hdr->strings_offset;
+
+    for (uint32_t i = 0; i < hdr->nr_desc; i++, desc++) {
+        if (desc->qom_path == STATS_EXPORT_NO_STRING) {
+            continue;
+        }
+        if (g_str_equal(strings + desc->name, name) &&
+            g_str_equal(strings + desc->qom_path, qom_path)) {
+            return desc;
+        }
+    }
+    return NULL;
+}
+
+static void test_stats_export(void)
+{
+    QTestState *qts;
+    QDict *rsp, *ret;
+    QList *results;
+    QListEntry *entry;
+    g_autofree char *path = NULL;
+    g_autofree uint8_t *copy = NULL;
+    const StatsExportHeader *hdr;
+    const uint64_t *values;
+    uint32_t nr_stats = 0;
+    void *region;
+    size_t size;
+    int fd;
+
+    qts = qtest_init("-machine none "
+                     "-object cryptodev-backend-builtin,id=cryptodev0");
+
+    rsp = qtest_qmp(qts, "{ 'execute': 'stats-export-start',"
+                    "  'arguments': { 'interval': 60000 } }");
+    ret = qdict_get_qdict(rsp, "return");
+    g_assert(ret);
+    fd = qdict_get_int(ret, "fd");
+    size = qdict_get_int(ret, "size");
+    g_assert_cmpuint(qdict_get_int(ret, "interval"), ==, 60000);
+    g_assert_cmpuint(size, >=, sizeof(StatsExportHeader));
+    qobject_unref(rsp);
+
+    /* the memfd belongs to QEMU, reach it through its /proc entry */
+    path = g_strdup_printf("/proc/%d/fd/%d", (int)qtest_pid(qts), fd);
+    fd = open(path, O_RDONLY);
+    g_assert(fd >= 0);
+    region = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    g_assert(region != MAP_FAILED);
+    close(fd);
+
+    copy = stats_export_snapshot(region, size);
+    hdr = (const StatsExportHeader *)copy;
+    g_assert_cmphex(hdr->magic, ==, STATS_EXPORT_MAGIC);
+    g_assert_cmpuint(hdr->version, ==, STATS_EXPORT_VERSION);
+    g_assert_cmpuint(hdr->seq % 2, ==, 0);
+    g_assert_cmpuint(hdr->seq, >, 0);
+    g_assert_cmpuint(hdr->size, ==, size);
+    g_assert_cmpuint(hdr->interval, ==, 60000);
+    g_assert_cmpuint(hdr->desc_offset, ==, sizeof(StatsExportHeader));
+    g_assert_cmpuint(hdr->strings_offset, ==,
+                     hdr->desc_offset + hdr->nr_desc * sizeof(StatsExportDesc));
+    g_assert_cmpuint(hdr->values_offset % sizeof(uint64_t), ==, 0);
+    g_assert_cmpuint(hdr->values_offset + hdr->nr_values * sizeof(uint64_t),
+                     <=, size);
+    values = (const uint64_t *)(copy + hdr->values_offset);
+
+    /* every cryptodev statistic has a descriptor holding its value */
+    rsp = qtest_qmp(qts, "{ 'execute': 'query-stats',"
+                    "  'arguments': { 'target': 'cryptodev' } }");
+    results = qdict_get_qlist(rsp, "return");
+    g_assert(results);
+    QLIST_FOREACH_ENTRY(results, entry) {
+        QDict *result = qobject_to(QDict, qlist_entry_obj(entry));
+        const char *qom_path = qdict_get_str(result, "qom-path");
+        QListEntry *stat;
+
+        QLIST_FOREACH_ENTRY(qdict_get_qlist(result, "stats"), stat) {
+            QDict *stats = qobject_to(QDict, qlist_entry_obj(stat));
+            const char *name = qdict_get_str(stats, "name");
+            const StatsExportDesc *desc = find_desc(copy, qom_path, name);
+
+            g_assert(desc);
+            g_assert_cmpuint(desc->provider, ==, PROVIDER_CRYPTODEV);
+            g_assert_cmpuint(desc->target, ==, TARGET_CRYPTODEV);
+            g_assert_cmpuint(desc->nr_values, ==, 1);
+            g_assert_cmpuint(desc->value_index, <, hdr->nr_values);
+            g_assert_cmpuint(values[desc->value_index], ==,
+                             qdict_get_int(stats, "value"));
+            nr_stats++;
+        }
+    }
+    g_assert_cmpuint(nr_stats, >, 0);
+    g_assert_cmpuint(hdr->nr_desc, ==, nr_stats);
+    qobject_unref(rsp);
+
+    munmap(region, size);
+
+    qtest_qmp_assert_success(qts, "{ 'execute': 'stats-export-stop' }");
+    rsp = qtest_qmp(qts, "{ 'execute': 'stats-export-stop' }");
+    g_assert(qdict_haskey(rsp, "error"));
+    qobject_unref(rsp);
+
+    qtest_quit(qts);
+}
+
+static void test_stats_export_interval(void)
+{
+    QTestState *qts = qtest_init("-machine none");
+    QDict *rsp;
+
+    rsp = qtest_qmp(qts, "{ 'execute': 'stats-export-start',"
+                    "  'arguments': { 'interval': 1 } }");
+    g_assert(qdict_haskey(rsp, "error"));
+    qobject_unref(rsp);
+
+    qtest_quit(qts);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("/stats-export/region", test_stats_export);
+    qtest_add_func("/stats-export/interval", test_stats_export_interval);
+
+    return g_test_run();
+}
@@ -0,0 +1,148 @@
+/*
+ * Check the SHA256H, SHA256H2, SHA256SU0 and SHA256SU1 instructions
+ * against a plain C SHA-256 on pseudo-random messages.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arm_neon.h>
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t H0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+static uint32_t ror(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+static uint32_t load_be32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static void block_c(uint32_t *h, const uint8_t *p)
+{
+    uint32_t w[64], s[8];
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = load_be32(p + i * 4);
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^
+                      (w[i - 15] >> 3);
+        uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^
+                      (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    memcpy(s, h, sizeof(s));
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = s[7] + (ror(s[4], 6) ^ ror(s[4], 11) ^ ror(s[4], 25)) +
+                      ((s[4] & s[5]) ^ (~s[4] & s[6])) + K[i] + w[i];
+        uint32_t t2 = (ror(s[0], 2) ^ ror(s[0], 13) ^ ror(s[0], 22)) +
+                      ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+
+        memmove(s + 1, s, sizeof(uint32_t) * 7);
+        s[4] += t1;
+        s[0] = t1 + t2;
+    }
+    for (int i = 0; i < 8; i++) {
+        h[i] += s[i];
+    }
+}
+
+static void block_insn(uint32_t *h, const uint8_t *p)
+{
+    uint32x4_t abcd = vld1q_u32(h);
+    uint32x4_t efgh = vld1q_u32(h + 4);
+    uint32x4_t abcd0 = abcd, efgh0 = efgh;
+    uint32x4_t msg[4];
+
+    for (int i = 0; i < 4; i++) {
+        msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p + i * 16)));
+    }
+
+    for (int i = 0; i < 16; i++) {
+        uint32x4_t wk = vaddq_u32(msg[i % 4], vld1q_u32(&K[i * 4]));
+        uint32x4_t tmp = abcd;
+
+        if (i < 12) {
+            msg[i % 4] = vsha256su1q_u32(vsha256su0q_u32(msg[i % 4],
+                                                         msg[(i + 1) % 4]),
+                                         msg[(i + 2) % 4], msg[(i + 3) % 4]);
+        }
+        abcd = vsha256hq_u32(abcd, efgh, wk);
+        efgh = vsha256h2q_u32(efgh, tmp, wk);
+    }
+
+    vst1q_u32(h, vaddq_u32(abcd, abcd0));
+    vst1q_u32(h + 4, vaddq_u32(efgh, efgh0));
+}
+
+int main(void)
+{
+    uint8_t block[64];
+    uint32_t hc[8], hi[8];
+    uint32_t seed = 1;
+    int errors = 0;
+
+    /* "abc" from FIPS 180-2 appendix B.1, padded by hand */
+    static const uint32_t abc[8] = {
+        0xba7816bf, 0x8f01cfea, 0x414140de, 0x5dae2223,
+        0xb00361a3, 0x96177a9c, 0xb410ff61, 0xf20015ad,
+    };
+
+    memset(block, 0, sizeof(block));
+    memcpy(block, "abc\x80", 4);
+    block[63] = 24;
+    memcpy(hi, H0, sizeof(hi));
+    block_insn(hi, block);
+    if (memcmp(hi, abc, sizeof(abc))) {
+        fprintf(stderr, "sha256(\"abc\") mismatch\n");
+        errors++;
+    }
+
+    /* chain blocks so that each one starts from a different state */
+    memcpy(hc, H0, sizeof(hc));
+    memcpy(hi, H0, sizeof(hi));
+    for (int n = 0; n < 1000; n++) {
+        for (int i = 0; i < sizeof(block); i++) {
+            seed = seed * 1103515245 + 12345;
+            block[i] = seed >> 16;
+        }
+        block_c(hc, block);
+        block_insn(hi, block);
+        if (memcmp(hc, hi, sizeof(hc))) {
+            fprintf(stderr, "block %d mismatch\n", n);
+            errors++;
+            memcpy(hi, hc, sizeof(hi));
+        }
+    }
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+/*
+ * Check the SM4E and SM4EKEY instructions against a plain C SM4 on
+ * pseudo-random keys and blocks.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arm_neon.h>
+
+static const uint8_t sbox[256] = {
+    0xd6, 0x90, 0xe9, 0xfe, 0xcc, 0xe1, 0x3d, 0xb7,
+    0x16, 0xb6, 0x14, 0xc2, 0x28, 0xfb, 0x2c, 0x05,
+    0x2b, 0x67, 0x9a, 0x76, 0x2a, 0xbe, 0x04, 0xc3,
+    0xaa, 0x44, 0x13, 0x26, 0x49, 0x86, 0x06, 0x99,
+    0x9c, 0x42, 0x50, 0xf4, 0x91, 0xef, 0x98, 0x7a,
+    0x33, 0x54, 0x0b, 0x43, 0xed, 0xcf, 0xac, 0x62,
+    0xe4, 0xb3, 0x1c, 0xa9, 0xc9, 0x08, 0xe8, 0x95,
+    0x80, 0xdf, 0x94, 0xfa, 0x75, 0x8f, 0x3f, 0xa6,
+    0x47, 0x07, 0xa7, 0xfc, 0xf3, 0x73, 0x17, 0xba,
+    0x83, 0x59, 0x3c, 0x19, 0xe6, 0x85, 0x4f, 0xa8,
+    0x68, 0x6b, 0x81, 0xb2, 0x71, 0x64, 0xda, 0x8b,
+    0xf8, 0xeb, 0x0f, 0x4b, 0x70, 0x56, 0x9d, 0x35,
+    0x1e, 0x24, 0x0e, 0x5e, 0x63, 0x58, 0xd1, 0xa2,
+    0x25, 0x22, 0x7c, 0x3b, 0x01, 0x21, 0x78, 0x87,
+    0xd4, 0x00, 0x46, 0x57, 0x9f, 0xd3, 0x27, 0x52,
+    0x4c, 0x36, 0x02, 0xe7, 0xa0, 0xc4, 0xc8, 0x9e,
+    0xea, 0xbf, 0x8a, 0xd2, 0x40, 0xc7, 0x38, 0xb5,
+    0xa3, 0xf7, 0xf2, 0xce, 0xf9, 0x61, 0x15, 0xa1,
+    0xe0, 0xae, 0x5d, 0xa4, 0x9b, 0x34, 0x1a, 0x55,
+    0xad, 0x93, 0x32, 0x30, 0xf5, 0x8c, 0xb1, 0xe3,
+    0x1d, 0xf6, 0xe2, 0x2e, 0x82, 0x66, 0xca, 0x60,
+    0xc0, 0x29, 0x23, 0xab, 0x0d, 0x53, 0x4e, 0x6f,
+    0xd5, 0xdb, 0x37, 0x45, 0xde, 0xfd, 0x8e, 0x2f,
+    0x03, 0xff, 0x6a, 0x72, 0x6d, 0x6c, 0x5b, 0x51,
+    0x8d, 0x1b, 0xaf, 0x92, 0xbb, 0xdd, 0xbc, 0x7f,
+    0x11, 0xd9, 0x5c, 0x41, 0x1f, 0x10, 0x5a, 0xd8,
+    0x0a, 0xc1, 0x31, 0x88, 0xa5, 0xcd, 0x7b, 0xbd,
+    0x2d, 0x74, 0xd0, 0x12, 0xb8, 0xe5, 0xb4, 0xb0,
+    0x89, 0x69, 0x97, 0x4a, 0x0c, 0x96, 0x77, 0x7e,
+    0x65, 0xb9, 0xf1, 0x09, 0xc5, 0x6e, 0xc6, 0x84,
+    0x18, 0xf0, 0x7d, 0xec, 0x3a, 0xdc, 0x4d, 0x20,
+    0x79, 0xee, 0x5f, 0x3e, 0xd7, 0xcb, 0x39, 0x48,
+};
+
+static const uint32_t FK[4] = {
+    0xa3b1bac6, 0x56aa3350, 0x677d9197, 0xb27022dc,
+};
+
+static uint32_t CK[32];
+
+static uint32_t rol(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+static uint32_t tau(uint32_t x)
+{
+    return sbox[x & 0xff] | sbox[(x >> 8) & 0xff] << 8 |
+           sbox[(x >> 16) & 0xff] << 16 | (uint32_t)sbox[x >> 24] << 24;
+}
+
+static void encrypt_c(uint32_t *out, const uint32_t *key, const uint32_t *in)
+{
+    uint32_t k[36], x[36];
+
+    for (int i = 0; i < 4; i++) {
+        k[i] = key[i] ^ FK[i];
+        x[i] = in[i];
+    }
+    for (int i = 0; i < 32; i++) {
+        uint32_t s = tau(k[i + 1] ^ k[i + 2] ^ k[i + 3] ^ CK[i]);
+        uint32_t t;
+
+        k[i + 4] = k[i] ^ s ^ rol(s, 13) ^ rol(s, 23);
+        t = tau(x[i + 1] ^ x[i + 2] ^ x[i + 3] ^ k[i + 4]);
+        x[i + 4] = x[i] ^ t ^ rol(t, 2) ^ rol(t, 10) ^ rol(t, 18) ^
+                   rol(t, 24);
+    }
+    for (int i = 0; i < 4; i++) {
+        out[i] = x[35 - i];
+    }
+}
+
+static void encrypt_insn(uint32_t *out, const uint32_t *key,
+                         const uint32_t *in)
+{
+    uint32x4_t k = veorq_u32(vld1q_u32(key), vld1q_u32(FK));
+    uint32x4_t x = vld1q_u32(in);
+
+    for (int i = 0; i < 8; i++) {
+        k = vsm4ekeyq_u32(k, vld1q_u32(&CK[i * 4]));
+        x = vsm4eq_u32(x, k);
+    }
+    vst1q_u32(out, vrev64q_u32(vextq_u32(x, x, 2)));
+}
+
+int main(void)
+{
+    /* example 1 of GB/T 32907-2016: the key is also the plain text */
+    static const uint32_t mk[4] = {
+        0x01234567, 0x89abcdef, 0xfedcba98, 0x76543210,
+    };
+    static const uint32_t expected[4] = {
+        0x681edf34, 0xd206965e, 0x86b3e94f, 0x536e4246,
+    };
+    uint32_t key[4], in[4], oc[4], oi[4];
+    uint32_t seed = 1;
+    int errors = 0;
+
+    for (int i = 0; i < 32; i++) {
+        for (int j = 0; j < 4; j++) {
+            CK[i] = CK[i] << 8 | (uint8_t)((i * 4 + j) * 7);
+        }
+    }
+
+    encrypt_c(oc, mk, mk);
+    encrypt_insn(oi, mk, mk);
+    if (memcmp(oc, expected, sizeof(oc)) || memcmp(oi, expected, sizeof(oi))) {
+        fprintf(stderr, "GB/T 32907 example mismatch\n");
+        errors++;
+    }
+
+    for (int n = 0; n < 1000; n++) {
+        for (int i = 0; i < 4; i++) {
+            seed = seed * 1103515245 + 12345;
+            key[i] = seed;
+            seed = seed * 1103515245 + 12345;
+            in[i] = seed;
+        }
+        encrypt_c(oc, key, in);
+        encrypt_insn(oi, key, in);
+        if (memcmp(oc, oi, sizeof(oc))) {
+            fprintf(stderr, "block %d mismatch\n", n);
+            errors++;
+        }
+    }
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
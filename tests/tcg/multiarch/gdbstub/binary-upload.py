@@ -0,0 +1,39 @@
+from __future__ import print_function
+#
+# Test the binary memory read packet ('x') advertised by qSupported
+#
+# This is launched via tests/guest-debug/run-test.py
+#
+
+import gdb
+from test_gdbstub import main, report
+
+
+def packet(cmd):
+    "Send a raw packet and return the reply"
+    out = gdb.execute("maint packet " + cmd, False, True)
+    return out.split("received: ", 1)[1].strip().strip('"')
+
+
+def run_test():
+    "Run through the tests one by one"
+
+    supported = packet("qSupported")
+    report("binary-upload+" in supported.split(";"),
+           "qSupported advertises binary-upload")
+
+    pc = int(gdb.parse_and_eval("$pc"))
+    hex_reply = packet("m{:x},10".format(pc))
+    expected = bytes.fromhex(hex_reply)
+
+    bin_reply = packet("x{:x},10".format(pc))
+    report(bin_reply.startswith("b"), "x packet replies with binary data")
+
+    mem = bytes(gdb.selected_inferior().read_memory(pc, 16))
+    report(mem == expected, "memory read matches the m packet")
+
+    empty = packet("x{:x},0".format(pc))
+    report(empty == "b", "zero length x packet replies with empty data")
+
+
+main(run_test)
@@ -0,0 +1,82 @@
+/*
+ * Several threads mapping, touching and unmapping anonymous memory, in
+ * the way malloc arenas and garbage collectors do.  Checks that every
+ * thread sees its own data and prints the mmap/munmap pairs per second
+ * so that the run doubles as a contention benchmark.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NR_THREADS  4
+#define ITERATIONS  20000
+
+static long page_size;
+
+static void *thread_churn(void *arg)
+{
+    uintptr_t id = (uintptr_t)arg;
+    unsigned int seed = id;
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        size_t pages = 1 + rand_r(&seed) % 16;
+        size_t len = pages * page_size;
+        uintptr_t tag = (id << 24) | i;
+        uintptr_t *p;
+        int ret;
+
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        assert(p != MAP_FAILED);
+
+        /* fresh anonymous memory reads as zero and keeps what we write */
+        for (size_t j = 0; j < pages; j++) {
+            uintptr_t *q = p + j * page_size / sizeof(*p);
+
+            assert(*q == 0);
+            *q = tag;
+        }
+        for (size_t j = 0; j < pages; j++) {
+            assert(p[j * page_size / sizeof(*p)] == tag);
+        }
+
+        ret = munmap(p, len);
+        assert(ret == 0);
+    }
+
+    return NULL;
+}
+
+int main(void)
+{
+    pthread_t threads[NR_THREADS];
+    struct timespec t0, t1;
+    double secs;
+    int ret;
+
+    page_size = getpagesize();
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uintptr_t i = 0; i < NR_THREADS; i++) {
+        ret = pthread_create(&threads[i], NULL, thread_churn, (void *)i);
+        assert(ret == 0);
+    }
+    for (int i = 0; i < NR_THREADS; i++) {
+        ret = pthread_join(threads[i], NULL);
+        assert(ret == 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("%d threads: %.0f mmap/munmap pairs per second\n",
+           NR_THREADS, NR_THREADS * ITERATIONS / secs);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2025 The QEMU Project Developers
+ *
+ * Tests reading scoreboards while vCPUs are still being brought up.
+ *
+ * Every vCPU reads all entries and the reductions of a scoreboard from
+ * its init callback, when later vCPUs (possibly with lower indexes,
+ * since vCPUs can come up in any order) are not initialized yet.
+ * Entries of vCPUs that have not started must read as zero.
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ */
+
+#include <glib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <qemu-plugin.h>
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_version = QEMU_PLUGIN_VERSION;
+
+static struct qemu_plugin_scoreboard *score;
+static qemu_plugin_u64 started;
+static uint64_t vcpu_inits;
+static GMutex lock;
+
+static void vcpu_init(qemu_plugin_id_t id, unsigned int vcpu_index)
+{
+    unsigned int num_vcpus = qemu_plugin_num_vcpus();
+    uint64_t sum = 0;
+
+    g_mutex_lock(&lock);
+    for (unsigned int i = 0; i < num_vcpus; i++) {
+        uint64_t val = qemu_plugin_u64_get(started, i);
+
+        g_assert(val <= 1);
+        sum += val;
+    }
+    g_assert(sum == qemu_plugin_u64_sum(started));
+    g_assert(qemu_plugin_u64_max(started) <= 1);
+    g_assert(qemu_plugin_u64_min(started) <= 1);
+    /* vCPU indexes are reused by new threads in user mode */
+    g_assert(sum <= vcpu_inits);
+
+    qemu_plugin_u64_set(started, vcpu_index, 1);
+    vcpu_inits++;
+    g_mutex_unlock(&lock);
+}
+
+static void plugin_exit(qemu_plugin_id_t id, void *udata)
+{
+    g_autoptr(GString) out = g_string_new("");
+
+    g_assert(qemu_plugin_u64_sum(started) <= vcpu_inits);
+    g_string_printf(out, "vcpus initialized: %" PRIu64 "\n", vcpu_inits);
+    qemu_plugin_outs(out->str);
+    qemu_plugin_scoreboard_free(score);
+}
+
+QEMU_PLUGIN_EXPORT
+int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
+                        int argc, char **argv)
+{
+    score = qemu_plugin_scoreboard_new(sizeof(uint64_t));
+    started = qemu_plugin_scoreboard_u64(score);
+
+    qemu_plugin_register_vcpu_init_cb(id, vcpu_init);
+    qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
+    return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * Carry-less multiply tests
+ *
+ * Check the host accelerated carry-less multiplies against the generic
+ * C implementation on random inputs.
+ *
+ * Copyright (c) 2025 The QEMU Project Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include "qemu/osdep.h"
+#include "crypto/clmul.h"
+
+#define ITERATIONS 10000
+
+/* covers the 4-wide path, its tail, and a vector register group */
+#define MAX_ELEMS 37
+
+static uint64_t rand64(void)
+{
+    return ((uint64_t)g_test_rand_int() << 32) | (uint32_t)g_test_rand_int();
+}
+
+static void assert_clmul_eq(Int128 r, uint64_t a, uint64_t b)
+{
+    Int128 expected = clmul_64_gen(a, b);
+
+    g_assert_cmphex(int128_getlo(r), ==, int128_getlo(expected));
+    g_assert_cmphex(int128_gethi(r), ==, int128_gethi(expected));
+}
+
+static void test_clmul_64(void)
+{
+    /* also the corners: one operand with only the top or bottom bit */
+    static const uint64_t fixed[] = { 0, 1, 0x87, 1ull << 63, UINT64_MAX };
+
+    for (int i = 0; i < ARRAY_SIZE(fixed); i++) {
+        for (int j = 0; j < ARRAY_SIZE(fixed); j++) {
+            assert_clmul_eq(clmul_64(fixed[i], fixed[j]), fixed[i], fixed[j]);
+        }
+    }
+    for (int i = 0; i < ITERATIONS; i++) {
+        uint64_t a = rand64(), b = rand64();
+
+        assert_clmul_eq(clmul_64(a, b), a, b);
+        if (HAVE_CLMUL_ACCEL) {
+            assert_clmul_eq(clmul_64_accel(a, b), a, b);
+        }
+    }
+}
+
+static void check_vec(size_t b_stride, size_t n, bool lo, bool hi,
+                      bool alias)
+{
+    uint64_t a[MAX_ELEMS], b[MAX_ELEMS], out_lo[MAX_ELEMS], out_hi[MAX_ELEMS];
+    uint64_t a_orig[MAX_ELEMS];
+    uint64_t *plo = lo ? (alias ? a : out_lo) : NULL;
+    uint64_t *phi = hi ? (alias && !lo ? a : out_hi) : NULL;
+
+    for (size_t i = 0; i < n; i++) {
+        a[i] = a_orig[i] = rand64();
+        b[i] = rand64();
+    }
+
+    clmul_64_vec(plo, phi, a, b, b_stride, n);
+
+    for (size_t i = 0; i < n; i++) {
+        Int128 expected = clmul_64_gen(a_orig[i], b[i * b_stride]);
+
+        if (plo) {
+            g_assert_cmphex(plo[i], ==, int128_getlo(expected));
+        }
+        if (phi) {
+            g_assert_cmphex(phi[i], ==, int128_gethi(expected));
+        }
+    }
+}
+
+static void test_clmul_64_vec(void)
+{
+    for (size_t n = 1; n <= MAX_ELEMS; n++) {
+        for (size_t b_stride = 0; b_stride <= 1; b_stride++) {
+            check_vec(b_stride, n, true, true, false);
+            check_vec(b_stride, n, true, false, false);
+            check_vec(b_stride, n, false, true, false);
+            /* output in place of the first operand */
+            check_vec(b_stride, n, true, false, true);
+            check_vec(b_stride, n, false, true, true);
+        }
+    }
+}
+
+static void test_clmul_64x4(void)
+{
+    uint64_t a[4], b[4], lo[4], hi[4];
+
+    if (!HAVE_CLMUL_X4_ACCEL) {
+        g_test_skip("no 4-wide carry-less multiply on this host");
+        return;
+    }
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        size_t b_stride = i & 1;
+
+        for (int j = 0; j < 4; j++) {
+            a[j] = rand64();
+            b[j] = rand64();
+        }
+        clmul_64x4_accel(lo, hi, a, b, b_stride);
+        for (int j = 0; j < 4; j++) {
+            Int128 expected = clmul_64_gen(a[j], b[j * b_stride]);
+
+            g_assert_cmphex(lo[j], ==, int128_getlo(expected));
+            g_assert_cmphex(hi[j], ==, int128_gethi(expected));
+        }
+    }
+}
+
+/* Shift-and-add multiply in GF(2^128), one bit of @x at a time */
+static void gf128_mul_ref(uint64_t *z, const uint64_t *x, const uint64_t *y)
+{
+    uint64_t v[2] = { y[0], y[1] };
+    uint64_t r[2] = { 0, 0 };
+
+    for (int i = 0; i < 128; i++) {
+        uint64_t carry = v[1] >> 63;
+
+        if ((x[i / 64] >> (i % 64)) & 1) {
+            r[0] ^= v[0];
+            r[1] ^= v[1];
+        }
+        v[1] = (v[1] << 1) | (v[0] >> 63);
+        v[0] = (v[0] << 1) ^ (carry ? 0x87 : 0);
+    }
+    z[0] = r[0];
+    z[1] = r[1];
+}
+
+static void test_gf128_mul(void)
+{
+    static const uint64_t one[2] = { 1, 0 };
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        uint64_t x[2] = { rand64(), rand64() };
+        uint64_t y[2] = { rand64(), rand64() };
+        uint64_t z[2], expected[2];
+
+        gf128_mul_ref(expected, x, y);
+        clmul_gf128_mul(z, x, y);
+        g_assert_cmphex(z[0], ==, expected[0]);
+        g_assert_cmphex(z[1], ==, expected[1]);
+
+        /* 1 is the identity */
+        clmul_gf128_mul(z, x, one);
+        g_assert_cmphex(z[0], ==, x[0]);
+        g_assert_cmphex(z[1], ==, x[1]);
+
+        /* in place */
+        clmul_gf128_mul(x, x, y);
+        g_assert_cmphex(x[0], ==, expected[0]);
+        g_assert_cmphex(x[1], ==, expected[1]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/crypto/clmul/64", test_clmul_64);
+    g_test_add_func("/crypto/clmul/64-vec", test_clmul_64_vec);
+    g_test_add_func("/crypto/clmul/64x4", test_clmul_64x4);
+    g_test_add_func("/crypto/clmul/gf128", test_gf128_mul);
+    return g_test_run();
+}
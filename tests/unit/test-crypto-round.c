@@ -0,0 +1,311 @@
+/*
+ * SHA-256 and SM4 round helper tests
+ *
+ * Check the host accelerated round helpers used by the TCG crypto
+ * instructions against the generic C code on random inputs, and both
+ * against the published test vectors.
+ *
+ * Copyright (c) 2025 The QEMU Project Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include "qemu/osdep.h"
+#include "crypto/sha2-round.h"
+#include "crypto/sm4.h"
+
+#define ITERATIONS 10000
+
+typedef void RoundFn(uint32_t *ret, const uint32_t *a, const uint32_t *b);
+
+static void rand_words(uint32_t *w, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        w[i] = g_test_rand_int();
+    }
+}
+
+/*
+ * Compare @fn against @gen, both with a separate output and with the
+ * output in place of each operand.
+ */
+static void check_round(RoundFn *fn, RoundFn *gen)
+{
+    for (int i = 0; i < ITERATIONS; i++) {
+        uint32_t a[4], b[4], expected[4], ret[4], tmp[4];
+
+        rand_words(a, 4);
+        rand_words(b, 4);
+        gen(expected, a, b);
+
+        fn(ret, a, b);
+        g_assert_cmpmem(ret, sizeof(ret), expected, sizeof(expected));
+
+        memcpy(tmp, a, sizeof(tmp));
+        fn(tmp, tmp, b);
+        g_assert_cmpmem(tmp, sizeof(tmp), expected, sizeof(expected));
+
+        memcpy(tmp, b, sizeof(tmp));
+        fn(tmp, a, tmp);
+        g_assert_cmpmem(tmp, sizeof(tmp), expected, sizeof(expected));
+    }
+}
+
+/* sha256_rnds2 only reads two words of @wk, keep the interface uniform */
+static void sha256_rnds2_fn(uint32_t *ret, const uint32_t *cdgh,
+                            const uint32_t *abef)
+{
+    static const uint32_t wk[2] = { 0x428a2f98, 0x71374491 };
+
+    sha256_rnds2(ret, cdgh, abef, wk);
+}
+
+static void sha256_rnds2_gen_fn(uint32_t *ret, const uint32_t *cdgh,
+                                const uint32_t *abef)
+{
+    static const uint32_t wk[2] = { 0x428a2f98, 0x71374491 };
+
+    sha256_rnds2_gen(ret, cdgh, abef, wk);
+}
+
+static void test_sha256_rnds2(void)
+{
+    check_round(sha256_rnds2_fn, sha256_rnds2_gen_fn);
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        uint32_t cdgh[4], abef[4], wk[2], expected[4], ret[4];
+
+        rand_words(cdgh, 4);
+        rand_words(abef, 4);
+        rand_words(wk, 2);
+        sha256_rnds2_gen(expected, cdgh, abef, wk);
+        sha256_rnds2(ret, cdgh, abef, wk);
+        g_assert_cmpmem(ret, sizeof(ret), expected, sizeof(expected));
+        if (HAVE_SHA256_ACCEL) {
+            sha256_rnds2_accel(ret, cdgh, abef, wk);
+            g_assert_cmpmem(ret, sizeof(ret), expected, sizeof(expected));
+        }
+    }
+}
+
+static void sha256_msg1_fn(uint32_t *ret, const uint32_t *a,
+                           const uint32_t *b)
+{
+    sha256_msg1(ret, a, b);
+}
+
+static void sha256_msg2_fn(uint32_t *ret, const uint32_t *a,
+                           const uint32_t *b)
+{
+    sha256_msg2(ret, a, b);
+}
+
+/*
+ * The accel functions only exist when the host has them, so they are
+ * called, never referenced, behind HAVE_*_ACCEL.
+ */
+static void sha256_msg1_accel_fn(uint32_t *ret, const uint32_t *a,
+                                 const uint32_t *b)
+{
+    if (HAVE_SHA256_ACCEL) {
+        sha256_msg1_accel(ret, a, b);
+    }
+}
+
+static void sha256_msg2_accel_fn(uint32_t *ret, const uint32_t *a,
+                                 const uint32_t *b)
+{
+    if (HAVE_SHA256_ACCEL) {
+        sha256_msg2_accel(ret, a, b);
+    }
+}
+
+static void test_sha256_msg(void)
+{
+    check_round(sha256_msg1_fn, sha256_msg1_gen);
+    check_round(sha256_msg2_fn, sha256_msg2_gen);
+    if (HAVE_SHA256_ACCEL) {
+        check_round(sha256_msg1_accel_fn, sha256_msg1_gen);
+        check_round(sha256_msg2_accel_fn, sha256_msg2_gen);
+    }
+}
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/* SHA-256 of "abc", from FIPS 180-2 appendix B.1 */
+static void check_sha256_abc(bool gen)
+{
+    static const uint32_t expected[8] = {
+        0xba7816bf, 0x8f01cfea, 0x414140de, 0x5dae2223,
+        0xb00361a3, 0x96177a9c, 0xb410ff61, 0xf20015ad,
+    };
+    uint32_t h[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    uint32_t abef[4] = { h[5], h[4], h[1], h[0] };
+    uint32_t cdgh[4] = { h[7], h[6], h[3], h[2] };
+    uint32_t w[64] = { [0] = 0x61626380, [15] = 24 };
+    uint32_t out[8];
+
+    for (int t = 16; t < 64; t += 4) {
+        uint32_t x[4];
+
+        if (gen) {
+            sha256_msg1_gen(x, &w[t - 16], &w[t - 12]);
+        } else {
+            sha256_msg1(x, &w[t - 16], &w[t - 12]);
+        }
+        for (int j = 0; j < 4; j++) {
+            x[j] += w[t - 7 + j];
+        }
+        if (gen) {
+            sha256_msg2_gen(&w[t], x, &w[t - 4]);
+        } else {
+            sha256_msg2(&w[t], x, &w[t - 4]);
+        }
+    }
+
+    /* each call swaps the roles of the two arrays */
+    for (int i = 0; i < 64; i += 4) {
+        uint32_t wk[4];
+
+        for (int j = 0; j < 4; j++) {
+            wk[j] = w[i + j] + sha256_k[i + j];
+        }
+        if (gen) {
+            sha256_rnds2_gen(cdgh, cdgh, abef, wk);
+            sha256_rnds2_gen(abef, abef, cdgh, wk + 2);
+        } else {
+            sha256_rnds2(cdgh, cdgh, abef, wk);
+            sha256_rnds2(abef, abef, cdgh, wk + 2);
+        }
+    }
+
+    out[0] = h[0] + abef[3];
+    out[1] = h[1] + abef[2];
+    out[2] = h[2] + cdgh[3];
+    out[3] = h[3] + cdgh[2];
+    out[4] = h[4] + abef[1];
+    out[5] = h[5] + abef[0];
+    out[6] = h[6] + cdgh[1];
+    out[7] = h[7] + cdgh[0];
+    g_assert_cmpmem(out, sizeof(out), expected, sizeof(expected));
+}
+
+static void test_sha256_digest(void)
+{
+    check_sha256_abc(true);
+    check_sha256_abc(false);
+}
+
+static void sm4_rnds4_fn(uint32_t *ret, const uint32_t *a, const uint32_t *b)
+{
+    sm4_rnds4(ret, a, b);
+}
+
+static void sm4_ekey4_fn(uint32_t *ret, const uint32_t *a, const uint32_t *b)
+{
+    sm4_ekey4(ret, a, b);
+}
+
+static void sm4_rnds4_accel_fn(uint32_t *ret, const uint32_t *a,
+                               const uint32_t *b)
+{
+    if (HAVE_SM4_ACCEL) {
+        sm4_rnds4_accel(ret, a, b);
+    }
+}
+
+static void sm4_ekey4_accel_fn(uint32_t *ret, const uint32_t *a,
+                               const uint32_t *b)
+{
+    if (HAVE_SM4_ACCEL) {
+        sm4_ekey4_accel(ret, a, b);
+    }
+}
+
+static void test_sm4_round(void)
+{
+    check_round(sm4_rnds4_fn, sm4_rnds4_gen);
+    check_round(sm4_ekey4_fn, sm4_ekey4_gen);
+    if (HAVE_SM4_ACCEL) {
+        check_round(sm4_rnds4_accel_fn, sm4_rnds4_gen);
+        check_round(sm4_ekey4_accel_fn, sm4_ekey4_gen);
+    }
+}
+
+/* Example 1 of GB/T 32907-2016: the key is also the plain text */
+static void check_sm4_example(bool gen)
+{
+    static const uint32_t fk[4] = {
+        0xa3b1bac6, 0x56aa3350, 0x677d9197, 0xb27022dc,
+    };
+    static const uint32_t mk[4] = {
+        0x01234567, 0x89abcdef, 0xfedcba98, 0x76543210,
+    };
+    static const uint32_t expected[4] = {
+        0x681edf34, 0xd206965e, 0x86b3e94f, 0x536e4246,
+    };
+    uint32_t rk[32], k[4], x[4], out[4];
+
+    for (int i = 0; i < 4; i++) {
+        k[i] = mk[i] ^ fk[i];
+    }
+    for (int i = 0; i < 32; i += 4) {
+        if (gen) {
+            sm4_ekey4_gen(k, k, &sm4_ck[i]);
+        } else {
+            sm4_ekey4(k, k, &sm4_ck[i]);
+        }
+        memcpy(&rk[i], k, sizeof(k));
+    }
+
+    memcpy(x, mk, sizeof(x));
+    for (int i = 0; i < 32; i += 4) {
+        if (gen) {
+            sm4_rnds4_gen(x, x, &rk[i]);
+        } else {
+            sm4_rnds4(x, x, &rk[i]);
+        }
+    }
+
+    /* the cipher text is the last four words in reverse order */
+    for (int i = 0; i < 4; i++) {
+        out[i] = x[3 - i];
+    }
+    g_assert_cmpmem(out, sizeof(out), expected, sizeof(expected));
+}
+
+static void test_sm4_cipher(void)
+{
+    check_sm4_example(true);
+    check_sm4_example(false);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/crypto/round/sha256/rnds2", test_sha256_rnds2);
+    g_test_add_func("/crypto/round/sha256/msg", test_sha256_msg);
+    g_test_add_func("/crypto/round/sha256/digest", test_sha256_digest);
+    g_test_add_func("/crypto/round/sm4/round", test_sm4_round);
+    g_test_add_func("/crypto/round/sm4/cipher", test_sm4_cipher);
+    return g_test_run();
+}
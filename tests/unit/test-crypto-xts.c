@@ -296,6 +296,33 @@ static const QCryptoXTSTestData test_data[] = {
           0xed, 0xbf, 0x9d, 0xac, 0xe4, 0x5d, 0x6f, 0x6a,
           0x73, 0x06, 0xe6, 0x4b, 0xe5, 0xdd, 0x82 },
     },
+
+    /*
+     * 32 byte key, 47 byte PTX: ciphertext stealing after more than
+     * one full block, so the partial block is not at the buffer start
+     */
+    {
+        "/crypto/xts/t-cts-key-32-ptx-47",
+        32,
+        { 0xff, 0xfe, 0xfd, 0xfc, 0xfb, 0xfa, 0xf9, 0xf8,
+          0xf7, 0xf6, 0xf5, 0xf4, 0xf3, 0xf2, 0xf1, 0xf0 },
+        { 0xbf, 0xbe, 0xbd, 0xbc, 0xbb, 0xba, 0xb9, 0xb8,
+          0xb7, 0xb6, 0xb5, 0xb4, 0xb3, 0xb2, 0xb1, 0xb0 },
+        0x123456789aLL,
+        47,
+        { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+          0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+          0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+          0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+          0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27,
+          0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e },
+        { 0xed, 0xbf, 0x9d, 0xac, 0xe4, 0x5d, 0x6f, 0x6a,
+          0x73, 0x06, 0xe6, 0x4b, 0xe5, 0xdd, 0x82, 0x4b,
+          0xd9, 0x76, 0x64, 0x61, 0x8c, 0xdc, 0x61, 0x66,
+          0x34, 0x50, 0xda, 0x4b, 0xc5, 0xbe, 0x6d, 0x76,
+          0x25, 0x38, 0xf5, 0x72, 0x4f, 0xcf, 0x24, 0x24,
+          0x9a, 0xc1, 0x11, 0xab, 0x45, 0xad, 0x39 },
+    },
 };
 
 #define STORE64L(x, y)                                                  \
@@ -322,7 +349,11 @@ static void test_xts_aes_encrypt(const void *ctx,
 {
     const struct TestAES *aesctx = ctx;
 
-    AES_encrypt(src, dst, &aesctx->enc);
+    for (; length; length -= XTS_BLOCK_SIZE) {
+        AES_encrypt(src, dst, &aesctx->enc);
+        src += XTS_BLOCK_SIZE;
+        dst += XTS_BLOCK_SIZE;
+    }
 }
 
 
@@ -333,7 +364,11 @@ static void test_xts_aes_decrypt(const void *ctx,
 {
     const struct TestAES *aesctx = ctx;
 
-    AES_decrypt(src, dst, &aesctx->dec);
+    for (; length; length -= XTS_BLOCK_SIZE) {
+        AES_decrypt(src, dst, &aesctx->dec);
+        src += XTS_BLOCK_SIZE;
+        dst += XTS_BLOCK_SIZE;
+    }
 }
 
 
@@ -0,0 +1,98 @@
+/*
+ * QEMU framebuffer comparison and pixel conversion test
+ *
+ * Copyright (c) 2025 The QEMU Project Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/pixel-ops.h"
+
+#define NPIXELS 1031
+
+static uint32_t src32[NPIXELS + 1];
+static uint16_t src16[NPIXELS + 1];
+
+static void test_find_diff(void)
+{
+    uint8_t a[NPIXELS], b[NPIXELS];
+    size_t len, i;
+
+    memset(a, 0x5a, sizeof(a));
+    memcpy(b, a, sizeof(b));
+    for (len = 0; len < 300; len++) {
+        g_assert_cmpuint(buffer_find_diff(a, b, len), ==, len);
+        for (i = 0; i < len; i++) {
+            b[i] ^= 0x10;
+            g_assert_cmpuint(buffer_find_diff(a, b, len), ==, i);
+            b[i] ^= 0x10;
+        }
+    }
+    b[NPIXELS - 1] = 0;
+    g_assert_cmpuint(buffer_find_diff(a + 1, b + 1, NPIXELS - 1), ==,
+                     NPIXELS - 2);
+}
+
+static void test_rgb565(void)
+{
+    uint16_t dst16[NPIXELS + 1];
+    uint32_t dst32[NPIXELS + 1];
+    size_t n, i;
+
+    /* Odd lengths and offsets exercise the tails of the vector loops */
+    for (n = 0; n < 40; n++) {
+        pixel_rgb888_to_rgb565(dst16 + 1, src32 + 1, NPIXELS - n);
+        pixel_rgb565_to_rgb888(dst32 + 1, src16 + 1, NPIXELS - n);
+        for (i = 1; i <= NPIXELS - n; i++) {
+            uint32_t p = src32[i], v = src16[i];
+            uint32_t r = v >> 11, g = (v >> 5) & 0x3f, b = v & 0x1f;
+
+            g_assert_cmphex(dst16[i], ==, ((p >> 19) & 0x1f) << 11 |
+                                          ((p >> 10) & 0x3f) << 5 |
+                                          ((p >> 3) & 0x1f));
+            g_assert_cmphex(dst32[i], ==, ((r << 3) | (r >> 2)) << 16 |
+                                          ((g << 2) | (g >> 4)) << 8 |
+                                          ((b << 3) | (b >> 2)));
+        }
+    }
+}
+
+static void test_swap_rb(void)
+{
+    uint32_t dst[NPIXELS + 1];
+    size_t n, i;
+
+    for (n = 0; n < 40; n++) {
+        pixel_swap_rb(dst + 1, src32 + 1, NPIXELS - n);
+        for (i = 1; i <= NPIXELS - n; i++) {
+            uint32_t p = src32[i];
+
+            g_assert_cmphex(dst[i], ==, (p & 0xff) << 16 | (p & 0xff00) |
+                                        ((p >> 16) & 0xff));
+        }
+    }
+}
+
+/* Check every implementation, from the fastest to the generic one */
+static void test_all_accel(void)
+{
+    do {
+        test_find_diff();
+        test_rgb565();
+        test_swap_rb();
+    } while (test_pixel_ops_next_accel());
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    for (size_t i = 0; i < ARRAY_SIZE(src32); i++) {
+        src32[i] = g_test_rand_int();
+        src16[i] = g_test_rand_int();
+    }
+    g_test_add_func("/pixel-ops", test_all_accel);
+
+    return g_test_run();
+}
@@ -51,24 +51,32 @@
  * its own output buffer.
  * When the encoding job is done, the worker thread will hold the output lock
  * and copy its output buffer in vs->output.
+ *
+ * Several worker threads share the queue.  Jobs of a client are encoded in
+ * order by one thread at a time, because they share the client's encoder
+ * state and output stream, but jobs of different clients run in parallel.
+ * Workers are started on demand, up to one per host CPU.
  */
 
+#define VNC_WORKER_THREADS_MAX 16
+
 struct VncJobQueue {
     QemuCond cond;
     QemuMutex mutex;
-    QemuThread thread;
+    int nthreads;           /* running worker threads */
+    int max_threads;
+    int idle;               /* workers waiting for a job */
     bool exit;
     QTAILQ_HEAD(, VncJob) jobs;
 };
 
 typedef struct VncJobQueue VncJobQueue;
 
-/*
- * We use a single global queue, but most of the functions are
- * already reentrant, so we can easily add more than one encoding thread
- */
+/* A single global queue, shared by all displays */
 static VncJobQueue *queue;
 
+static void vnc_worker_spawn_locked(VncJobQueue *queue);
+
 static void vnc_lock_queue(VncJobQueue *queue)
 {
     qemu_mutex_lock(&queue->mutex);
@@ -115,11 +123,38 @@ void vnc_job_push(VncJob *job)
         g_free(job);
     } else {
         QTAILQ_INSERT_TAIL(&queue->jobs, job, next);
+        if (!queue->idle && queue->nthreads < queue->max_threads) {
+            vnc_worker_spawn_locked(queue);
+        }
         qemu_cond_broadcast(&queue->cond);
     }
     vnc_unlock_queue(queue);
 }
 
+/*
+ * Returns the oldest job that no other worker is encoding and that is not
+ * queued behind an earlier job of the same client, or NULL.
+ */
+static VncJob *vnc_next_job_locked(VncJobQueue *queue)
+{
+    VncJob *job, *prev;
+
+    QTAILQ_FOREACH(job, &queue->jobs, next) {
+        if (job->running) {
+            continue;
+        }
+        QTAILQ_FOREACH(prev, &queue->jobs, next) {
+            if (prev == job || prev->vs == job->vs) {
+                break;
+            }
+        }
+        if (prev == job) {
+            return job;
+        }
+    }
+    return NULL;
+}
+
 static bool vnc_has_job_locked(VncState *vs)
 {
     VncJob *job;
@@ -227,7 +262,63 @@ static bool vnc_worker_clamp_rect(VncState *vs, VncJob *job, VncRect *rect)
     return false;
 }
 
-static int vnc_worker_thread_loop(VncJobQueue *queue)
+/*
+ * Copy the job's rectangles from the server surface into @snapshot, which
+ * is grown as needed and reused across jobs.  Only the copy is done with
+ * the display lock held, so that encoding for one client does not hold
+ * up the refresh nor the workers of other clients.  The surface itself
+ * cannot be replaced while the job runs: vnc_dpy_switch() waits for the
+ * jobs of the display to finish first.
+ */
+static void vnc_worker_snapshot(VncState *vs, VncJob *job,
+                                pixman_image_t **snapshot)
+{
+    VncDisplay *vd = job->vs->vd;
+    VncRectEntry *entry;
+    int x1 = INT_MAX, y1 = INT_MAX, x2 = 0, y2 = 0;
+    uint8_t *src, *dst;
+    int w, h;
+
+    QLIST_FOREACH(entry, &job->rectangles, next) {
+        x1 = MIN(x1, entry->rect.x);
+        y1 = MIN(y1, entry->rect.y);
+        x2 = MAX(x2, entry->rect.x + entry->rect.w);
+        y2 = MAX(y2, entry->rect.y + entry->rect.h);
+    }
+    if (x1 >= x2 || y1 >= y2) {
+        return;
+    }
+    w = x2 - x1;
+    h = y2 - y1;
+
+    if (!*snapshot ||
+        pixman_image_get_width(*snapshot) < w ||
+        pixman_image_get_height(*snapshot) < h) {
+        qemu_pixman_image_unref(*snapshot);
+        *snapshot = pixman_image_create_bits(VNC_SERVER_FB_FORMAT, w, h,
+                                             NULL, 0);
+    }
+    vs->fb = *snapshot;
+    vs->fb_x = x1;
+    vs->fb_y = y1;
+
+    vnc_lock_display(vd);
+    QLIST_FOREACH(entry, &job->rectangles, next) {
+        src = (uint8_t *)pixman_image_get_data(vd->server) +
+              entry->rect.y * pixman_image_get_stride(vd->server) +
+              entry->rect.x * VNC_SERVER_FB_BYTES;
+        dst = vnc_server_fb_ptr(vs, entry->rect.x, entry->rect.y);
+        for (int i = 0; i < entry->rect.h; i++) {
+            memcpy(dst, src, entry->rect.w * VNC_SERVER_FB_BYTES);
+            src += pixman_image_get_stride(vd->server);
+            dst += vnc_server_fb_stride(vs);
+        }
+    }
+    vnc_unlock_display(vd);
+}
+
+static int vnc_worker_thread_loop(VncJobQueue *queue,
+                                  pixman_image_t **snapshot)
 {
     VncConnection *vc;
     VncJob *job;
@@ -237,16 +328,18 @@ static int vnc_worker_thread_loop(VncJobQueue *queue)
     int saved_offset;
 
     vnc_lock_queue(queue);
-    while (QTAILQ_EMPTY(&queue->jobs) && !queue->exit) {
+    while (!(job = vnc_next_job_locked(queue)) && !queue->exit) {
+        queue->idle++;
         qemu_cond_wait(&queue->cond, &queue->mutex);
+        queue->idle--;
     }
     /* Here job can only be NULL if queue->exit is true */
-    job = QTAILQ_FIRST(&queue->jobs);
-    vnc_unlock_queue(queue);
-
     if (queue->exit) {
+        vnc_unlock_queue(queue);
         return -1;
     }
+    job->running = true;
+    vnc_unlock_queue(queue);
 
     assert(job->vs->magic == VNC_MAGIC);
     vc = container_of(job->vs, VncConnection, vs);
@@ -270,6 +363,14 @@ static int vnc_worker_thread_loop(VncJobQueue *queue)
     vnc_async_encoding_start(job->vs, &vs);
     vs.magic = VNC_MAGIC;
 
+    QLIST_FOREACH_SAFE(entry, &job->rectangles, next, tmp) {
+        if (!vnc_worker_clamp_rect(&vs, job, &entry->rect)) {
+            QLIST_REMOVE(entry, next);
+            g_free(entry);
+        }
+    }
+    vnc_worker_snapshot(&vs, job, snapshot);
+
     /* Start sending rectangles */
     n_rectangles = 0;
     vnc_write_u8(&vs, VNC_MSG_SERVER_FRAMEBUFFER_UPDATE);
@@ -277,30 +378,25 @@ static int vnc_worker_thread_loop(VncJobQueue *queue)
     saved_offset = vs.output.offset;
     vnc_write_u16(&vs, 0);
 
-    vnc_lock_display(job->vs->vd);
     QLIST_FOREACH_SAFE(entry, &job->rectangles, next, tmp) {
         int n;
 
         if (job->vs->ioc == NULL) {
-            vnc_unlock_display(job->vs->vd);
             /* Copy persistent encoding data */
             vnc_async_encoding_end(job->vs, &vs);
             goto disconnected;
         }
 
-        if (vnc_worker_clamp_rect(&vs, job, &entry->rect)) {
-            n = vnc_send_framebuffer_update(&vs, &vc->worker,
-                                            entry->rect.x, entry->rect.y,
-                                            entry->rect.w, entry->rect.h);
-
-            if (n >= 0) {
-                n_rectangles += n;
-            }
+        n = vnc_send_framebuffer_update(&vs, &vc->worker,
+                                        entry->rect.x, entry->rect.y,
+                                        entry->rect.w, entry->rect.h);
+        if (n >= 0) {
+            n_rectangles += n;
         }
+        QLIST_REMOVE(entry, next);
         g_free(entry);
     }
     trace_vnc_job_nrects(&vs, job, n_rectangles);
-    vnc_unlock_display(job->vs->vd);
 
     /* Put n_rectangles at the beginning of the message */
     vs.output.buffer[saved_offset] = (n_rectangles >> 8) & 0xFF;
@@ -321,6 +417,9 @@ static int vnc_worker_thread_loop(VncJobQueue *queue)
     vnc_unlock_output(job->vs);
 
 disconnected:
+    QLIST_FOREACH_SAFE(entry, &job->rectangles, next, tmp) {
+        g_free(entry);
+    }
     vnc_lock_queue(queue);
     QTAILQ_REMOVE(&queue->jobs, job, next);
     vnc_unlock_queue(queue);
@@ -336,6 +435,7 @@ static VncJobQueue *vnc_queue_init(void)
 
     qemu_cond_init(&queue->cond);
     qemu_mutex_init(&queue->mutex);
+    queue->max_threads = MIN(g_get_num_processors(), VNC_WORKER_THREADS_MAX);
     QTAILQ_INIT(&queue->jobs);
     return queue;
 }
@@ -351,14 +451,30 @@ static void vnc_queue_clear(VncJobQueue *q)
 static void *vnc_worker_thread(void *arg)
 {
     VncJobQueue *queue = arg;
+    pixman_image_t *snapshot = NULL;
+    bool last;
 
-    qemu_thread_get_self(&queue->thread);
+    while (!vnc_worker_thread_loop(queue, &snapshot)) ;
+    qemu_pixman_image_unref(snapshot);
 
-    while (!vnc_worker_thread_loop(queue)) ;
-    vnc_queue_clear(queue);
+    vnc_lock_queue(queue);
+    last = !--queue->nthreads;
+    vnc_unlock_queue(queue);
+    if (last) {
+        vnc_queue_clear(queue);
+    }
     return NULL;
 }
 
+static void vnc_worker_spawn_locked(VncJobQueue *queue)
+{
+    QemuThread thread;
+
+    queue->nthreads++;
+    qemu_thread_create(&thread, "vnc_worker", vnc_worker_thread, queue,
+                       QEMU_THREAD_DETACHED);
+}
+
 static bool vnc_worker_thread_running(void)
 {
     return queue; /* Check global queue */
@@ -372,7 +488,8 @@ void vnc_start_worker_thread(void)
         return;
 
     q = vnc_queue_init();
-    qemu_thread_create(&q->thread, "vnc_worker", vnc_worker_thread, q,
-                       QEMU_THREAD_DETACHED);
+    vnc_lock_queue(q);
+    vnc_worker_spawn_locked(q);
+    vnc_unlock_queue(q);
     queue = q; /* Set global queue */
 }
@@ -53,6 +53,7 @@
 #include "qom/object_interfaces.h"
 #include "qemu/cutils.h"
 #include "qemu/help_option.h"
+#include "qemu/pixel-ops.h"
 #include "io/dns-resolver.h"
 #include "monitor/monitor.h"
 
@@ -769,18 +770,18 @@ static void vnc_abort_display_jobs(VncDisplay *vd)
     }
 }
 
-int vnc_server_fb_stride(VncDisplay *vd)
+int vnc_server_fb_stride(VncState *vs)
 {
-    return pixman_image_get_stride(vd->server);
+    return pixman_image_get_stride(vs->fb);
 }
 
-void *vnc_server_fb_ptr(VncDisplay *vd, int x, int y)
+void *vnc_server_fb_ptr(VncState *vs, int x, int y)
 {
     uint8_t *ptr;
 
-    ptr  = (uint8_t *)pixman_image_get_data(vd->server);
-    ptr += y * vnc_server_fb_stride(vd);
-    ptr += x * VNC_SERVER_FB_BYTES;
+    ptr  = (uint8_t *)pixman_image_get_data(vs->fb);
+    ptr += (y - vs->fb_y) * vnc_server_fb_stride(vs);
+    ptr += (x - vs->fb_x) * VNC_SERVER_FB_BYTES;
     return ptr;
 }
 
@@ -871,6 +872,43 @@ static void vnc_write_pixels_copy(VncState *vs,
     vnc_write(vs, pixels, size);
 }
 
+/* Vectorized conversions for the most common client formats */
+#define VNC_CONVERT_CHUNK 256
+
+static void vnc_write_pixels_rgb565(VncState *vs,
+                                    void *pixels1, int size)
+{
+    uint32_t *pixels = pixels1;
+    uint16_t buf[VNC_CONVERT_CHUNK];
+    int n = size / VNC_SERVER_FB_BYTES;
+
+    while (n) {
+        int chunk = MIN(n, VNC_CONVERT_CHUNK);
+
+        pixel_rgb888_to_rgb565(buf, pixels, chunk);
+        vnc_write(vs, buf, chunk * sizeof(buf[0]));
+        pixels += chunk;
+        n -= chunk;
+    }
+}
+
+static void vnc_write_pixels_bgr(VncState *vs,
+                                 void *pixels1, int size)
+{
+    uint32_t *pixels = pixels1;
+    uint32_t buf[VNC_CONVERT_CHUNK];
+    int n = size / VNC_SERVER_FB_BYTES;
+
+    while (n) {
+        int chunk = MIN(n, VNC_CONVERT_CHUNK);
+
+        pixel_swap_rb(buf, pixels, chunk);
+        vnc_write(vs, buf, chunk * sizeof(buf[0]));
+        pixels += chunk;
+        n -= chunk;
+    }
+}
+
 /* slowest but generic code. */
 void vnc_convert_pixel(VncState *vs, uint8_t *buf, uint32_t v)
 {
@@ -936,12 +974,11 @@ int vnc_raw_send_framebuffer_update(VncState *vs, int x, int y, int w, int h)
 {
     int i;
     uint8_t *row;
-    VncDisplay *vd = vs->vd;
 
-    row = vnc_server_fb_ptr(vd, x, y);
+    row = vnc_server_fb_ptr(vs, x, y);
     for (i = 0; i < h; i++) {
         vs->write_pixels(vs, row, w * VNC_SERVER_FB_BYTES);
-        row += vnc_server_fb_stride(vd);
+        row += vnc_server_fb_stride(vs);
     }
     return 1;
 }
@@ -2241,6 +2278,12 @@ static void set_pixel_conversion(VncState *vs)
     if (fmt == VNC_SERVER_FB_FORMAT) {
         vs->write_pixels = vnc_write_pixels_copy;
         vnc_hextile_set_pixel_conversion(vs, 0);
+    } else if (fmt == PIXMAN_r5g6b5) {
+        vs->write_pixels = vnc_write_pixels_rgb565;
+        vnc_hextile_set_pixel_conversion(vs, 1);
+    } else if (fmt == PIXMAN_x8b8g8r8) {
+        vs->write_pixels = vnc_write_pixels_bgr;
+        vnc_hextile_set_pixel_conversion(vs, 1);
     } else {
         vs->write_pixels = vnc_write_pixels_generic;
         vnc_hextile_set_pixel_conversion(vs, 1);
@@ -3145,6 +3188,31 @@ static void vnc_rect_updated(VncDisplay *vd, int x, int y, struct timeval * tv)
     rect->updated = true;
 }
 
+/*
+ * Convert a line of the guest surface to the server format.  The most
+ * common guest formats have a vectorized path, pixman handles the rest.
+ */
+static void vnc_guest_linebuf_fill(VncDisplay *vd, pixman_image_t *linebuf,
+                                   int width, int y)
+{
+    uint8_t *src = (uint8_t *)pixman_image_get_data(vd->guest.fb) +
+                   y * pixman_image_get_stride(vd->guest.fb);
+    uint32_t *dst = pixman_image_get_data(linebuf);
+
+    switch (vd->guest.format) {
+    case PIXMAN_r5g6b5:
+        pixel_rgb565_to_rgb888(dst, (uint16_t *)src, width);
+        break;
+    case PIXMAN_x8b8g8r8:
+    case PIXMAN_a8b8g8r8:
+        pixel_swap_rb(dst, (uint32_t *)src, width);
+        break;
+    default:
+        qemu_pixman_linebuf_fill(linebuf, vd->guest.fb, width, 0, y);
+        break;
+    }
+}
+
 static int vnc_refresh_server_surface(VncDisplay *vd)
 {
     int width = MIN(pixman_image_get_width(vd->guest.fb),
@@ -3152,12 +3220,13 @@ static int vnc_refresh_server_surface(VncDisplay *vd)
     int height = MIN(pixman_image_get_height(vd->guest.fb),
                      pixman_image_get_height(vd->server));
     int cmp_bytes, server_stride, line_bytes, guest_ll, guest_stride, y = 0;
+    int cells = DIV_ROUND_UP(width, VNC_DIRTY_PIXELS_PER_BIT);
     uint8_t *guest_row0 = NULL, *server_row0;
     VncState *vs;
     int has_dirty = 0;
     pixman_image_t *tmpbuf = NULL;
     unsigned long offset;
-    int x;
+    int x, run_end;
     uint8_t *guest_ptr, *server_ptr;
 
     struct timeval tv = { 0, 0 };
@@ -3204,19 +3273,46 @@ static int vnc_refresh_server_surface(VncDisplay *vd)
         server_ptr = server_row0 + y * server_stride + x * cmp_bytes;
 
         if (vd->guest.format != VNC_SERVER_FB_FORMAT) {
-            qemu_pixman_linebuf_fill(tmpbuf, vd->guest.fb, width, 0, y);
+            vnc_guest_linebuf_fill(vd, tmpbuf, width, y);
             guest_ptr = (uint8_t *)pixman_image_get_data(tmpbuf);
         } else {
             guest_ptr = guest_row0 + y * guest_stride;
         }
         guest_ptr += x * cmp_bytes;
+        run_end = x;
 
-        for (; x < DIV_ROUND_UP(width, VNC_DIRTY_PIXELS_PER_BIT);
+        for (; x < cells;
              x++, guest_ptr += cmp_bytes, server_ptr += cmp_bytes) {
             int _cmp_bytes = cmp_bytes;
-            if (!test_and_clear_bit(x, vd->guest.dirty[y])) {
+            if (!test_bit(x, vd->guest.dirty[y])) {
                 continue;
             }
+            /*
+             * Dirty logging is page granular, so whole runs of cells are
+             * often flagged while little or nothing changed in them.  Scan
+             * the run in one go and skip the cells before the first
+             * difference.
+             */
+            if (x >= run_end) {
+                int run = find_next_zero_bit(vd->guest.dirty[y], cells, x) - x;
+                int run_bytes, diff, skip = 0;
+
+                run_end = x + run;
+                run_bytes = MIN(run_end * cmp_bytes, line_bytes) -
+                            x * cmp_bytes;
+                if (run > 1) {
+                    diff = buffer_find_diff(server_ptr, guest_ptr, run_bytes);
+                    skip = diff == run_bytes ? run : diff / cmp_bytes;
+                }
+                if (skip) {
+                    bitmap_clear(vd->guest.dirty[y], x, skip);
+                    x += skip - 1;
+                    guest_ptr += (skip - 1) * cmp_bytes;
+                    server_ptr += (skip - 1) * cmp_bytes;
+                    continue;
+                }
+            }
+            clear_bit(x, vd->guest.dirty[y]);
             if ((x + 1) * cmp_bytes > line_bytes) {
                 _cmp_bytes = line_bytes - x * cmp_bytes;
             }
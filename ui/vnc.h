@@ -250,6 +250,7 @@ struct VncRectEntry
 struct VncJob
 {
     VncState *vs;
+    bool running;       /* picked up by a worker thread */
 
     QLIST_HEAD(, VncRectEntry) rectangles;
     QTAILQ_ENTRY(VncJob) next;
@@ -319,6 +320,13 @@ struct VncState
     size_t throttle_output_offset;
     Buffer output;
     Buffer input;
+    /*
+     * Worker copy of the server surface area being encoded; (fb_x, fb_y)
+     * is its top left corner on the server surface.
+     */
+    pixman_image_t *fb;
+    int fb_x;
+    int fb_y;
     /* current output mode information */
     VncWritePixels *write_pixels;
     PixelFormat client_pf;
@@ -605,8 +613,8 @@ void vnc_framebuffer_update(VncState *vs, int x, int y, int w, int h,
 #define VNC_SERVER_FB_BITS   (PIXMAN_FORMAT_BPP(VNC_SERVER_FB_FORMAT))
 #define VNC_SERVER_FB_BYTES  ((VNC_SERVER_FB_BITS+7)/8)
 
-void *vnc_server_fb_ptr(VncDisplay *vd, int x, int y);
-int vnc_server_fb_stride(VncDisplay *vd);
+void *vnc_server_fb_ptr(VncState *vs, int x, int y);
+int vnc_server_fb_stride(VncState *vs);
 
 void vnc_convert_pixel(VncState *vs, uint8_t *buf, uint32_t v);
 double vnc_update_freq(VncState *vs, int x, int y, int w, int h);
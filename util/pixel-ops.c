@@ -0,0 +1,116 @@
+/*
+ * Framebuffer comparison and pixel format conversion helpers
+ *
+ * Copyright (c) 2025 The QEMU Project Developers
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "qemu/host-utils.h"
+#include "qemu/pixel-ops.h"
+#include "host/cpuinfo.h"
+
+typedef struct PixelOpsAccel {
+    size_t (*find_diff)(const void *a, const void *b, size_t len);
+    void (*rgb888_to_rgb565)(uint16_t *dst, const uint32_t *src, size_t n);
+    void (*rgb565_to_rgb888)(uint32_t *dst, const uint16_t *src, size_t n);
+    void (*swap_rb)(uint32_t *dst, const uint32_t *src, size_t n);
+} PixelOpsAccel;
+
+static size_t buffer_find_diff_int(const void *a, const void *b, size_t len)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        if (ldq_he_p(a + i) != ldq_he_p(b + i)) {
+            break;
+        }
+    }
+    for (; i < len; i++) {
+        if (((const uint8_t *)a)[i] != ((const uint8_t *)b)[i]) {
+            break;
+        }
+    }
+    return i;
+}
+
+static inline uint16_t rgb888_to_rgb565(uint32_t p)
+{
+    return ((p >> 8) & 0xf800) | ((p >> 5) & 0x07e0) | ((p >> 3) & 0x001f);
+}
+
+static inline uint32_t rgb565_to_rgb888(uint32_t v)
+{
+    return ((v & 0xf800) << 8) | ((v & 0xe000) << 3) |
+           ((v & 0x07e0) << 5) | ((v & 0x0600) >> 1) |
+           ((v & 0x001f) << 3) | ((v & 0x001c) >> 2);
+}
+
+static inline uint32_t swap_rb(uint32_t p)
+{
+    return ((p >> 16) & 0xff) | (p & 0xff00) | ((p & 0xff) << 16);
+}
+
+static void pixel_rgb888_to_rgb565_int(uint16_t *dst, const uint32_t *src,
+                                       size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = rgb888_to_rgb565(src[i]);
+    }
+}
+
+static void pixel_rgb565_to_rgb888_int(uint32_t *dst, const uint16_t *src,
+                                       size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = rgb565_to_rgb888(src[i]);
+    }
+}
+
+static void pixel_swap_rb_int(uint32_t *dst, const uint32_t *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = swap_rb(src[i]);
+    }
+}
+
+#include "host/pixel-ops.c.inc"
+
+static const PixelOpsAccel *pixel_ops_accel;
+static unsigned accel_index;
+
+size_t buffer_find_diff(const void *a, const void *b, size_t len)
+{
+    return pixel_ops_accel->find_diff(a, b, len);
+}
+
+void pixel_rgb888_to_rgb565(uint16_t *dst, const uint32_t *src, size_t n)
+{
+    pixel_ops_accel->rgb888_to_rgb565(dst, src, n);
+}
+
+void pixel_rgb565_to_rgb888(uint32_t *dst, const uint16_t *src, size_t n)
+{
+    pixel_ops_accel->rgb565_to_rgb888(dst, src, n);
+}
+
+void pixel_swap_rb(uint32_t *dst, const uint32_t *src, size_t n)
+{
+    pixel_ops_accel->swap_rb(dst, src, n);
+}
+
+bool test_pixel_ops_next_accel(void)
+{
+    if (accel_index != 0) {
+        pixel_ops_accel = &accel_table[--accel_index];
+        return true;
+    }
+    return false;
+}
+
+static void __attribute__((constructor)) init_accel(void)
+{
+    accel_index = best_accel();
+    pixel_ops_accel = &accel_table[accel_index];
+}